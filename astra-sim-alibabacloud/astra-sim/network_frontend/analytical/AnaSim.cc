@@ -17,19 +17,14 @@
 #include"AnaSim.h"
 using namespace std;
 
-queue<struct CallTask> AnaSim::call_list = {};
+priority_queue<CallTask, vector<CallTask>, CallTaskLater> AnaSim::call_list;
 uint64_t AnaSim::tick = 0;
+uint64_t AnaSim::scheduled = 0;
 void AnaSim::Run() {
     while (!call_list.empty())
     {
-        CallTask calltask = call_list.front();
-        while (true) {
-          if (calltask.time != tick) {
-            tick++;
-          } else {
-            break;
-          }
-        }
+        CallTask calltask = call_list.top();
+        tick = calltask.time;
         
         call_list.pop();
         // std::cout << "after pop call_list: " << call_list.size() << std::endl;
@@ -46,6 +41,7 @@ void AnaSim::Schedule(
     void* fun_arg) {
     uint64_t time = tick + delay;
     CallTask calltask = CallTask(time,fun_ptr,fun_arg);
+    calltask.seq = scheduled++;
     // std::cout << "before push all_list: " << call_list.size() << std::endl;
     call_list.push(calltask);
     // std::cout << "after push of call_list: " << call_list.size() << std::endl;
@@ -18,6 +18,7 @@
 #include<iostream>
 #include<queue>
 #include<list>
+#include<vector>
 #include<cstdint>
 
 using namespace std;
@@ -26,15 +27,24 @@ struct CallTask {
   uint64_t time;
   void (*fun_ptr)(void* fun_arg);
   void* fun_arg;
+  uint64_t seq = 0;
   CallTask(uint64_t _time, void (*_fun_ptr)(void* _fun_arg), void* _fun_arg)
       : time(_time), fun_ptr(_fun_ptr), fun_arg(_fun_arg) {};
   ~CallTask(){}
 };
 
+// earliest time first, tasks of the same time in the order they were scheduled
+struct CallTaskLater {
+  bool operator()(const CallTask& a, const CallTask& b) const {
+    return a.time != b.time ? a.time > b.time : a.seq > b.seq;
+  }
+};
+
 class AnaSim {
  private:
-  static queue<struct CallTask> call_list;
+  static priority_queue<CallTask, vector<CallTask>, CallTaskLater> call_list;
   static uint64_t tick;
+  static uint64_t scheduled;
 
  public:
   static double Now();
@@ -22,6 +22,8 @@
 #include "astra-sim/system/MockNcclLog.h"
 #include "astra-sim/system/AstraComputeAPI.hh"
 #include "astra-sim/system/AstraParamParse.hh"
+#include "astra-sim/system/JobManifest.hh"
+#include "astra-sim/system/StartupProfiler.hh"
 
 #include "AnalyticalNetwork.h"
 #include "AnaSim.h"
@@ -102,36 +104,86 @@ int main(int argc,char *argv[]) {
     }
   
   
-  AnalyticalNetWork *analytical_network = new AnalyticalNetWork(0);
-  AstraSim::Sys *systems = new AstraSim::Sys(
-    analytical_network,
-    nullptr,
-    0,
-    0,
-    1,
-    physical_dims[0],
-    queues_per_dim,
-    "",
-    WORKLOAD_PATH + param->workload,
-    param->comm_scale,
-    1,
-    1,
-    1,
-    0,
-    RESULT_PATH + param->res,
-    "Analytical_test",
-    true,
-    false,
-    param->net_work_param.gpu_type,
-    param->gpus,
-    param->net_work_param.NVswitchs,
-    param->net_work_param.gpus_per_server
-  );
-  systems->nvswitch_id = node2nvswitch[0];
-  systems->num_gpus = using_num_gpus - param->net_work_param.nvswitch_num;
-  
+  AstraSim::StartupProfiler::Phase sys_phase("sys_init");
+  std::vector<AstraSim::Sys*> systems;
+  if (!param->jobs.empty()) {
+    std::string err;
+    if (!AstraSim::JobManifest::load(
+            param->jobs, all_gpu_num, param->net_work_param.gpus_per_server, err)) {
+      std::cerr << err << std::endl;
+      return -1;
+    }
+    // one Sys per job, told apart by npu_offset; the analytical backend has
+    // no shared fabric, so the jobs only share the timeline
+    std::vector<AstraSim::ClusterJob>& jobs = AstraSim::JobManifest::jobs();
+    for (int k = 0; k < jobs.size(); k++) {
+      jobs[k].leader = k;
+      AstraSim::JobManifest::place(k, k);
+      int job_nvswitches = jobs[k].ranks / param->net_work_param.gpus_per_server;
+      AstraSim::Sys* sys = new AstraSim::Sys(
+        new AnalyticalNetWork(0),
+        nullptr,
+        0,
+        k,
+        1,
+        {jobs[k].ranks + job_nvswitches},
+        {1},
+        "",
+        WORKLOAD_PATH + jobs[k].workload,
+        param->comm_scale,
+        1,
+        1,
+        1,
+        0,
+        RESULT_PATH + param->res + jobs[k].name + "-",
+        "Analytical_test",
+        true,
+        false,
+        param->net_work_param.gpu_type,
+        {jobs[k].ranks},
+        param->net_work_param.NVswitchs,
+        param->net_work_param.gpus_per_server
+      );
+      sys->nvswitch_id = node2nvswitch[jobs[k].first_rank];
+      sys->num_gpus = jobs[k].ranks;
+      systems.push_back(sys);
+    }
+  } else {
+    AnalyticalNetWork *analytical_network = new AnalyticalNetWork(0);
+    AstraSim::Sys *sys = new AstraSim::Sys(
+      analytical_network,
+      nullptr,
+      0,
+      0,
+      1,
+      physical_dims[0],
+      queues_per_dim,
+      "",
+      WORKLOAD_PATH + param->workload,
+      param->comm_scale,
+      1,
+      1,
+      1,
+      0,
+      RESULT_PATH + param->res,
+      "Analytical_test",
+      true,
+      false,
+      param->net_work_param.gpu_type,
+      param->gpus,
+      param->net_work_param.NVswitchs,
+      param->net_work_param.gpus_per_server
+    );
+    sys->nvswitch_id = node2nvswitch[0];
+    sys->num_gpus = using_num_gpus - param->net_work_param.nvswitch_num;
+    systems.push_back(sys);
+  }
+  sys_phase.stop();
+  AstraSim::StartupProfiler::report();
 
-  systems->workload->fire();
+  for (auto sys : systems) {
+    AstraSim::JobManifest::fire(sys);
+  }
   std::cout << "SimAI begin run Analytical" << std::endl;
   AnaSim::Run();
   AnaSim::Stop();
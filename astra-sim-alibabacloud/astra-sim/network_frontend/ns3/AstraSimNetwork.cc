@@ -17,7 +17,11 @@
 #include "astra-sim/system/Sys.hh"
 #include "astra-sim/system/RecvPacketEventHadndlerData.hh"
 #include "astra-sim/system/Common.hh"
+#include "astra-sim/system/Determinism.hh"
+#include "astra-sim/system/JobManifest.hh"
+#include "astra-sim/system/MemoryAccounting.hh"
 #include "astra-sim/system/MockNcclLog.h"
+#include "astra-sim/system/StartupProfiler.hh"
 #include "ns3/applications-module.h"
 #include "ns3/core-module.h"
 #include "ns3/csma-module.h"
@@ -26,7 +30,9 @@
 #include "ns3/core-module.h"
 #include "ns3/core-module.h"
 #include "entry.h"
+#include <atomic>
 #include <execinfo.h>
+#include <getopt.h>
 #include <fstream>
 #include <iostream>
 #include <queue>
@@ -75,6 +81,27 @@ public:
     this->npu_offset = npu_offset;
   }
   ~ASTRASimNetwork() {}
+  // lookups only, the path maps are shared by all MTP threads
+  double get_BW_between(int src, int dst)
+  {
+    auto from = pairBw.find(src + npu_offset);
+    if (from == pairBw.end())
+      return -1;
+    auto to = from->second.find(dst + npu_offset);
+    if (to == from->second.end() || to->second == 0)
+      return -1;
+    return to->second / 8e9;
+  }
+  double get_latency_between(int src, int dst)
+  {
+    auto from = pairDelay.find(n.Get(src + npu_offset));
+    if (from == pairDelay.end())
+      return -1;
+    auto to = from->second.find(n.Get(dst + npu_offset));
+    if (to == from->second.end())
+      return -1;
+    return to->second;
+  }
   int sim_comm_size(AstraSim::sim_comm comm, int *size) { return 0; }
   int sim_finish()
   {
@@ -236,21 +263,143 @@ public:
   }
 };
 
+// The Sys objects only need the topology header, so once SetupNetwork has
+// loaded it they are built on AS_STARTUP_THREADS workers while the ns-3
+// network and routes are built on the main thread. Each rank is built the
+// same way as on the serial path; finish_systems waits for the workers.
+// With a job manifest (-j) every rank and NVSwitch of a job runs the job's
+// workload and idle nodes get no Sys.
+struct StartupPipeline
+{
+  std::string workload;
+  std::string jobs;
+  int nodes_num = 0;
+  int gpu_num = 0;
+  std::map<int, int> node2nvswitch;
+  std::vector<ASTRASimNetwork *> networks;
+  std::vector<AstraSim::Sys *> systems;
+  std::vector<std::thread> workers;
+  std::atomic<int> cursor{0};
+};
+static StartupPipeline startup;
+
+static void build_system(int j)
+{
+  const AstraSim::ClusterJob *job = AstraSim::JobManifest::of(j);
+  if (job == nullptr && AstraSim::JobManifest::enabled())
+    return;
+  AstraSim::StartupProfiler::Phase phase("sys_init");
+  startup.networks[j] = new ASTRASimNetwork(j, 0);
+  AstraSim::Sys *sys = new AstraSim::Sys(
+      startup.networks[j],
+      nullptr,
+      j,
+      0,
+      1,
+      {startup.nodes_num},
+      {1},
+      "",
+      job != nullptr ? job->workload : startup.workload,
+      1,
+      1,
+      1,
+      1,
+      0,
+      job != nullptr ? RESULT_PATH + job->name + "-" : RESULT_PATH,
+      "test1",
+      true,
+      false,
+      gpu_type,
+      {job != nullptr ? job->ranks : startup.gpu_num},
+      NVswitchs,
+      gpus_per_server);
+  sys->set_rendezvous_protocol(rendezvous_threshold, rendezvous_control_size);
+  sys->nvswitch_id = startup.node2nvswitch[j];
+  sys->num_gpus = startup.nodes_num - nvswitch_num;
+  startup.systems[j] = sys;
+}
+
+// Called by SetupNetwork as soon as the topology header is known.
+static void start_systems()
+{
+  startup.nodes_num = node_num - switch_num;
+  startup.gpu_num = node_num - nvswitch_num - switch_num;
+  for (int i = 0; i < startup.gpu_num; ++i)
+  {
+    startup.node2nvswitch[i] = startup.gpu_num + i / gpus_per_server;
+  }
+  for (int i = startup.gpu_num; i < startup.gpu_num + nvswitch_num; ++i)
+  {
+    startup.node2nvswitch[i] = i;
+    NVswitchs.push_back(i);
+  }
+  if (!startup.jobs.empty())
+  {
+    std::string err;
+    if (!AstraSim::JobManifest::load(startup.jobs, startup.gpu_num, gpus_per_server, err))
+    {
+      std::cerr << err << std::endl;
+      exit(1);
+    }
+    std::vector<AstraSim::ClusterJob> &jobs = AstraSim::JobManifest::jobs();
+    for (int k = 0; k < jobs.size(); k++)
+    {
+      for (int r = jobs[k].first_rank; r < jobs[k].first_rank + jobs[k].ranks; r++)
+      {
+        AstraSim::JobManifest::place(r, k);
+        AstraSim::JobManifest::place(startup.node2nvswitch[r], k);
+      }
+    }
+  }
+  startup.networks.assign(startup.nodes_num, nullptr);
+  startup.systems.assign(startup.nodes_num, nullptr);
+
+  int threads = std::min(AstraSim::StartupProfiler::threads(), startup.nodes_num);
+  if (threads <= 1)
+    return;
+  for (int t = 0; t < threads; t++)
+  {
+    startup.workers.emplace_back([]()
+    {
+      for (int j = startup.cursor++; j < startup.nodes_num; j = startup.cursor++)
+        build_system(j);
+    });
+  }
+}
+
+static void finish_systems()
+{
+  for (auto &w : startup.workers)
+    w.join();
+  startup.workers.clear();
+  for (int j = 0; j < startup.nodes_num; j++)
+  {
+    if (startup.systems[j] == nullptr)
+      build_system(j);
+  }
+}
+
 static int
 user_param_prase(int argc, char *argv[], struct user_param *user_param)
 {
+  static struct option long_options[] = {
+      {"mem-budget", required_argument, nullptr, 'm'},
+      {nullptr, 0, nullptr, 0}};
   int opt;
-  while ((opt = getopt(argc, argv, "ht:w:g:s:n:c:p:r")) != -1)
+  while ((opt = getopt_long(argc, argv, "ht:w:b:j:g:s:n:c:p:rm:", long_options, nullptr)) != -1)
   {
     switch (opt)
     {
     case 'h':
       std::cout << "-t <int>  number of threads, default 1\n";
       std::cout << "-w <file> workloads, default none\n";
+      std::cout << "-b <spec> collective sweep instead of -w, e.g. allreduce,min=1M,max=1G,group=tp\n";
+      std::cout << "-j <file> job manifest, several workloads sharing the network instead of -w\n";
       std::cout << "-n <file> network topo\n";
       std::cout << "-c <file> network_conf\n";
       std::cout << "-p <file> enable pcapng trace\n";
       std::cout << "-r        enable realtime simulation\n";
+      std::cout << "-m, --mem-budget <size> evict caches above this resident size, e.g. 64G\n";
       return 1;
     case 't':
       user_param->thread = std::stoi(optarg);
@@ -258,6 +407,12 @@ user_param_prase(int argc, char *argv[], struct user_param *user_param)
     case 'w':
       user_param->workload = optarg;
       break;
+    case 'b':
+      user_param->workload = std::string("bench:") + optarg;
+      break;
+    case 'j':
+      user_param->jobs = optarg;
+      break;
     case 'n':
       user_param->network_topo = optarg;
       break;
@@ -279,6 +434,17 @@ user_param_prase(int argc, char *argv[], struct user_param *user_param)
     case 'r':
       user_param->realtime = 1;
       break;
+    case 'm':
+    {
+      uint64_t budget;
+      if (!AstraSim::MemoryAccounting::parse_bytes(optarg, budget))
+      {
+        std::cerr << "invalid memory budget " << optarg << std::endl;
+        exit(1);
+      }
+      AstraSim::MemoryAccounting::set_budget(budget);
+      break;
+    }
     default:
       std::cerr << "-h    help message\n";
       return 1;
@@ -297,6 +463,13 @@ int main(int argc, char *argv[])
   {
     return 0;
   }
+  if (AstraSim::Determinism::enabled())
+  {
+    // ns-3 seeds must be non-zero; the upper half of AS_SEED selects the run
+    uint64_t seed = AstraSim::Determinism::seed();
+    RngSeedManager::SetSeed(static_cast<uint32_t>(seed) != 0 ? static_cast<uint32_t>(seed) : 1);
+    RngSeedManager::SetRun(seed >> 32);
+  }
 #ifdef NS3_MTP
   MtpInterface::Enable(user_param.thread);
 #endif
@@ -309,69 +482,44 @@ int main(int argc, char *argv[])
     std::cout << "Realtime Simulation Enabled" << std::endl;
   }
 
-  if (main1(user_param) == -1)
+  AstraSim::StartupProfiler::Phase startup_phase("startup");
+  startup.workload = user_param.workload;
+  startup.jobs = user_param.jobs;
+  if (main1(user_param, start_systems) == -1)
   {
     cout << "read network topo or conf error" << endl;
     return -1;
   }
-  int nodes_num = node_num - switch_num;
-  int gpu_num = node_num - nvswitch_num - switch_num;
-
-  std::map<int, int> node2nvswitch;
-  for (int i = 0; i < gpu_num; ++i)
-  {
-    node2nvswitch[i] = gpu_num + i / gpus_per_server;
-  }
-  for (int i = gpu_num; i < gpu_num + nvswitch_num; ++i)
+  if (AstraSim::MemoryAccounting::enabled())
   {
-    node2nvswitch[i] = i;
-    NVswitchs.push_back(i);
+    using AstraSim::MemoryAccounting;
+    MemoryAccounting::add_probe("sentHash", [] { return MemoryAccounting::container_bytes(sentHash); });
+    MemoryAccounting::add_probe("recvHash", [] { return MemoryAccounting::container_bytes(recvHash) + MemoryAccounting::container_bytes(expeRecvHash); });
+    MemoryAccounting::add_probe("receiver_pending_queue", [] { return MemoryAccounting::container_bytes(receiver_pending_queue); });
+    MemoryAccounting::add_probe("sender_src_port_map", [] { return MemoryAccounting::container_bytes(sender_src_port_map); });
+    MemoryAccounting::add_probe("pair_tables", []
+                                { return MemoryAccounting::nested_map_bytes(pairDelay) + MemoryAccounting::nested_map_bytes(pairTxDelay) +
+                                         MemoryAccounting::nested_map_bytes(pairBw) + MemoryAccounting::nested_map_bytes(pairBdp) +
+                                         MemoryAccounting::nested_map_bytes(pairRtt); });
   }
-
   LogComponentEnable("OnOffApplication", LOG_LEVEL_INFO);
   LogComponentEnable("PacketSink", LOG_LEVEL_INFO);
   LogComponentEnable("GENERIC_SIMULATION", LOG_LEVEL_INFO);
 
-  std::vector<ASTRASimNetwork *> networks(nodes_num, nullptr);
-  std::vector<AstraSim::Sys *> systems(nodes_num, nullptr);
-
-  for (int j = 0; j < nodes_num; j++)
-  {
-    networks[j] =
-        new ASTRASimNetwork(j, 0);
-    systems[j] = new AstraSim::Sys(
-        networks[j],
-        nullptr,
-        j,
-        0,
-        1,
-        {nodes_num},
-        {1},
-        "",
-        user_param.workload,
-        1,
-        1,
-        1,
-        1,
-        0,
-        RESULT_PATH,
-        "test1",
-        true,
-        false,
-        gpu_type,
-        {gpu_num},
-        NVswitchs,
-        gpus_per_server);
-    systems[j]->nvswitch_id = node2nvswitch[j];
-    systems[j]->num_gpus = nodes_num - nvswitch_num;
-  }
+  finish_systems();
+  startup_phase.stop();
+  AstraSim::StartupProfiler::report();
+  std::vector<AstraSim::Sys *> &systems = startup.systems;
+  int nodes_num = startup.nodes_num;
   for (int i = 0; i < nodes_num; i++)
   {
-    systems[i]->workload->fire();
+    if (systems[i] != nullptr)
+      AstraSim::JobManifest::fire(systems[i]);
   }
   std::cout << "simulator run " << std::endl;
 
   Simulator::Run();
+  finish_telemetry();
   Simulator::Stop(Seconds(simulator_stop_time));
   Simulator::Destroy();
 
@@ -46,10 +46,19 @@
 #include <ns3/switch-node.h>
 #include <ns3/nvswitch-node.h>
 #include "astra-sim/system/Common.hh"
+#include "astra-sim/system/ExitReports.hh"
+#include "astra-sim/system/StartupProfiler.hh"
 #include "pcap-sniffer.h"
 #include "pcap-sniffer.cc"
+#include "routing-validator.h"
+#include "topology-gen.h"
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <filesystem>
+#include <memory>
+#include <set>
+#include <thread>
 
 using namespace ns3;
 using namespace std;
@@ -128,10 +137,30 @@ string cnp_mon_file;
 string total_flow_file = "/root/astra-sim/extern/network_backend/ns3-interface/simulation/monitor_output/";
 FILE *total_flow_output = nullptr;
 
+// link telemetry, enabled by TELEMETRY_FILE in the network conf
+string telemetry_file;
+string telemetry_topk_file;
+string telemetry_format = "csv";
+uint32_t telemetry_interval = 10000;
+uint32_t telemetry_topk = 16;
+double telemetry_hot_threshold = 0.8;
+
+// point-to-point protocol: every message goes eagerly unless
+// RENDEZVOUS_THRESHOLD is set. NCCL writes each chunk into a buffer the
+// peer registered up front and paces it with credits, which the flow models
+// already express through parent flows and per-peer QPs, so a default
+// threshold would add a clear-to-send NCCL never waits for. Transports that
+// do handshake can set it, e.g. 4194304 with a 64B clear-to-send for a
+// 4MB ibverbs rendezvous.
+uint64_t rendezvous_threshold = UINT64_MAX;
+uint64_t rendezvous_control_size = 64;
+
 unordered_map<uint64_t, uint32_t> rate2kmax, rate2kmin;
 unordered_map<uint64_t, double> rate2pmax;
 
-std::ifstream topof, flowf, tracef;
+std::ifstream flowf, tracef;
+// topology_file may be a text file, a binary topology or a "gen:" spec
+Topology topo;
 
 NodeContainer n;
 
@@ -153,7 +182,6 @@ struct Interface
   Interface() : idx(0), up(false) {}
 };
 map<Ptr<Node>, map<Ptr<Node>, Interface>> nbr2if;
-map<Ptr<Node>, map<Ptr<Node>, vector<Ptr<Node>>>> nextHop;
 map<Ptr<Node>, map<Ptr<Node>, uint64_t>> pairDelay;
 map<Ptr<Node>, map<Ptr<Node>, uint64_t>> pairTxDelay;
 map<uint32_t, map<uint32_t, uint64_t>> pairBw;
@@ -288,105 +316,615 @@ void schedule_monitor()
   Simulator::Schedule(MicroSeconds(mon_start), &monitor_qp_cnp_number, cnp_output, &n);
 }
 
-void CalculateRoute(Ptr<Node> host)
+/*
+ * Link telemetry. Every directed link (node, egress port) gets a slot in
+ * flat arrays built once after the topology is wired; the PhyTxBegin trace
+ * only bumps a counter, and the sampler turns counter deltas into one
+ * utilization row per interval plus a log2 queue-depth sketch per link.
+ */
+const uint32_t TELEMETRY_QLEN_BUCKETS = 32;
+
+struct TelemetryLink
+{
+  uint32_t src;
+  uint32_t dst;
+  uint32_t port;
+  uint64_t bw;
+};
+
+vector<TelemetryLink> telemetry_links;
+vector<vector<int32_t>> telemetry_port_link;
+std::unique_ptr<std::atomic<uint64_t>[]> telemetry_tx_bytes;
+vector<uint64_t> telemetry_start_bytes;
+vector<uint64_t> telemetry_last_bytes;
+vector<double> telemetry_peak_util;
+vector<uint32_t> telemetry_hot_intervals;
+vector<uint32_t> telemetry_qlen_max;
+vector<uint32_t> telemetry_qlen_sketch;
+vector<uint16_t> telemetry_util_row;
+vector<uint32_t> telemetry_qlen_row;
+string telemetry_buf;
+uint64_t telemetry_samples = 0;
+uint64_t telemetry_start_ns = 0;
+uint64_t telemetry_last_ns = 0;
+FILE *telemetry_output = nullptr;
+
+inline uint32_t telemetry_qlen_bucket(uint32_t qlen)
+{
+  uint32_t b = 0;
+  while (qlen > 0 && b < TELEMETRY_QLEN_BUCKETS - 1)
+  {
+    qlen >>= 1;
+    b++;
+  }
+  return b;
+}
+
+uint32_t telemetry_qlen_percentile(uint32_t link, double p)
+{
+  const uint32_t *sketch = &telemetry_qlen_sketch[link * TELEMETRY_QLEN_BUCKETS];
+  uint64_t total = 0;
+  for (uint32_t b = 0; b < TELEMETRY_QLEN_BUCKETS; b++)
+    total += sketch[b];
+  if (total == 0)
+    return 0;
+  uint64_t target = (uint64_t)(p * total);
+  uint64_t seen = 0;
+  for (uint32_t b = 0; b < TELEMETRY_QLEN_BUCKETS; b++)
+  {
+    seen += sketch[b];
+    if (seen > target)
+      return b == 0 ? 0 : (1u << b) - 1;
+  }
+  return (1u << (TELEMETRY_QLEN_BUCKETS - 1)) - 1;
+}
+
+void telemetry_tx(uint32_t link, Ptr<const Packet> p)
+{
+  telemetry_tx_bytes[link].fetch_add(p->GetSize(), std::memory_order_relaxed);
+}
+
+void telemetry_sample_qlen(Ptr<Node> node, Ptr<SwitchMmu> mmu)
+{
+  vector<int32_t> &ports = telemetry_port_link[node->GetId()];
+  for (uint32_t j = 1; j < ports.size(); j++)
+  {
+    if (ports[j] < 0)
+      continue;
+    uint32_t qlen = 0;
+    for (uint32_t q = 0; q < SwitchMmu::qCnt; q++)
+      qlen += mmu->egress_bytes[j][q];
+    telemetry_qlen_row[ports[j]] = qlen;
+  }
+}
+
+void telemetry_sample()
+{
+  uint64_t now = Simulator::Now().GetTimeStep();
+  uint64_t elapsed = now - telemetry_last_ns;
+  uint32_t link_count = telemetry_links.size();
+
+  std::fill(telemetry_qlen_row.begin(), telemetry_qlen_row.end(), 0);
+  for (uint32_t i = 0; i < n.GetN(); i++)
+  {
+    if (n.Get(i)->GetNodeType() == 1)
+      telemetry_sample_qlen(n.Get(i), DynamicCast<SwitchNode>(n.Get(i))->m_mmu);
+    else if (n.Get(i)->GetNodeType() == 2)
+      telemetry_sample_qlen(n.Get(i), DynamicCast<NVSwitchNode>(n.Get(i))->m_mmu);
+  }
+
+  for (uint32_t l = 0; l < link_count; l++)
+  {
+    uint64_t bytes = telemetry_tx_bytes[l].load(std::memory_order_relaxed);
+    uint64_t delta = bytes - telemetry_last_bytes[l];
+    telemetry_last_bytes[l] = bytes;
+    double util = 0;
+    if (elapsed > 0 && telemetry_links[l].bw > 0)
+      util = (double)delta * 8 * 1000000000lu / elapsed / telemetry_links[l].bw;
+    if (util > 1)
+      util = 1;
+    telemetry_util_row[l] = (uint16_t)(util * 10000);
+    if (util > telemetry_peak_util[l])
+      telemetry_peak_util[l] = util;
+    if (util >= telemetry_hot_threshold)
+      telemetry_hot_intervals[l]++;
+    uint32_t qlen = telemetry_qlen_row[l];
+    telemetry_qlen_sketch[l * TELEMETRY_QLEN_BUCKETS + telemetry_qlen_bucket(qlen)]++;
+    if (qlen > telemetry_qlen_max[l])
+      telemetry_qlen_max[l] = qlen;
+  }
+
+  if (telemetry_format == "bin")
+  {
+    fwrite(&now, sizeof(now), 1, telemetry_output);
+    fwrite(telemetry_util_row.data(), sizeof(uint16_t), link_count, telemetry_output);
+    fwrite(telemetry_qlen_row.data(), sizeof(uint32_t), link_count, telemetry_output);
+  }
+  else
+  {
+    char num[32];
+    telemetry_buf.clear();
+    snprintf(num, sizeof(num), "%lu", now);
+    telemetry_buf += num;
+    for (uint32_t l = 0; l < link_count; l++)
+    {
+      snprintf(num, sizeof(num), ",%.4f", telemetry_util_row[l] / 10000.0);
+      telemetry_buf += num;
+    }
+    telemetry_buf += '\n';
+    fwrite(telemetry_buf.data(), 1, telemetry_buf.size(), telemetry_output);
+  }
+
+  telemetry_samples++;
+  telemetry_last_ns = now;
+  if (!Simulator::IsFinished() && now < (uint64_t)MicroSeconds(mon_end).GetTimeStep())
+    Simulator::Schedule(MicroSeconds(telemetry_interval), &telemetry_sample);
+}
+
+// counts from mon_start on: traffic before the window is left out of the
+// first interval and of the mean
+void telemetry_baseline()
+{
+  for (uint32_t l = 0; l < telemetry_links.size(); l++)
+    telemetry_start_bytes[l] = telemetry_last_bytes[l] =
+        telemetry_tx_bytes[l].load(std::memory_order_relaxed);
+}
+
+void finish_telemetry();
+
+void schedule_telemetry()
+{
+  telemetry_links.clear();
+  for (auto i : nbr2if)
+  {
+    for (auto j : i.second)
+    {
+      TelemetryLink link;
+      link.src = i.first->GetId();
+      link.dst = j.first->GetId();
+      link.port = j.second.idx;
+      link.bw = j.second.bw;
+      telemetry_links.push_back(link);
+    }
+  }
+  // nbr2if is keyed by pointer, so order by id to keep columns stable across runs
+  std::sort(telemetry_links.begin(), telemetry_links.end(),
+            [](const TelemetryLink &a, const TelemetryLink &b)
+            { return a.src != b.src ? a.src < b.src : a.port < b.port; });
+
+  uint32_t link_count = telemetry_links.size();
+  telemetry_port_link.assign(n.GetN(), vector<int32_t>());
+  for (uint32_t i = 0; i < n.GetN(); i++)
+    telemetry_port_link[i].assign(n.Get(i)->GetNDevices(), -1);
+  telemetry_tx_bytes.reset(new std::atomic<uint64_t>[link_count]);
+  for (uint32_t l = 0; l < link_count; l++)
+  {
+    telemetry_tx_bytes[l].store(0);
+    telemetry_port_link[telemetry_links[l].src][telemetry_links[l].port] = l;
+    Ptr<NetDevice> dev = n.Get(telemetry_links[l].src)->GetDevice(telemetry_links[l].port);
+    dev->TraceConnectWithoutContext("PhyTxBegin", MakeBoundCallback(&telemetry_tx, l));
+  }
+  telemetry_start_bytes.assign(link_count, 0);
+  telemetry_last_bytes.assign(link_count, 0);
+  telemetry_peak_util.assign(link_count, 0);
+  telemetry_hot_intervals.assign(link_count, 0);
+  telemetry_qlen_max.assign(link_count, 0);
+  telemetry_qlen_sketch.assign(link_count * TELEMETRY_QLEN_BUCKETS, 0);
+  telemetry_util_row.assign(link_count, 0);
+  telemetry_qlen_row.assign(link_count, 0);
+  telemetry_buf.reserve(link_count * 8 + 32);
+
+  telemetry_output = fopen(telemetry_file.c_str(), telemetry_format == "bin" ? "wb" : "w");
+  if (telemetry_output == nullptr)
+  {
+    std::cerr << "Error: Unable to open telemetry file: " << telemetry_file << std::endl;
+    exit(1);
+  }
+  setvbuf(telemetry_output, nullptr, _IOFBF, 1 << 20);
+  if (telemetry_format == "bin")
+  {
+    // header: magic, link count, interval(us), then one record per link
+    fwrite("SIMTLM1", 1, 8, telemetry_output);
+    fwrite(&link_count, sizeof(link_count), 1, telemetry_output);
+    fwrite(&telemetry_interval, sizeof(telemetry_interval), 1, telemetry_output);
+    for (auto &link : telemetry_links)
+    {
+      fwrite(&link.src, sizeof(link.src), 1, telemetry_output);
+      fwrite(&link.dst, sizeof(link.dst), 1, telemetry_output);
+      fwrite(&link.port, sizeof(link.port), 1, telemetry_output);
+      fwrite(&link.bw, sizeof(link.bw), 1, telemetry_output);
+    }
+  }
+  else
+  {
+    fprintf(telemetry_output, "time");
+    for (auto &link : telemetry_links)
+      fprintf(telemetry_output, ",%u-%u:%u", link.src, link.dst, link.port);
+    fprintf(telemetry_output, "\n");
+  }
+
+  telemetry_start_ns = telemetry_last_ns = MicroSeconds(mon_start).GetTimeStep();
+  Simulator::Schedule(MicroSeconds(mon_start), &telemetry_baseline);
+  Simulator::Schedule(MicroSeconds(mon_start + telemetry_interval), &telemetry_sample);
+  ExitReports::add(finish_telemetry);
+}
+
+void finish_telemetry()
+{
+  if (telemetry_output == nullptr)
+    return;
+  fclose(telemetry_output);
+  telemetry_output = nullptr;
+
+  uint32_t link_count = telemetry_links.size();
+  uint64_t span = telemetry_last_ns - telemetry_start_ns;
+  vector<double> mean_util(link_count, 0);
+  vector<uint64_t> window_bytes(link_count, 0);
+  vector<uint32_t> order(link_count);
+  for (uint32_t l = 0; l < link_count; l++)
+  {
+    order[l] = l;
+    window_bytes[l] = telemetry_last_bytes[l] - telemetry_start_bytes[l];
+    if (span > 0 && telemetry_links[l].bw > 0)
+      mean_util[l] = (double)window_bytes[l] * 8 * 1000000000lu / span / telemetry_links[l].bw;
+  }
+  uint32_t k = std::min(telemetry_topk, link_count);
+  std::partial_sort(order.begin(), order.begin() + k, order.end(),
+                    [&](uint32_t a, uint32_t b)
+                    { return mean_util[a] != mean_util[b] ? mean_util[a] > mean_util[b] : a < b; });
+
+  string topk_file = telemetry_topk_file.empty() ? telemetry_file + ".topk.csv" : telemetry_topk_file;
+  FILE *topk_output = fopen(topk_file.c_str(), "w");
+  if (topk_output == nullptr)
+  {
+    std::cerr << "Error: Unable to open telemetry top-k file: " << topk_file << std::endl;
+    return;
+  }
+  fprintf(topk_output, "rank,src,src_type,dst,dst_type,port,bytes,mean_util,peak_util,hot_intervals,samples,qlen_p50,qlen_p99,qlen_max\n");
+  const char *types[] = {"HOST", "SWITCH", "NVSWITCH"};
+  for (uint32_t r = 0; r < k; r++)
+  {
+    uint32_t l = order[r];
+    TelemetryLink &link = telemetry_links[l];
+    fprintf(topk_output, "%u,%u,%s,%u,%s,%u,%lu,%.4f,%.4f,%u,%lu,%u,%u,%u\n",
+            r + 1, link.src, types[n.Get(link.src)->GetNodeType()],
+            link.dst, types[n.Get(link.dst)->GetNodeType()], link.port,
+            window_bytes[l], mean_util[l], telemetry_peak_util[l],
+            telemetry_hot_intervals[l], telemetry_samples,
+            telemetry_qlen_percentile(l, 0.5), telemetry_qlen_percentile(l, 0.99),
+            telemetry_qlen_max[l]);
+  }
+  fclose(topk_output);
+}
+
+/*
+ * Routing. Every host is a destination; a BFS rooted at it yields, for each
+ * node one hop closer, the ordered set of next hops toward that host. Next-hop
+ * sets are interned per (node, next hops) into ECMP groups, so the tables keep
+ * a group id per (destination, node) and the interface list of a group is
+ * resolved once. Destinations are independent and are computed in batches by
+ * route_threads workers, then merged in destination order so the installed
+ * tables do not depend on the thread count.
+ */
+struct RouteAdj
+{
+  uint32_t nbr;
+  uint32_t idx;
+  uint64_t delay;
+  uint64_t bw;
+};
+
+struct EcmpGroupHash
+{
+  size_t operator()(const vector<uint32_t> &key) const
+  {
+    uint64_t h = 1469598103934665603ull;
+    for (uint32_t v : key)
+      h = (h ^ v) * 1099511628211ull;
+    return h;
+  }
+};
+
+struct RouteTree
+{
+  uint32_t dst;
+  // hop_node[i] reaches dst via hop_next[hop_off[i] .. hop_off[i + 1])
+  vector<uint32_t> hop_node;
+  vector<uint32_t> hop_off;
+  vector<uint32_t> hop_next;
+  vector<pair<uint32_t, uint32_t>> host_nbrs;
+  vector<uint32_t> reached;
+  vector<uint64_t> delay;
+  vector<uint64_t> tx_delay;
+  vector<uint64_t> bw;
+};
+
+struct RouteScratch
+{
+  vector<int> dis;
+  vector<uint64_t> delay;
+  vector<uint64_t> tx_delay;
+  vector<uint64_t> bw;
+  vector<vector<uint32_t>> nexts;
+  vector<uint8_t> via_nvswitch;
+  vector<uint32_t> q;
+};
+
+uint32_t route_threads = 0;
+uint32_t validate_routing = 0;
+vector<vector<RouteAdj>> route_adj;
+vector<uint32_t> route_node_type;
+vector<EcmpGroup> ecmp_groups;
+unordered_map<vector<uint32_t>, uint32_t, EcmpGroupHash> ecmp_group_index;
+// route_entries[dst] lists (node, ecmp group) for every node with a route to dst
+vector<vector<pair<uint32_t, uint32_t>>> route_entries;
+
+void ClearRoutes()
+{
+  route_adj.clear();
+  route_node_type.clear();
+  ecmp_groups.clear();
+  ecmp_group_index.clear();
+  route_entries.clear();
+}
+
+uint32_t InternEcmpGroup(uint32_t node, const uint32_t *nexts, uint32_t count)
+{
+  static vector<uint32_t> key;
+  key.clear();
+  key.push_back(node);
+  key.insert(key.end(), nexts, nexts + count);
+  auto it = ecmp_group_index.find(key);
+  if (it != ecmp_group_index.end())
+    return it->second;
+  EcmpGroup group;
+  group.node = node;
+  group.nexts.assign(nexts, nexts + count);
+  for (uint32_t next : group.nexts)
+  {
+    for (auto &adj : route_adj[node])
+    {
+      if (adj.nbr == next)
+      {
+        group.ifaces.push_back(adj.idx);
+        break;
+      }
+    }
+  }
+  uint32_t id = ecmp_groups.size();
+  ecmp_groups.push_back(group);
+  ecmp_group_index.emplace(key, id);
+  return id;
+}
+
+void BuildRouteAdjacency(NodeContainer &n)
 {
-  vector<Ptr<Node>> q;
-  map<Ptr<Node>, int> dis;
-  map<Ptr<Node>, uint64_t> delay;
-  map<Ptr<Node>, uint64_t> txDelay;
-  map<Ptr<Node>, uint64_t> bw;
-  q.push_back(host);
-  dis[host] = 0;
-  delay[host] = 0;
-  txDelay[host] = 0;
-  bw[host] = 0xfffffffffffffffflu;
-  for (int i = 0; i < (int)q.size(); i++)
-  {
-    Ptr<Node> now = q[i];
-    int d = dis[now];
-    for (auto it = nbr2if[now].begin(); it != nbr2if[now].end(); it++)
-    {
-      if (!it->second.up)
+  uint32_t node_count = n.GetN();
+  route_adj.assign(node_count, vector<RouteAdj>());
+  route_node_type.assign(node_count, 0);
+  for (uint32_t i = 0; i < node_count; i++)
+    route_node_type[i] = n.Get(i)->GetNodeType();
+  // keep nbr2if's neighbor order so ECMP member order matches the BFS order
+  for (auto &i : nbr2if)
+  {
+    vector<RouteAdj> &adj = route_adj[i.first->GetId()];
+    for (auto &j : i.second)
+    {
+      if (!j.second.up)
         continue;
-      Ptr<Node> next = it->first;
-      if (dis.find(next) == dis.end())
+      RouteAdj a;
+      a.nbr = j.first->GetId();
+      a.idx = j.second.idx;
+      a.delay = j.second.delay;
+      a.bw = j.second.bw;
+      adj.push_back(a);
+    }
+  }
+}
+
+void CalculateRoute(uint32_t host, RouteScratch &s, RouteTree &tree)
+{
+  tree.dst = host;
+  tree.hop_node.clear();
+  tree.hop_off.clear();
+  tree.hop_next.clear();
+  tree.host_nbrs.clear();
+  tree.reached.clear();
+  tree.delay.clear();
+  tree.tx_delay.clear();
+  tree.bw.clear();
+
+  s.q.clear();
+  s.q.push_back(host);
+  s.dis[host] = 0;
+  s.delay[host] = 0;
+  s.tx_delay[host] = 0;
+  s.bw[host] = 0xfffffffffffffffflu;
+  tree.reached.push_back(host);
+  for (int i = 0; i < (int)s.q.size(); i++)
+  {
+    uint32_t now = s.q[i];
+    int d = s.dis[now];
+    for (auto &adj : route_adj[now])
+    {
+      uint32_t next = adj.nbr;
+      if (s.dis[next] < 0)
       {
-        dis[next] = d + 1;
-        delay[next] = delay[now] + it->second.delay;
-        txDelay[next] = txDelay[now] +
-                        packet_payload_size * 1000000000lu * 8 / it->second.bw;
-        bw[next] = std::min(bw[now], it->second.bw);
-        if (next->GetNodeType() == 1 || next->GetNodeType() == 2)
+        s.dis[next] = d + 1;
+        s.delay[next] = s.delay[now] + adj.delay;
+        s.tx_delay[next] = s.tx_delay[now] +
+                           packet_payload_size * 1000000000lu * 8 / adj.bw;
+        s.bw[next] = std::min(s.bw[now], adj.bw);
+        tree.reached.push_back(next);
+        if (route_node_type[next] == 1 || route_node_type[next] == 2)
         {
-          q.push_back(next);
+          s.q.push_back(next);
         }
       }
-      bool via_nvswitch = false;
-      if (d + 1 == dis[next])
+      if (d + 1 == s.dis[next])
       {
-        for (auto x : nextHop[next][host])
+        // a path through an NVSwitch replaces any path found without one
+        if (!s.via_nvswitch[next])
         {
-          if (x->GetNodeType() == 2)
-            via_nvswitch = true;
-        }
-        if (via_nvswitch == false)
-        {
-          if (now->GetNodeType() == 2)
+          if (route_node_type[now] == 2)
           {
-            while (nextHop[next][host].size() != 0)
-              nextHop[next][host].pop_back();
+            s.nexts[next].clear();
+            s.via_nvswitch[next] = 1;
           }
-          nextHop[next][host].push_back(now);
+          s.nexts[next].push_back(now);
         }
-        else if (via_nvswitch == true && now->GetNodeType() == 2)
+        else if (route_node_type[now] == 2)
         {
-          nextHop[next][host].push_back(now);
+          s.nexts[next].push_back(now);
         }
-        if (next->GetNodeType() == 0 && nextHop[next][now].size() == 0)
+        if (route_node_type[next] == 0 && now != host)
         {
-          nextHop[next][now].push_back(now);
-          pairBw[next->GetId()][now->GetId()] = pairBw[now->GetId()][next->GetId()] = it->second.bw;
+          tree.host_nbrs.push_back(make_pair(next, now));
         }
       }
     }
   }
-  for (auto it : delay)
+
+  for (uint32_t v : tree.reached)
   {
-    pairDelay[it.first][host] = it.second;
+    if (v != host)
+    {
+      tree.hop_node.push_back(v);
+      tree.hop_off.push_back(tree.hop_next.size());
+      tree.hop_next.insert(tree.hop_next.end(), s.nexts[v].begin(), s.nexts[v].end());
+    }
+    tree.delay.push_back(s.delay[v]);
+    tree.tx_delay.push_back(s.tx_delay[v]);
+    tree.bw.push_back(s.bw[v]);
+    s.dis[v] = -1;
+    s.nexts[v].clear();
+    s.via_nvswitch[v] = 0;
   }
-  for (auto it : txDelay)
-    pairTxDelay[it.first][host] = it.second;
-  for (auto it : bw)
+  tree.hop_off.push_back(tree.hop_next.size());
+}
+
+void MergeRoute(NodeContainer &n, RouteTree &tree, set<pair<uint32_t, uint32_t>> &host_nbr_seen)
+{
+  uint32_t host = tree.dst;
+  vector<pair<uint32_t, uint32_t>> &entries = route_entries[host];
+  for (uint32_t i = 0; i < tree.hop_node.size(); i++)
   {
-    pairBw[it.first->GetId()][host->GetId()] = it.second;
+    uint32_t off = tree.hop_off[i];
+    uint32_t group = InternEcmpGroup(tree.hop_node[i], &tree.hop_next[off], tree.hop_off[i + 1] - off);
+    entries.push_back(make_pair(tree.hop_node[i], group));
+  }
+  for (auto &nbr : tree.host_nbrs)
+  {
+    uint32_t h = nbr.first, sw = nbr.second;
+    if (!host_nbr_seen.insert(nbr).second)
+      continue;
+    route_entries[sw].push_back(make_pair(h, InternEcmpGroup(h, &sw, 1)));
+    for (auto &adj : route_adj[sw])
+    {
+      if (adj.nbr == h)
+      {
+        pairBw[h][sw] = pairBw[sw][h] = adj.bw;
+        break;
+      }
+    }
+  }
+  Ptr<Node> dst = n.Get(host);
+  for (uint32_t k = 0; k < tree.reached.size(); k++)
+  {
+    uint32_t v = tree.reached[k];
+    if (route_node_type[v] != 0)
+      continue;
+    pairDelay[n.Get(v)][dst] = tree.delay[k];
+    pairTxDelay[n.Get(v)][dst] = tree.tx_delay[k];
+    pairBw[v][host] = tree.bw[k];
   }
 }
 
 void CalculateRoutes(NodeContainer &n)
 {
-  for (int i = 0; i < (int)n.GetN(); i++)
+  auto t0 = std::chrono::steady_clock::now();
+  ClearRoutes();
+  BuildRouteAdjacency(n);
+  uint32_t node_count = n.GetN();
+  route_entries.assign(node_count, vector<pair<uint32_t, uint32_t>>());
+
+  vector<uint32_t> hosts;
+  for (uint32_t i = 0; i < node_count; i++)
+  {
+    if (route_node_type[i] == 0)
+      hosts.push_back(i);
+  }
+
+  uint32_t threads = route_threads;
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min<uint32_t>(threads, std::max<size_t>(hosts.size(), 1));
+
+  vector<RouteScratch> scratch(threads);
+  for (auto &s : scratch)
+  {
+    s.dis.assign(node_count, -1);
+    s.delay.assign(node_count, 0);
+    s.tx_delay.assign(node_count, 0);
+    s.bw.assign(node_count, 0);
+    s.nexts.assign(node_count, vector<uint32_t>());
+    s.via_nvswitch.assign(node_count, 0);
+  }
+
+  set<pair<uint32_t, uint32_t>> host_nbr_seen;
+  uint32_t batch = threads * 64;
+  vector<RouteTree> trees(batch);
+  for (uint32_t begin = 0; begin < hosts.size(); begin += batch)
   {
-    Ptr<Node> node = n.Get(i);
-    if (node->GetNodeType() == 0)
-      CalculateRoute(node);
+    uint32_t end = std::min<uint32_t>(begin + batch, hosts.size());
+    if (threads == 1)
+    {
+      for (uint32_t h = begin; h < end; h++)
+        CalculateRoute(hosts[h], scratch[0], trees[h - begin]);
+    }
+    else
+    {
+      std::atomic<uint32_t> cursor(begin);
+      vector<std::thread> workers;
+      for (uint32_t t = 0; t < threads; t++)
+      {
+        workers.emplace_back([&, t]()
+        {
+          for (uint32_t h = cursor++; h < end; h = cursor++)
+            CalculateRoute(hosts[h], scratch[t], trees[h - begin]);
+        });
+      }
+      for (auto &w : workers)
+        w.join();
+    }
+    for (uint32_t h = begin; h < end; h++)
+      MergeRoute(n, trees[h - begin], host_nbr_seen);
   }
+
+  uint64_t entry_count = 0;
+  for (auto &entries : route_entries)
+    entry_count += entries.size();
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  printf("routes: %zu destinations, %lu entries, %zu ECMP groups, %u threads, %.3fs\n",
+         hosts.size(), entry_count, ecmp_groups.size(), threads, secs);
 }
 
 void SetRoutingEntries()
 {
-  for (auto i = nextHop.begin(); i != nextHop.end(); i++)
+  for (uint32_t d = 0; d < route_entries.size(); d++)
   {
-    Ptr<Node> node = i->first;
-    auto &table = i->second;
-    for (auto j = table.begin(); j != table.end(); j++)
+    if (route_entries[d].empty())
+      continue;
+    Ptr<Node> dst = n.Get(d);
+    Ipv4Address dstAddr = dst->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+    for (auto &entry : route_entries[d])
     {
-      Ptr<Node> dst = j->first;
-      Ipv4Address dstAddr = dst->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
-      vector<Ptr<Node>> nexts = j->second;
-      for (int k = 0; k < (int)nexts.size(); k++)
+      Ptr<Node> node = n.Get(entry.first);
+      EcmpGroup &group = ecmp_groups[entry.second];
+      for (int k = 0; k < (int)group.nexts.size(); k++)
       {
-        Ptr<Node> next = nexts[k];
-        uint32_t interface = nbr2if[node][next].idx;
+        uint32_t next = group.nexts[k];
+        uint32_t interface = group.ifaces[k];
         if (node->GetNodeType() == 1)
         {
           DynamicCast<SwitchNode>(node)->AddTableEntry(dstAddr, interface);
@@ -399,14 +937,14 @@ void SetRoutingEntries()
         else
         {
           bool is_nvswitch = false;
-          if (next->GetNodeType() == 2)
+          if (route_node_type[next] == 2)
           {
             is_nvswitch = true;
           }
           node->GetObject<RdmaDriver>()->m_rdma->AddTableEntry(dstAddr, interface, is_nvswitch);
-          if (next->GetId() == dst->GetId())
+          if (next == d)
           {
-            node->GetObject<RdmaDriver>()->m_rdma->add_nvswitch(dst->GetId());
+            node->GetObject<RdmaDriver>()->m_rdma->add_nvswitch(d);
           }
         }
       }
@@ -420,95 +958,32 @@ void printRoutingEntries()
   types[0] = "HOST";
   types[1] = "SWITCH";
   types[2] = "NVSWITCH";
-  map<Ptr<Node>, map<Ptr<Node>, vector<pair<Ptr<Node>, uint32_t>>>> NVSwitch, NetSwitch, Host;
-  for (auto i = nextHop.begin(); i != nextHop.end(); i++)
-  {
-    Ptr<Node> src = i->first;
-    auto &table = i->second;
-    for (auto j = table.begin(); j != table.end(); j++)
-    {
-      Ptr<Node> dst = j->first;
-      Ipv4Address dstAddr = dst->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
-      vector<Ptr<Node>> nexts = j->second;
-      for (int k = 0; k < (int)nexts.size(); k++)
-      {
-        Ptr<Node> firstHop = nexts[k];
-        uint32_t interface = nbr2if[src][firstHop].idx;
-        if (src->GetNodeType() == 0)
-        {
-          Host[src][dst].push_back(pair<Ptr<Node>, uint32_t>(firstHop, interface));
-        }
-        else if (src->GetNodeType() == 1)
-        {
-          NetSwitch[src][dst].push_back(pair<Ptr<Node>, uint32_t>(firstHop, interface));
-        }
-        else if (src->GetNodeType() == 2)
-        {
-          NVSwitch[src][dst].push_back(pair<Ptr<Node>, uint32_t>(firstHop, interface));
-        }
-      }
-    }
-  }
-
-  cout << "*********************    PRINT SWITCH ROUTING TABLE    *********************" << endl
-       << endl
-       << endl;
-  for (auto it = NetSwitch.begin(); it != NetSwitch.end(); ++it)
+  map<uint32_t, map<uint32_t, uint32_t>> tables[3];
+  for (uint32_t d = 0; d < route_entries.size(); d++)
   {
-    Ptr<Node> src = it->first;
-    auto table = it->second;
-    cout << "SWITCH: " << src->GetId() << "'s routing entries are as follows:" << endl;
-    for (auto j = table.begin(); j != table.end(); ++j)
-    {
-      Ptr<Node> dst = j->first;
-      auto entries = j->second;
-      for (auto k = entries.begin(); k != entries.end(); ++k)
-      {
-        Ptr<Node> nextHop = k->first;
-        uint32_t interface = k->second;
-        cout << "To " << dst->GetId() << "[" << types[dst->GetNodeType()] << "] via " << nextHop->GetId() << "[" << types[nextHop->GetNodeType()] << "]" << " from port: " << interface << endl;
-      }
-    }
+    for (auto &entry : route_entries[d])
+      tables[route_node_type[entry.first]][entry.first][d] = entry.second;
   }
 
-  cout << "*********************    PRINT NVSWITCH ROUTING TABLE    *********************" << endl
-       << endl
-       << endl;
-  for (auto it = NVSwitch.begin(); it != NVSwitch.end(); ++it)
+  const char *titles[3] = {"HOST ROUTING TABLE", "PRINT SWITCH ROUTING TABLE", "PRINT NVSWITCH ROUTING TABLE"};
+  uint32_t print_order[3] = {1, 2, 0};
+  for (uint32_t t : print_order)
   {
-    Ptr<Node> src = it->first;
-    auto table = it->second;
-    cout << "NVSWITCH: " << src->GetId() << "'s routing entries are as follows:" << endl;
-    for (auto j = table.begin(); j != table.end(); ++j)
+    cout << "*********************    " << titles[t] << "    *********************" << endl
+         << endl
+         << endl;
+    for (auto &it : tables[t])
     {
-      Ptr<Node> dst = j->first;
-      auto entries = j->second;
-      for (auto k = entries.begin(); k != entries.end(); ++k)
+      cout << types[t] << ": " << it.first << "'s routing entries are as follows:" << endl;
+      for (auto &j : it.second)
       {
-        Ptr<Node> nextHop = k->first;
-        uint32_t interface = k->second;
-        cout << "To " << dst->GetId() << "[" << types[dst->GetNodeType()] << "] via " << nextHop->GetId() << "[" << types[nextHop->GetNodeType()] << "]" << " from port: " << interface << endl;
-      }
-    }
-  }
-
-  cout << "*********************    HOST ROUTING TABLE    *********************" << endl
-       << endl
-       << endl;
-  for (auto it = Host.begin(); it != Host.end(); ++it)
-  {
-    Ptr<Node> src = it->first;
-    auto table = it->second;
-    cout << "HOST: " << src->GetId() << "'s routing entries are as follows:" << endl;
-    for (auto j = table.begin(); j != table.end(); ++j)
-    {
-      Ptr<Node> dst = j->first;
-      auto entries = j->second;
-      for (auto k = entries.begin(); k != entries.end(); ++k)
-      {
-        Ptr<Node> nextHop = k->first;
-        uint32_t interface = k->second;
-        cout << "To " << dst->GetId() << "[" << types[dst->GetNodeType()] << "] via " << nextHop->GetId() << "[" << types[nextHop->GetNodeType()] << "]" << " from port: " << interface << endl;
+        uint32_t dst = j.first;
+        EcmpGroup &group = ecmp_groups[j.second];
+        for (uint32_t k = 0; k < group.nexts.size(); k++)
+        {
+          uint32_t nextHop = group.nexts[k];
+          cout << "To " << dst << "[" << types[route_node_type[dst]] << "] via " << nextHop << "[" << types[route_node_type[nextHop]] << "]" << " from port: " << group.ifaces[k] << " (group " << j.second << ")" << endl;
+        }
       }
     }
   }
@@ -516,7 +991,16 @@ void printRoutingEntries()
 
 bool validateRoutingEntries()
 {
-  return false;
+  auto start = std::chrono::steady_clock::now();
+  uint32_t threads = route_threads;
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  RoutingReport report = ValidateRoutingTables(route_node_type, route_entries, ecmp_groups, threads);
+  PrintRoutingReport(report, stdout);
+  printf("routing check: %s in %.3fs\n", report.ok() ? "passed" : "FAILED",
+         std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  fflush(stdout);
+  return report.ok();
 }
 
 void TakeDownLink(NodeContainer n, Ptr<Node> a, Ptr<Node> b)
@@ -524,7 +1008,6 @@ void TakeDownLink(NodeContainer n, Ptr<Node> a, Ptr<Node> b)
   if (!nbr2if[a][b].up)
     return;
   nbr2if[a][b].up = nbr2if[b][a].up = false;
-  nextHop.clear();
   CalculateRoutes(n);
   for (uint32_t i = 0; i < n.GetN(); i++)
   {
@@ -825,6 +1308,14 @@ bool ReadConf(string network_topo, string network_conf)
     {
       conf >> buffer_size;
     }
+    else if (key.compare("RENDEZVOUS_THRESHOLD") == 0)
+    {
+      conf >> rendezvous_threshold;
+    }
+    else if (key.compare("RENDEZVOUS_CONTROL_SIZE") == 0)
+    {
+      conf >> rendezvous_control_size;
+    }
     else if (key.compare("QLEN_MON_FILE") == 0)
     {
       conf >> qlen_mon_file;
@@ -865,6 +1356,43 @@ bool ReadConf(string network_topo, string network_conf)
     {
       conf >> qlen_mon_interval;
     }
+    else if (key.compare("ROUTE_THREADS") == 0)
+    {
+      conf >> route_threads;
+    }
+    else if (key.compare("VALIDATE_ROUTING") == 0)
+    {
+      conf >> validate_routing;
+    }
+    else if (key.compare("TELEMETRY_FILE") == 0)
+    {
+      conf >> telemetry_file;
+    }
+    else if (key.compare("TELEMETRY_TOPK_FILE") == 0)
+    {
+      conf >> telemetry_topk_file;
+    }
+    else if (key.compare("TELEMETRY_FORMAT") == 0)
+    {
+      conf >> telemetry_format;
+      if (telemetry_format != "csv" && telemetry_format != "bin")
+      {
+        std::cerr << "Error: TELEMETRY_FORMAT must be csv or bin, got " << telemetry_format << std::endl;
+        return false;
+      }
+    }
+    else if (key.compare("TELEMETRY_INTERVAL") == 0)
+    {
+      conf >> telemetry_interval;
+    }
+    else if (key.compare("TELEMETRY_TOPK") == 0)
+    {
+      conf >> telemetry_topk;
+    }
+    else if (key.compare("TELEMETRY_HOT_THRESHOLD") == 0)
+    {
+      conf >> telemetry_hot_threshold;
+    }
     else if (key.compare("MULTI_RATE") == 0)
     {
       int v;
@@ -919,13 +1447,17 @@ void SetConfig()
   }
 }
 
-void SetupNetwork(void (*qp_finish)(FILE *, Ptr<RdmaQueuePair>), void (*send_finish)(FILE *, Ptr<RdmaQueuePair>))
+// topology_loaded, if set, runs once the topology header globals (node and
+// switch counts, GPU type) are known, before the network is built.
+void SetupNetwork(void (*qp_finish)(FILE *, Ptr<RdmaQueuePair>), void (*send_finish)(FILE *, Ptr<RdmaQueuePair>),
+                  void (*topology_loaded)() = nullptr)
 {
 
-  topof.open(topology_file.c_str());
-  if (!topof.is_open())
+  AstraSim::StartupProfiler::Phase topo_phase("load_topology");
+  std::string topo_err;
+  if (!LoadTopology(topology_file, topo, topo_err))
   {
-    std::cerr << "Error: Unable to open topology file: " << topology_file << std::endl;
+    std::cerr << "Error: " << topo_err << std::endl;
     exit(1);
   }
   flowf.open(flow_file.c_str());
@@ -940,10 +1472,12 @@ void SetupNetwork(void (*qp_finish)(FILE *, Ptr<RdmaQueuePair>), void (*send_fin
     std::cerr << "Error: Unable to open trace file: " << trace_file << std::endl;
     exit(1);
   }
-  string gpu_type_str;
-
-  topof >> node_num >> gpus_per_server >> nvswitch_num >> switch_num >>
-      link_num >> gpu_type_str;
+  node_num = topo.node_num;
+  gpus_per_server = topo.gpus_per_server;
+  nvswitch_num = topo.nvswitch_num;
+  switch_num = topo.switch_num;
+  link_num = topo.links.size();
+  const string &gpu_type_str = topo.gpu_type;
   flowf >> flow_num;
   tracef >> trace_num;
   if (gpu_type_str == "A100")
@@ -974,18 +1508,21 @@ void SetupNetwork(void (*qp_finish)(FILE *, Ptr<RdmaQueuePair>), void (*send_fin
     NVSWITCH = 2
   };
 
+  topo_phase.stop();
+  if (topology_loaded != nullptr)
+    topology_loaded();
+  AstraSim::StartupProfiler::Phase build_phase("build_network");
+
   std::vector<uint32_t> node_type(node_num, NodeType::HOST);
 
   for (uint32_t i = 0; i < nvswitch_num; i++)
   {
-    uint32_t sid;
-    topof >> sid;
+    uint32_t sid = topo.switch_ids[i];
     node_type[sid] = NodeType::NVSWITCH;
   }
   for (uint32_t i = 0; i < switch_num; i++)
   {
-    uint32_t sid;
-    topof >> sid;
+    uint32_t sid = topo.switch_ids[nvswitch_num + i];
     node_type[sid] = NodeType::SWITCH;
   }
   for (uint32_t i = 0; i < node_num; i++)
@@ -1037,10 +1574,11 @@ void SetupNetwork(void (*qp_finish)(FILE *, Ptr<RdmaQueuePair>), void (*send_fin
   Ipv4AddressHelper ipv4;
   for (uint32_t i = 0; i < link_num; i++)
   {
-    uint32_t src, dst;
-    std::string data_rate, link_delay;
-    double error_rate;
-    topof >> src >> dst >> data_rate >> link_delay >> error_rate;
+    const TopoLink &link = topo.links[i];
+    uint32_t src = link.src, dst = link.dst;
+    const std::string &data_rate = topo.rates[link.rate];
+    const std::string &link_delay = topo.delays[link.delay];
+    double error_rate = topo.error_rates[link.error];
     Ptr<Node> snode = n.Get(src), dnode = n.Get(dst);
 
     qbb.SetDeviceAttribute("DataRate", StringValue(data_rate));
@@ -1250,9 +1788,18 @@ void SetupNetwork(void (*qp_finish)(FILE *, Ptr<RdmaQueuePair>), void (*send_fin
   else
     RdmaEgressQueue::ack_q_idx = 3;
 
+  build_phase.stop();
+  AstraSim::StartupProfiler::Phase route_phase("routes");
   CalculateRoutes(n);
   SetRoutingEntries();
+  if (validate_routing && !validateRoutingEntries())
+  {
+    std::cerr << "Error: routing tables failed validation" << std::endl;
+    exit(1);
+  }
+  route_phase.stop();
 
+  AstraSim::StartupProfiler::Phase pair_phase("pair_tables");
   maxRtt = maxBdp = 0;
   for (uint32_t i = 0; i < node_num; i++)
   {
@@ -1276,6 +1823,7 @@ void SetupNetwork(void (*qp_finish)(FILE *, Ptr<RdmaQueuePair>), void (*send_fin
     }
   }
   printf("maxRtt=%lu maxBdp=%lu\n", maxRtt, maxBdp);
+  pair_phase.stop();
 
   for (uint32_t i = 0; i < node_num; i++)
   {
@@ -1378,7 +1926,7 @@ void SetupNetwork(void (*qp_finish)(FILE *, Ptr<RdmaQueuePair>), void (*send_fin
   }
   flow_input.idx = -1;
 
-  topof.close();
+  topo = Topology();
   tracef.close();
 
   if (link_down_time > 0)
@@ -1387,6 +1935,9 @@ void SetupNetwork(void (*qp_finish)(FILE *, Ptr<RdmaQueuePair>), void (*send_fin
                         &TakeDownLink, n, n.Get(link_down_A),
                         n.Get(link_down_B));
   }
+
+  if (!telemetry_file.empty())
+    schedule_telemetry();
 }
 
 void SetPcapTracing(bool pcap_trace, const std::string &pcap_dir)
@@ -54,6 +54,7 @@ struct user_param
 {
   int thread;
   string workload;
+  string jobs;
   string network_topo;
   string network_conf;
   int pcap_trace;
@@ -63,6 +64,7 @@ struct user_param
   {
     thread = 1;
     workload = "";
+    jobs = "";
     network_topo = "";
     network_conf = "";
     pcap_trace = 0;
@@ -450,16 +452,20 @@ void send_finish(FILE *fout, Ptr<RdmaQueuePair> q)
     notify_sender_sending_finished(sid, did, all_sent_chunksize, flowTag);
   }
 }
-int main1(struct user_param user_param)
+int main1(struct user_param user_param, void (*topology_loaded)() = nullptr)
 {
   clock_t begint, endt;
   begint = clock();
 
+  AstraSim::StartupProfiler::Phase conf_phase("read_conf");
   if (!ReadConf(user_param.network_topo, user_param.network_conf))
     return -1;
+  conf_phase.stop();
+  AstraSim::StartupProfiler::Phase config_phase("set_config");
   SetConfig();
   SetPcapTracing(user_param.pcap_trace, user_param.pcap_file);
-  SetupNetwork(qp_finish, send_finish);
+  config_phase.stop();
+  SetupNetwork(qp_finish, send_finish, topology_loaded);
 
   std::cout << "Running Simulation.\n";
   fflush(stdout);
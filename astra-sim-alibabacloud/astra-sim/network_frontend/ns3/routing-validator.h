@@ -0,0 +1,349 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __ROUTING_VALIDATOR_H__
+#define __ROUTING_VALIDATOR_H__
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+ * Consistency checks over the compact routing tables built by
+ * CalculateRoutes. Kept free of ns-3 types so the tests can feed it
+ * hand-built tables.
+ */
+struct EcmpGroup
+{
+  uint32_t node;
+  std::vector<uint32_t> nexts;
+  std::vector<uint32_t> ifaces;
+};
+
+struct RoutingReport
+{
+  uint64_t pairs = 0;
+  uint64_t reachable = 0;
+  uint64_t unreachable = 0;
+  uint64_t black_holes = 0;
+  uint64_t loops = 0;
+  uint64_t unequal_cost = 0;
+  uint64_t asymmetric = 0;
+  bool asymmetry_checked = false;
+  // indexed by shortest hop count between host pairs
+  std::vector<uint64_t> path_len_hist;
+  // indexed by ECMP group width at switch/NVSwitch entries
+  std::vector<uint64_t> ecmp_width_hist;
+  std::vector<std::pair<uint32_t, uint32_t>> failed_pairs;
+  std::vector<std::string> failed_reasons;
+
+  bool ok() const
+  {
+    return unreachable == 0 && black_holes == 0 && loops == 0;
+  }
+};
+
+enum RouteState : uint8_t
+{
+  ROUTE_UNVISITED = 0,
+  ROUTE_ON_STACK,
+  ROUTE_OK,
+  ROUTE_BLACK_HOLE,
+  ROUTE_LOOP
+};
+
+const uint32_t ROUTE_NO_ENTRY = 0xffffffffu;
+const uint32_t ROUTE_MAX_FAILED_SAMPLES = 16;
+// host-pair hop matrix for the symmetry check is only kept up to this many hosts
+const uint32_t ROUTE_SYMMETRY_MAX_HOSTS = 8192;
+
+inline void RecordRouteFailure(RoutingReport &report, uint32_t src, uint32_t dst, const char *reason)
+{
+  if (report.failed_pairs.size() >= ROUTE_MAX_FAILED_SAMPLES)
+    return;
+  report.failed_pairs.push_back(std::make_pair(src, dst));
+  report.failed_reasons.push_back(reason);
+}
+
+/*
+ * For each destination host, every node's entry toward it is loaded into a
+ * per-node group slot, then each source host walks the forwarding DAG with
+ * an iterative DFS. Results are memoized per destination, so the cost is
+ * linear in the table size. A path that reaches a node with no entry is a
+ * black hole, a back edge is a loop, and a source with no entry of its own
+ * is unreachable. Destinations hosts[lo, hi) are checked into report.
+ */
+inline void ValidateRouteDestinations(
+    const std::vector<uint32_t> &hosts, const std::vector<uint32_t> &host_rank,
+    const std::vector<std::vector<std::pair<uint32_t, uint32_t>>> &route_entries,
+    const std::vector<EcmpGroup> &groups, uint32_t lo, uint32_t hi,
+    std::vector<uint16_t> &hops, RoutingReport &report)
+{
+  uint32_t node_count = host_rank.size();
+  uint32_t host_count = hosts.size();
+  std::vector<uint32_t> group_of(node_count, ROUTE_NO_ENTRY);
+  std::vector<uint8_t> state(node_count, ROUTE_UNVISITED);
+  std::vector<uint16_t> len_min(node_count, 0);
+  std::vector<uint16_t> len_max(node_count, 0);
+  std::vector<uint32_t> touched;
+  std::vector<std::pair<uint32_t, uint32_t>> stack;
+
+  for (uint32_t di = lo; di < hi; di++)
+  {
+    uint32_t d = hosts[di];
+    if (d < route_entries.size())
+    {
+      for (auto &entry : route_entries[d])
+        group_of[entry.first] = entry.second;
+    }
+    state[d] = ROUTE_OK;
+    len_min[d] = len_max[d] = 0;
+    touched.push_back(d);
+
+    for (uint32_t s : hosts)
+    {
+      if (s == d)
+        continue;
+      report.pairs++;
+      if (group_of[s] == ROUTE_NO_ENTRY)
+      {
+        report.unreachable++;
+        RecordRouteFailure(report, s, d, "no route at source");
+        continue;
+      }
+      if (state[s] == ROUTE_UNVISITED)
+      {
+        stack.push_back(std::make_pair(s, 0));
+        state[s] = ROUTE_ON_STACK;
+        touched.push_back(s);
+        while (!stack.empty())
+        {
+          uint32_t v = stack.back().first;
+          uint32_t &k = stack.back().second;
+          const std::vector<uint32_t> &nexts = groups[group_of[v]].nexts;
+          if (k < nexts.size())
+          {
+            uint32_t next = nexts[k++];
+            if (state[next] == ROUTE_UNVISITED)
+            {
+              touched.push_back(next);
+              if (group_of[next] == ROUTE_NO_ENTRY)
+              {
+                state[next] = ROUTE_BLACK_HOLE;
+              }
+              else
+              {
+                state[next] = ROUTE_ON_STACK;
+                stack.push_back(std::make_pair(next, 0));
+              }
+            }
+            else if (state[next] == ROUTE_ON_STACK)
+            {
+              // back edge: v and everything above it on the stack loops
+              state[v] = ROUTE_LOOP;
+            }
+            continue;
+          }
+          // all next hops resolved, fold them into v
+          uint8_t result = state[v] == ROUTE_LOOP ? ROUTE_LOOP : ROUTE_OK;
+          uint16_t lo = 0xffff, hi = 0;
+          for (uint32_t next : nexts)
+          {
+            uint8_t st = state[next];
+            if (st == ROUTE_LOOP || st == ROUTE_ON_STACK)
+              result = ROUTE_LOOP;
+            else if (st == ROUTE_BLACK_HOLE && result != ROUTE_LOOP)
+              result = ROUTE_BLACK_HOLE;
+            else if (st == ROUTE_OK)
+            {
+              if (len_min[next] < lo)
+                lo = len_min[next];
+              if (len_max[next] > hi)
+                hi = len_max[next];
+            }
+          }
+          state[v] = result;
+          if (result == ROUTE_OK)
+          {
+            len_min[v] = lo + 1;
+            len_max[v] = hi + 1;
+          }
+          stack.pop_back();
+        }
+      }
+
+      if (state[s] == ROUTE_OK)
+      {
+        report.reachable++;
+        if (report.path_len_hist.size() <= len_min[s])
+          report.path_len_hist.resize(len_min[s] + 1, 0);
+        report.path_len_hist[len_min[s]]++;
+        if (len_min[s] != len_max[s])
+          report.unequal_cost++;
+        if (!hops.empty())
+          hops[(size_t)host_rank[s] * host_count + host_rank[d]] = len_min[s];
+      }
+      else if (state[s] == ROUTE_LOOP)
+      {
+        report.loops++;
+        RecordRouteFailure(report, s, d, "forwarding loop");
+      }
+      else
+      {
+        report.black_holes++;
+        RecordRouteFailure(report, s, d, "black hole on path");
+      }
+    }
+
+    for (uint32_t v : touched)
+      state[v] = ROUTE_UNVISITED;
+    touched.clear();
+    if (d < route_entries.size())
+    {
+      for (auto &entry : route_entries[d])
+        group_of[entry.first] = ROUTE_NO_ENTRY;
+    }
+  }
+}
+
+inline RoutingReport ValidateRoutingTables(
+    const std::vector<uint32_t> &node_type,
+    const std::vector<std::vector<std::pair<uint32_t, uint32_t>>> &route_entries,
+    const std::vector<EcmpGroup> &groups, uint32_t threads = 1)
+{
+  RoutingReport report;
+  uint32_t node_count = node_type.size();
+  std::vector<uint32_t> hosts;
+  std::vector<uint32_t> host_rank(node_count, ROUTE_NO_ENTRY);
+  for (uint32_t i = 0; i < node_count; i++)
+  {
+    if (node_type[i] == 0)
+    {
+      host_rank[i] = hosts.size();
+      hosts.push_back(i);
+    }
+  }
+
+  for (uint32_t d = 0; d < route_entries.size() && d < node_count; d++)
+  {
+    for (auto &entry : route_entries[d])
+    {
+      if (node_type[entry.first] == 0)
+        continue;
+      uint32_t width = groups[entry.second].nexts.size();
+      if (report.ecmp_width_hist.size() <= width)
+        report.ecmp_width_hist.resize(width + 1, 0);
+      report.ecmp_width_hist[width]++;
+    }
+  }
+
+  uint32_t host_count = hosts.size();
+  report.asymmetry_checked = host_count <= ROUTE_SYMMETRY_MAX_HOSTS;
+  std::vector<uint16_t> hops;
+  if (report.asymmetry_checked)
+    hops.assign((size_t)host_count * host_count, 0);
+
+  // contiguous destination blocks, merged in order so samples are deterministic
+  if (threads == 0)
+    threads = 1;
+  if (threads > host_count)
+    threads = host_count > 0 ? host_count : 1;
+  std::vector<RoutingReport> parts(threads);
+  std::vector<std::thread> workers;
+  for (uint32_t t = 0; t < threads; t++)
+  {
+    uint32_t lo = (uint64_t)host_count * t / threads;
+    uint32_t hi = (uint64_t)host_count * (t + 1) / threads;
+    if (threads == 1)
+      ValidateRouteDestinations(hosts, host_rank, route_entries, groups, lo, hi, hops, parts[t]);
+    else
+      workers.emplace_back(ValidateRouteDestinations, std::cref(hosts), std::cref(host_rank),
+                           std::cref(route_entries), std::cref(groups), lo, hi,
+                           std::ref(hops), std::ref(parts[t]));
+  }
+  for (auto &worker : workers)
+    worker.join();
+
+  for (auto &part : parts)
+  {
+    report.pairs += part.pairs;
+    report.reachable += part.reachable;
+    report.unreachable += part.unreachable;
+    report.black_holes += part.black_holes;
+    report.loops += part.loops;
+    report.unequal_cost += part.unequal_cost;
+    if (report.path_len_hist.size() < part.path_len_hist.size())
+      report.path_len_hist.resize(part.path_len_hist.size(), 0);
+    for (uint32_t i = 0; i < part.path_len_hist.size(); i++)
+      report.path_len_hist[i] += part.path_len_hist[i];
+    for (uint32_t i = 0; i < part.failed_pairs.size(); i++)
+    {
+      RecordRouteFailure(report, part.failed_pairs[i].first, part.failed_pairs[i].second,
+                         part.failed_reasons[i].c_str());
+    }
+  }
+
+  if (report.asymmetry_checked)
+  {
+    for (uint32_t a = 0; a < host_count; a++)
+    {
+      for (uint32_t b = a + 1; b < host_count; b++)
+      {
+        uint16_t ab = hops[(size_t)a * host_count + b];
+        uint16_t ba = hops[(size_t)b * host_count + a];
+        if (ab != 0 && ba != 0 && ab != ba)
+          report.asymmetric++;
+      }
+    }
+  }
+  return report;
+}
+
+inline void PrintRoutingReport(const RoutingReport &report, FILE *out)
+{
+  fprintf(out, "routing check: %lu host pairs, %lu reachable, %lu unreachable, %lu black holes, %lu loops\n",
+          (unsigned long)report.pairs, (unsigned long)report.reachable,
+          (unsigned long)report.unreachable, (unsigned long)report.black_holes,
+          (unsigned long)report.loops);
+  fprintf(out, "routing check: %lu pairs with unequal-cost ECMP", (unsigned long)report.unequal_cost);
+  if (report.asymmetry_checked)
+    fprintf(out, ", %lu asymmetric pairs\n", (unsigned long)report.asymmetric);
+  else
+    fprintf(out, ", symmetry not checked (more than %u hosts)\n", ROUTE_SYMMETRY_MAX_HOSTS);
+  fprintf(out, "routing check: path length (hops:pairs)");
+  for (uint32_t i = 0; i < report.path_len_hist.size(); i++)
+  {
+    if (report.path_len_hist[i] > 0)
+      fprintf(out, " %u:%lu", i, (unsigned long)report.path_len_hist[i]);
+  }
+  fprintf(out, "\nrouting check: ECMP width (width:entries)");
+  for (uint32_t i = 0; i < report.ecmp_width_hist.size(); i++)
+  {
+    if (report.ecmp_width_hist[i] > 0)
+      fprintf(out, " %u:%lu", i, (unsigned long)report.ecmp_width_hist[i]);
+  }
+  fprintf(out, "\n");
+  for (uint32_t i = 0; i < report.failed_pairs.size(); i++)
+  {
+    fprintf(out, "routing check: %u -> %u: %s\n", report.failed_pairs[i].first,
+            report.failed_pairs[i].second, report.failed_reasons[i].c_str());
+  }
+}
+
+#endif
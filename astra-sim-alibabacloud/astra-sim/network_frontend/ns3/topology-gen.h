@@ -0,0 +1,656 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __TOPOLOGY_GEN_H__
+#define __TOPOLOGY_GEN_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+ * Native counterpart of inputs/topo/gen_Topo_Template.py. A topology is held
+ * in memory as the same data the text format carries: the header counts, the
+ * switch id list (NVSwitches first) and the link list. Link rates and delays
+ * are ns-3 attribute strings ("400Gbps", "0.0005ms"); they and the error
+ * rates repeat across thousands of links, so they are interned and a link
+ * record is three small indices.
+ *
+ * Three ways to get one into SetupNetwork:
+ *   - the legacy text file produced by the Python script,
+ *   - the binary format written by WriteTopologyBinary (magic SIMTOPO1),
+ *   - a "gen:" spec such as "gen:Spectrum-X,g=128,gt=A100,bw=100Gbps",
+ *     generated in memory without touching the file system.
+ */
+
+struct TopoLink
+{
+  uint32_t src;
+  uint32_t dst;
+  uint16_t rate;
+  uint16_t delay;
+  uint32_t error;
+};
+
+struct Topology
+{
+  std::string name;
+  uint32_t node_num = 0;
+  uint32_t gpus_per_server = 0;
+  uint32_t nvswitch_num = 0;
+  uint32_t switch_num = 0;
+  std::string gpu_type;
+  // nvswitch_num NVSwitch ids followed by switch_num switch ids
+  std::vector<uint32_t> switch_ids;
+  std::vector<std::string> rates;
+  std::vector<std::string> delays;
+  std::vector<double> error_rates;
+  std::vector<TopoLink> links;
+
+  uint16_t InternRate(const std::string &rate) { return Intern(rates, rate); }
+  uint16_t InternDelay(const std::string &delay) { return Intern(delays, delay); }
+
+  void AddLink(uint32_t src, uint32_t dst, uint16_t rate, uint16_t delay, double error_rate)
+  {
+    TopoLink link;
+    link.src = src;
+    link.dst = dst;
+    link.rate = rate;
+    link.delay = delay;
+    link.error = Intern(error_rates, error_rate);
+    links.push_back(link);
+  }
+
+private:
+  template <typename T>
+  static uint32_t Intern(std::vector<T> &table, const T &value)
+  {
+    for (uint32_t i = 0; i < table.size(); i++)
+    {
+      if (table[i] == value)
+        return i;
+    }
+    table.push_back(value);
+    return table.size() - 1;
+  }
+};
+
+/*
+ * Parameters mirror the Python script's options; TopoTemplate fills in the
+ * per-family defaults the same way analysis_template does.
+ */
+struct TopoSpec
+{
+  std::string topology;
+  bool rail_optimized = true;
+  bool dual_tor = false;
+  bool dual_plane = false;
+  uint32_t gpu = 32;
+  double error_rate = 0;
+  uint32_t gpu_per_server = 8;
+  std::string gpu_type = "H100";
+  uint32_t nv_switch_per_server = 1;
+  std::string nvlink_bw = "2880Gbps";
+  std::string nv_latency = "0.000025ms";
+  std::string latency = "0.0005ms";
+  std::string bandwidth = "400Gbps";
+  uint32_t asw_switch_num = 8;
+  uint32_t nics_per_aswitch = 64;
+  uint32_t psw_switch_num = 64;
+  std::string ap_bandwidth = "400Gbps";
+  uint32_t asw_per_psw = 64;
+  // fat-tree switch radix, 0 picks the smallest radix that fits gpu
+  uint32_t fat_tree_k = 0;
+};
+
+inline bool TopoTemplate(const std::string &topology, bool rail_optimized, bool dual_tor, bool dual_plane,
+                         TopoSpec &spec, std::string &err)
+{
+  spec = TopoSpec();
+  spec.topology = topology;
+  spec.rail_optimized = rail_optimized;
+  spec.dual_tor = dual_tor;
+  spec.dual_plane = dual_plane;
+  if (topology == "Spectrum-X")
+  {
+    spec.gpu = 4096;
+    spec.rail_optimized = true;
+    spec.dual_tor = false;
+    spec.dual_plane = false;
+  }
+  else if (topology == "AlibabaHPN")
+  {
+    spec.gpu = 15360;
+    spec.bandwidth = "200Gbps";
+    spec.asw_switch_num = 240;
+    spec.nics_per_aswitch = 128;
+    spec.psw_switch_num = 120;
+    spec.asw_per_psw = dual_plane ? 120 : 240;
+    spec.rail_optimized = true;
+    spec.dual_tor = true;
+  }
+  else if (topology == "DCN+")
+  {
+    spec.gpu = 512;
+    spec.asw_switch_num = 8;
+    spec.asw_per_psw = 8;
+    spec.psw_switch_num = 8;
+    spec.rail_optimized = false;
+    spec.dual_plane = false;
+    if (dual_tor)
+    {
+      spec.bandwidth = "200Gbps";
+      spec.nics_per_aswitch = 128;
+    }
+  }
+  else if (topology == "rail-optimized")
+  {
+    spec.rail_optimized = true;
+  }
+  else if (topology == "fat-tree")
+  {
+    spec.rail_optimized = false;
+    spec.dual_tor = false;
+    spec.dual_plane = false;
+  }
+  else if (!topology.empty())
+  {
+    err = "unknown topology template: " + topology;
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Accepts both the short and long option names of gen_Topo_Template.py,
+ * without the leading dashes. Structural flags (ro/dt/dp) are consumed by
+ * TopoTemplate and rejected here.
+ */
+inline bool SetTopoParam(TopoSpec &spec, const std::string &key, const std::string &value, std::string &err)
+{
+  if (key == "g" || key == "gpu")
+    spec.gpu = std::stoul(value);
+  else if (key == "er" || key == "error_rate")
+    spec.error_rate = std::stod(value);
+  else if (key == "gps" || key == "gpu_per_server")
+    spec.gpu_per_server = std::stoul(value);
+  else if (key == "gt" || key == "gpu_type")
+    spec.gpu_type = value;
+  else if (key == "nsps" || key == "nv_switch_per_server")
+    spec.nv_switch_per_server = std::stoul(value);
+  else if (key == "nvbw" || key == "nvlink_bw")
+    spec.nvlink_bw = value;
+  else if (key == "nl" || key == "nv_latency")
+    spec.nv_latency = value;
+  else if (key == "l" || key == "latency")
+    spec.latency = value;
+  else if (key == "bw" || key == "bandwidth")
+    spec.bandwidth = value;
+  else if (key == "asn" || key == "asw_switch_num")
+    spec.asw_switch_num = std::stoul(value);
+  else if (key == "npa" || key == "nics_per_aswitch")
+    spec.nics_per_aswitch = std::stoul(value);
+  else if (key == "psn" || key == "psw_switch_num")
+    spec.psw_switch_num = std::stoul(value);
+  else if (key == "apbw" || key == "ap_bandwidth")
+    spec.ap_bandwidth = value;
+  else if (key == "app" || key == "asw_per_psw")
+    spec.asw_per_psw = std::stoul(value);
+  else if (key == "k" || key == "fat_tree_k")
+    spec.fat_tree_k = std::stoul(value);
+  else
+  {
+    err = "unknown topology parameter: " + key;
+    return false;
+  }
+  return true;
+}
+
+/*
+ * "Spectrum-X,g=128,gt=A100" or "AlibabaHPN,dp,g=64,asn=16,psn=16": the
+ * template name comes first (empty for a custom rail/non-rail build), bare
+ * ro/dt/dp words are the structural flags and key=value pairs override
+ * the template defaults.
+ */
+inline bool ParseTopoSpec(const std::string &text, TopoSpec &spec, std::string &err)
+{
+  std::vector<std::string> fields;
+  size_t start = 0;
+  while (start <= text.size())
+  {
+    size_t end = text.find(',', start);
+    if (end == std::string::npos)
+      end = text.size();
+    fields.push_back(text.substr(start, end - start));
+    start = end + 1;
+  }
+  bool ro = false, dt = false, dp = false;
+  std::string topology;
+  for (uint32_t i = 0; i < fields.size(); i++)
+  {
+    if (fields[i] == "ro")
+      ro = true;
+    else if (fields[i] == "dt")
+      dt = true;
+    else if (fields[i] == "dp")
+      dp = true;
+    else if (i == 0 && fields[i].find('=') == std::string::npos)
+      topology = fields[i];
+  }
+  if (!TopoTemplate(topology, ro, dt, dp, spec, err))
+    return false;
+  for (auto &field : fields)
+  {
+    size_t eq = field.find('=');
+    if (eq == std::string::npos)
+      continue;
+    try
+    {
+      if (!SetTopoParam(spec, field.substr(0, eq), field.substr(eq + 1), err))
+        return false;
+    }
+    catch (const std::exception &)
+    {
+      err = "bad value in topology parameter: " + field;
+      return false;
+    }
+  }
+  return true;
+}
+
+inline std::string TopoDefaultName(const TopoSpec &spec)
+{
+  std::string g = std::to_string(spec.gpu) + "g_" + std::to_string(spec.gpu_per_server) + "gps_";
+  std::string tail = spec.bandwidth + "_" + spec.gpu_type;
+  if (spec.topology == "fat-tree")
+    return "FatTree_k" + std::to_string(spec.fat_tree_k) + "_" + g + tail;
+  if (!spec.rail_optimized)
+  {
+    if (spec.topology == "DCN+")
+      return std::string(spec.dual_tor ? "DCN+DualToR_" : "DCN+SingleToR_") + g + tail;
+    return "No_Rail_Opti_" + g + (spec.dual_tor ? "DualToR_" : "SingleToR_") + tail;
+  }
+  if (!spec.dual_tor)
+  {
+    if (spec.topology == "Spectrum-X")
+      return "Spectrum-X_" + g + tail;
+    return "Rail_Opti_SingleToR_" + g + tail;
+  }
+  std::string plane = spec.dual_plane ? "DualToR_DualPlane_" : "DualToR_SinglePlane_";
+  if (spec.topology == "AlibabaHPN")
+    return "AlibabaHPN_" + g + plane + tail;
+  return "Rail_Opti_" + g + plane + tail;
+}
+
+/*
+ * The two-tier ASW/PSW families. Rail-optimized builds give every GPU
+ * index within a server its own ASW per segment; dual ToR duplicates the
+ * ASW tier into two halves and dual plane splits the PSWs between them.
+ * Node ids, link order and the asw_switch_num correction follow the Python
+ * generator so both produce the same file.
+ */
+inline bool GenerateLeafSpine(TopoSpec &spec, Topology &topo, std::string &err)
+{
+  uint32_t tors = spec.dual_tor ? 2 : 1;
+  uint32_t lanes = spec.rail_optimized ? spec.gpu_per_server : 1;
+  uint32_t per_segment = lanes * tors;
+  uint32_t gpus_per_segment = spec.nics_per_aswitch * lanes;
+  uint32_t segment_num = (spec.gpu + gpus_per_segment - 1) / gpus_per_segment;
+  if (segment_num * per_segment != spec.asw_switch_num)
+  {
+    fprintf(stderr, "warning: asw_switch_num %u does not match %u GPUs, using %u\n",
+            spec.asw_switch_num, spec.gpu, segment_num * per_segment);
+    spec.asw_switch_num = segment_num * per_segment;
+  }
+  uint32_t segment_limit = spec.rail_optimized ? spec.asw_per_psw / lanes : spec.asw_per_psw / per_segment;
+  if (segment_num > segment_limit)
+  {
+    err = "number of GPUs exceeds the capacity of one pod";
+    return false;
+  }
+
+  uint32_t nv_switch_num = spec.gpu / spec.gpu_per_server * spec.nv_switch_per_server;
+  uint32_t nv_base = spec.gpu;
+  uint32_t asw_base = nv_base + nv_switch_num;
+  uint32_t asw_half = spec.asw_switch_num / tors;
+  uint32_t psw_base = asw_base + spec.asw_switch_num;
+  uint32_t psw_plane = spec.dual_plane ? (spec.psw_switch_num + 1) / 2 : spec.psw_switch_num;
+
+  topo.node_num = psw_base + spec.psw_switch_num;
+  topo.gpus_per_server = spec.gpu_per_server;
+  topo.nvswitch_num = nv_switch_num;
+  topo.switch_num = spec.asw_switch_num + spec.psw_switch_num;
+  topo.gpu_type = spec.gpu_type;
+  for (uint32_t i = nv_base; i < topo.node_num; i++)
+    topo.switch_ids.push_back(i);
+
+  uint16_t nv_rate = topo.InternRate(spec.nvlink_bw);
+  uint16_t nv_delay = topo.InternDelay(spec.nv_latency);
+  uint16_t nic_rate = topo.InternRate(spec.bandwidth);
+  uint16_t nic_delay = topo.InternDelay(spec.latency);
+  uint16_t ap_rate = topo.InternRate(spec.ap_bandwidth);
+  for (uint32_t i = 0; i < spec.gpu; i++)
+  {
+    uint32_t server = i / spec.gpu_per_server;
+    for (uint32_t j = 0; j < spec.nv_switch_per_server; j++)
+      topo.AddLink(i, nv_base + server * spec.nv_switch_per_server + j, nv_rate, nv_delay, spec.error_rate);
+    uint32_t asw = i / gpus_per_segment * lanes + (spec.rail_optimized ? i % spec.gpu_per_server : 0);
+    for (uint32_t t = 0; t < tors; t++)
+      topo.AddLink(i, asw_base + t * asw_half + asw, nic_rate, nic_delay, spec.error_rate);
+  }
+  for (uint32_t t = 0; t < tors; t++)
+  {
+    uint32_t psw_first = spec.dual_plane ? t * psw_plane : 0;
+    uint32_t psw_last = spec.dual_plane ? std::min(psw_first + psw_plane, spec.psw_switch_num) : spec.psw_switch_num;
+    for (uint32_t a = 0; a < asw_half; a++)
+    {
+      for (uint32_t p = psw_first; p < psw_last; p++)
+        topo.AddLink(asw_base + t * asw_half + a, psw_base + p, ap_rate, nic_delay, spec.error_rate);
+    }
+  }
+  return true;
+}
+
+/*
+ * Three-tier k-ary fat-tree: each pod has k/2 edge and k/2 aggregation
+ * switches, every edge switch serves k/2 GPUs and aggregation switch j of
+ * every pod connects to core switches [j*k/2, (j+1)*k/2). Only the pods
+ * needed for spec.gpu are built; the core tier is always complete.
+ */
+inline bool GenerateFatTree(TopoSpec &spec, Topology &topo, std::string &err)
+{
+  if (spec.fat_tree_k == 0)
+  {
+    spec.fat_tree_k = 2;
+    while ((uint64_t)spec.fat_tree_k * spec.fat_tree_k * spec.fat_tree_k / 4 < spec.gpu)
+      spec.fat_tree_k += 2;
+  }
+  uint32_t k = spec.fat_tree_k;
+  uint32_t half = k / 2;
+  if (k % 2 != 0 || (uint64_t)k * k * k / 4 < spec.gpu)
+  {
+    err = "fat-tree radix must be even and hold k^3/4 >= gpu";
+    return false;
+  }
+  uint32_t pods = (spec.gpu + half * half - 1) / (half * half);
+  uint32_t edges = (spec.gpu + half - 1) / half;
+  uint32_t nv_switch_num = spec.gpu / spec.gpu_per_server * spec.nv_switch_per_server;
+  uint32_t nv_base = spec.gpu;
+  uint32_t edge_base = nv_base + nv_switch_num;
+  uint32_t agg_base = edge_base + edges;
+  uint32_t core_base = agg_base + pods * half;
+
+  topo.node_num = core_base + half * half;
+  topo.gpus_per_server = spec.gpu_per_server;
+  topo.nvswitch_num = nv_switch_num;
+  topo.switch_num = topo.node_num - edge_base;
+  topo.gpu_type = spec.gpu_type;
+  for (uint32_t i = nv_base; i < topo.node_num; i++)
+    topo.switch_ids.push_back(i);
+
+  uint16_t nv_rate = topo.InternRate(spec.nvlink_bw);
+  uint16_t nv_delay = topo.InternDelay(spec.nv_latency);
+  uint16_t nic_rate = topo.InternRate(spec.bandwidth);
+  uint16_t nic_delay = topo.InternDelay(spec.latency);
+  uint16_t ap_rate = topo.InternRate(spec.ap_bandwidth);
+  for (uint32_t i = 0; i < spec.gpu; i++)
+  {
+    uint32_t server = i / spec.gpu_per_server;
+    for (uint32_t j = 0; j < spec.nv_switch_per_server; j++)
+      topo.AddLink(i, nv_base + server * spec.nv_switch_per_server + j, nv_rate, nv_delay, spec.error_rate);
+    topo.AddLink(i, edge_base + i / half, nic_rate, nic_delay, spec.error_rate);
+  }
+  for (uint32_t e = 0; e < edges; e++)
+  {
+    uint32_t pod = e / half;
+    for (uint32_t a = 0; a < half; a++)
+      topo.AddLink(edge_base + e, agg_base + pod * half + a, ap_rate, nic_delay, spec.error_rate);
+  }
+  for (uint32_t a = 0; a < pods * half; a++)
+  {
+    for (uint32_t c = 0; c < half; c++)
+      topo.AddLink(agg_base + a, core_base + (a % half) * half + c, ap_rate, nic_delay, spec.error_rate);
+  }
+  return true;
+}
+
+inline bool GenerateTopology(TopoSpec &spec, Topology &topo, std::string &err)
+{
+  topo = Topology();
+  if (spec.gpu == 0 || spec.gpu_per_server == 0 || spec.nics_per_aswitch == 0)
+  {
+    err = "gpu, gpu_per_server and nics_per_aswitch must be positive";
+    return false;
+  }
+  if (spec.gpu % spec.gpu_per_server != 0)
+  {
+    err = "gpu must be a multiple of gpu_per_server";
+    return false;
+  }
+  if (!spec.rail_optimized && spec.dual_plane)
+  {
+    err = "non rail-optimized structure doesn't support dual plane";
+    return false;
+  }
+  if (spec.rail_optimized && !spec.dual_tor && spec.dual_plane)
+  {
+    err = "rail-optimized single-ToR structure doesn't support dual plane";
+    return false;
+  }
+  bool ok = spec.topology == "fat-tree" ? GenerateFatTree(spec, topo, err) : GenerateLeafSpine(spec, topo, err);
+  if (ok)
+    topo.name = TopoDefaultName(spec);
+  return ok;
+}
+
+inline bool WriteTopologyText(const Topology &topo, const std::string &path)
+{
+  FILE *f = fopen(path.c_str(), "w");
+  if (f == NULL)
+    return false;
+  fprintf(f, "%u %u %u %u %lu %s\n", topo.node_num, topo.gpus_per_server, topo.nvswitch_num,
+          topo.switch_num, (unsigned long)topo.links.size(), topo.gpu_type.c_str());
+  for (uint32_t id : topo.switch_ids)
+    fprintf(f, "%u ", id);
+  fprintf(f, "\n");
+  for (auto &link : topo.links)
+  {
+    fprintf(f, "%u %u %s %s %g\n", link.src, link.dst, topo.rates[link.rate].c_str(),
+            topo.delays[link.delay].c_str(), topo.error_rates[link.error]);
+  }
+  return fclose(f) == 0;
+}
+
+const char TOPOLOGY_BINARY_MAGIC[8] = {'S', 'I', 'M', 'T', 'O', 'P', 'O', '1'};
+
+/*
+ * Binary layout, host byte order:
+ *   magic[8], node_num, gpus_per_server, nvswitch_num, switch_num, link_num,
+ *   gpu_type, rate table, delay table (u32 count + u32 length-prefixed
+ *   strings), error rate table (u32 count + doubles), switch ids (u32),
+ *   then link_num 12-byte TopoLink records.
+ */
+inline void TopoWriteString(FILE *f, const std::string &s)
+{
+  uint32_t len = s.size();
+  fwrite(&len, sizeof(len), 1, f);
+  fwrite(s.data(), 1, len, f);
+}
+
+inline bool TopoReadString(FILE *f, std::string &s)
+{
+  uint32_t len;
+  if (fread(&len, sizeof(len), 1, f) != 1 || len > (1u << 20))
+    return false;
+  s.resize(len);
+  return len == 0 || fread(&s[0], 1, len, f) == len;
+}
+
+inline bool WriteTopologyBinary(const Topology &topo, const std::string &path)
+{
+  FILE *f = fopen(path.c_str(), "wb");
+  if (f == NULL)
+    return false;
+  uint32_t header[5] = {topo.node_num, topo.gpus_per_server, topo.nvswitch_num, topo.switch_num,
+                        (uint32_t)topo.links.size()};
+  fwrite(TOPOLOGY_BINARY_MAGIC, 1, sizeof(TOPOLOGY_BINARY_MAGIC), f);
+  fwrite(header, sizeof(uint32_t), 5, f);
+  TopoWriteString(f, topo.gpu_type);
+  for (const std::vector<std::string> *table : {&topo.rates, &topo.delays})
+  {
+    uint32_t count = table->size();
+    fwrite(&count, sizeof(count), 1, f);
+    for (auto &s : *table)
+      TopoWriteString(f, s);
+  }
+  uint32_t error_count = topo.error_rates.size();
+  fwrite(&error_count, sizeof(error_count), 1, f);
+  fwrite(topo.error_rates.data(), sizeof(double), error_count, f);
+  fwrite(topo.switch_ids.data(), sizeof(uint32_t), topo.switch_ids.size(), f);
+  fwrite(topo.links.data(), sizeof(TopoLink), topo.links.size(), f);
+  return fclose(f) == 0;
+}
+
+inline bool ReadTopologyBinary(FILE *f, Topology &topo, std::string &err)
+{
+  uint32_t header[5];
+  if (fread(header, sizeof(uint32_t), 5, f) != 5)
+  {
+    err = "truncated binary topology header";
+    return false;
+  }
+  topo.node_num = header[0];
+  topo.gpus_per_server = header[1];
+  topo.nvswitch_num = header[2];
+  topo.switch_num = header[3];
+  bool ok = TopoReadString(f, topo.gpu_type);
+  for (std::vector<std::string> *table : {&topo.rates, &topo.delays})
+  {
+    uint32_t count = 0;
+    ok = ok && fread(&count, sizeof(count), 1, f) == 1 && count <= 0x10000;
+    if (ok)
+      table->resize(count);
+    for (uint32_t i = 0; ok && i < count; i++)
+      ok = TopoReadString(f, (*table)[i]);
+  }
+  uint32_t error_count = 0;
+  ok = ok && fread(&error_count, sizeof(error_count), 1, f) == 1 && error_count <= header[4] + 1;
+  if (ok)
+  {
+    topo.error_rates.resize(error_count);
+    ok = fread(topo.error_rates.data(), sizeof(double), error_count, f) == error_count;
+  }
+  if (!ok)
+  {
+    err = "corrupt binary topology attribute tables";
+    return false;
+  }
+  if ((uint64_t)topo.nvswitch_num + topo.switch_num > topo.node_num)
+  {
+    err = "binary topology has more switches than nodes";
+    return false;
+  }
+  topo.switch_ids.resize(topo.nvswitch_num + topo.switch_num);
+  topo.links.resize(header[4]);
+  if (fread(topo.switch_ids.data(), sizeof(uint32_t), topo.switch_ids.size(), f) != topo.switch_ids.size() ||
+      fread(topo.links.data(), sizeof(TopoLink), topo.links.size(), f) != topo.links.size())
+  {
+    err = "truncated binary topology body";
+    return false;
+  }
+  for (uint32_t sid : topo.switch_ids)
+  {
+    if (sid >= topo.node_num)
+    {
+      err = "binary topology switch id " + std::to_string(sid) + " out of range, the topology has " +
+            std::to_string(topo.node_num) + " nodes";
+      return false;
+    }
+  }
+  for (auto &link : topo.links)
+  {
+    if (link.src >= topo.node_num || link.dst >= topo.node_num ||
+        link.rate >= topo.rates.size() || link.delay >= topo.delays.size() ||
+        link.error >= topo.error_rates.size())
+    {
+      err = "binary topology link out of range";
+      return false;
+    }
+  }
+  return true;
+}
+
+inline bool ReadTopologyText(const std::string &path, Topology &topo, std::string &err)
+{
+  std::ifstream topof(path.c_str());
+  uint32_t link_num = 0;
+  topof >> topo.node_num >> topo.gpus_per_server >> topo.nvswitch_num >> topo.switch_num >> link_num >>
+      topo.gpu_type;
+  topo.switch_ids.resize(topo.nvswitch_num + topo.switch_num);
+  for (auto &id : topo.switch_ids)
+    topof >> id;
+  topo.links.reserve(link_num);
+  std::string data_rate, link_delay;
+  for (uint32_t i = 0; i < link_num; i++)
+  {
+    uint32_t src, dst;
+    double error_rate;
+    topof >> src >> dst >> data_rate >> link_delay >> error_rate;
+    topo.AddLink(src, dst, topo.InternRate(data_rate), topo.InternDelay(link_delay), error_rate);
+  }
+  if (!topof)
+  {
+    err = "malformed topology file: " + path;
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Loads a topology from a "gen:" spec, a binary file or a legacy text
+ * file, in that order of detection.
+ */
+inline bool LoadTopology(const std::string &source, Topology &topo, std::string &err)
+{
+  topo = Topology();
+  if (source.compare(0, 4, "gen:") == 0)
+  {
+    TopoSpec spec;
+    return ParseTopoSpec(source.substr(4), spec, err) && GenerateTopology(spec, topo, err);
+  }
+  FILE *f = fopen(source.c_str(), "rb");
+  if (f == NULL)
+  {
+    err = "Unable to open topology file: " + source;
+    return false;
+  }
+  char magic[sizeof(TOPOLOGY_BINARY_MAGIC)];
+  bool binary = fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+                memcmp(magic, TOPOLOGY_BINARY_MAGIC, sizeof(magic)) == 0;
+  bool ok = binary ? ReadTopologyBinary(f, topo, err) : false;
+  fclose(f);
+  if (!binary)
+    ok = ReadTopologyText(source, topo, err);
+  topo.name = source;
+  return ok;
+}
+
+#endif
@@ -97,10 +97,12 @@ void send_flow(int src, int dst, uint64_t maxPacketCount,
       flowtag.pQps,
       flowtag.tag_id,
       flowtag.nvls_on);
-  send_data.child_flow_size = flowtag.tree_flow_list.size();
-  for (int i = 0; i < flowtag.tree_flow_list.size(); i++) {
-    send_data.child_flow_list[i] = flowtag.tree_flow_list[i];
+  const std::vector<int>& tree_flow_list = flowtag.tree_flow_list();
+  send_data.child_flow_size = tree_flow_list.size();
+  for (int i = 0; i < tree_flow_list.size(); i++) {
+    send_data.child_flow_list[i] = tree_flow_list[i];
   }
+  send_data.tree_flow_handle = flowtag.tree_flow_handle;
   NcclLog->writeLog(
       NcclLogLevel::DEBUG,
       "SendPackets %d SendFlow to %d channelid: %d flow_id: %d size: %lu tag_id %d",
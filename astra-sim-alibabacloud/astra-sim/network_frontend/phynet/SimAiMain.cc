@@ -70,16 +70,18 @@ static int user_param_prase(int argc,char * argv[],struct user_param* user_param
   static struct option long_options[] = {
         {"help", no_argument, 0, 'h'},
         {"workloads", required_argument, 0, 'w'},
+        {"bench", required_argument, 0, 'b'},
         {"gpus", required_argument, 0, 'g'},
         {"comm_scale", required_argument, 0, 's'},
         {"gid_index", required_argument, 0, 'i'},
         {0, 0, 0, 0}};
-  while ((opt = getopt(argc,argv,"ht:w:g:s:i:"))!=-1){
+  while ((opt = getopt(argc,argv,"ht:w:b:g:s:i:"))!=-1){
     switch (opt)
     {
     case 'h':
       /* code */
       std::cout<<"-w    workloads default microAllReduce.txt "<<std::endl;
+      std::cout<<"-b    collective sweep instead of -w, e.g. allreduce,min=1M,max=1G,group=tp"<<std::endl;
       std::cout<<"-g    number of gpus,default 1"<<std::endl;
       std::cout<<"-s    comm_scale default 1"<<std::endl;
       std::cout<<"-i    rdma gid_indxe default 0" <<std::endl;
@@ -90,6 +92,9 @@ static int user_param_prase(int argc,char * argv[],struct user_param* user_param
     case 'w':
       user_param->workload = optarg;
       break;
+    case 'b':
+      user_param->workload = std::string("bench:") + optarg;
+      break;
     case 'g':
       user_param->gpus = stoi(optarg);
       if(user_param->gpus <= 8){
@@ -13,6 +13,7 @@ LICENSE file in the root directory of this source tree.
 #include <map>
 #include "AstraMemoryAPI.hh"
 #include "AstraSimDataAPI.hh"
+#include "FlowTagSlab.hh"
 namespace AstraSim {
 struct sim_comm {
   std::string comm_name;
@@ -36,8 +37,11 @@ struct ncclFlowTag {
   uint64_t flow_size;
   void* pQps;
   int tag_id; 
-  std::vector<int> tree_flow_list;
+  uint32_t tree_flow_handle;
   bool nvls_on;
+  // sender-side ticks stamped for critical-path attribution
+  uint64_t ready_tick;
+  uint64_t issue_tick;
   ncclFlowTag():
     channel_id(-1),
     chunk_id(-1),
@@ -48,7 +52,10 @@ struct ncclFlowTag {
     flow_size(-1),
     pQps(nullptr),
     tag_id(-1),
-    nvls_on(false){};
+    tree_flow_handle(FlowTagSlab::EMPTY),
+    nvls_on(false),
+    ready_tick(0),
+    issue_tick(0){};
   ncclFlowTag(
       int _channel_id,
       int _chunk_id,
@@ -69,8 +76,13 @@ struct ncclFlowTag {
         flow_size(_flow_size),
         pQps(_pQps),
         tag_id(_tag_id),
-        nvls_on(_nvls_on) {};
-  ~ncclFlowTag() {};
+        tree_flow_handle(FlowTagSlab::EMPTY),
+        nvls_on(_nvls_on),
+        ready_tick(0),
+        issue_tick(0) {};
+  const std::vector<int>& tree_flow_list() const {
+    return FlowTagSlab::get(tree_flow_handle);
+  }
 };
 
 
@@ -140,6 +152,13 @@ class AstraNetworkAPI {
   virtual double get_BW_at_dimension(int dim) {
     return -1;
   };
+  // uncongested path between two ranks, in bytes per ns and ns; -1 if unknown
+  virtual double get_BW_between(int src, int dst) {
+    return -1;
+  };
+  virtual double get_latency_between(int src, int dst) {
+    return -1;
+  };
   AstraNetworkAPI(int rank) {
     this->rank = rank;
     enabled = true;
@@ -30,6 +30,7 @@
 #include <vector>
 #include <cstdint>
 #include "Common.hh"
+#include "MemoryAccounting.hh"
 #define BUSBW_PATH ""
 using namespace std;
 
@@ -80,6 +81,7 @@ public:
   int thread;
   std::vector<int> gpus;
   std::string workload;
+  std::string jobs;
   std::string res = "None";
   std::string res_folder = "None";
   int comm_scale;
@@ -101,6 +103,10 @@ int parse(int argc, char *argv[]) {
         std::string arg = argv[i];
         if (arg == "-h" || arg == "--help") {
             std::cout << "-w,     --workload          Workloads, default none" << std::endl;
+            std::cout << "-bench, --bench             Collective sweep instead of a workload file:" << std::endl;
+            std::cout << "                            allreduce|allgather|reducescatter|alltoall|sendrecv" << std::endl;
+            std::cout << "                            [,min=1M][,max=1G][,factor=2][,group=tp|dp|ep][,ranks=N][,iters=1]" << std::endl;
+            std::cout << "-j,     --jobs              Job manifest, several workloads on one cluster" << std::endl;
             std::cout << "-g,     --gpus              Number of GPUs, default 1" << std::endl;
             std::cout << "-g_p_s, --gpus-per-server   GPUs per server" << std::endl;
             std::cout << "-r,     --result            Output results path" << std::endl;
@@ -114,9 +120,14 @@ int parse(int argc, char *argv[]) {
             std::cout << "-ep_o, --ep_overlap    ep overlap ratio(Default 0)" << std::endl;
             std::cout << "-tp_o, --tp_overlap    tp overlap ratio(Default 0)" << std::endl;
             std::cout << "-pp_o, --pp_overlap    pp overlap ratio(Default 1)" << std::endl;
+            std::cout << "-mem, --mem-budget    evict caches above this resident size, e.g. 64G" << std::endl;
             return 1;
         } else if (arg == "-w" || arg == "--workload") {
             if (++i < argc) this->workload = argv[i];
+        } else if (arg == "-bench" || arg == "--bench") {
+            if (++i < argc) this->workload = std::string("bench:") + argv[i];
+        } else if (arg == "-j" || arg == "--jobs") {
+            if (++i < argc) this->jobs = argv[i];
         } else if (arg == "-g" || arg == "--gpus") {
             if (++i < argc) this->gpus.push_back(std::stoi(argv[i]));
         } else if (arg == "-r" || arg == "--result") {
@@ -154,6 +165,14 @@ int parse(int argc, char *argv[]) {
         }else if (arg == "--pp_overlap" || arg == "-pp_o") {
             if (++i < argc) this->net_work_param.pp_overlap_ratio = std::stof(argv[i]);
         }
+        else if (arg == "--mem-budget" || arg == "-mem") {
+            uint64_t budget;
+            if (++i >= argc || !AstraSim::MemoryAccounting::parse_bytes(argv[i], budget)) {
+                std::cerr << "invalid memory budget" << std::endl;
+                return 1;
+            }
+            AstraSim::MemoryAccounting::set_budget(budget);
+        }
         else {
             return 1; 
         }
@@ -165,6 +184,12 @@ int parse(int argc, char *argv[]) {
         this->net_work_param.node_num = this->net_work_param.nvswitch_num + this->net_work_param.switch_num + this->gpus[0];
     }
 
+    if (this->res == "None" && !this->jobs.empty()) {
+        this->res = "";
+    }
+    if (this->res == "None" && this->workload.compare(0, 6, "bench:") == 0) {
+        this->res = "bench-" + this->workload.substr(6, this->workload.find(',') - 6) + "-";
+    }
     if (this->res == "None" ){
         std::string full_path = this->workload;
         std::string model_info = full_path;
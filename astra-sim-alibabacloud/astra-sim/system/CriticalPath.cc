@@ -0,0 +1,351 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "CriticalPath.hh"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace AstraSim {
+std::mutex CriticalPathRecorder::mtx;
+std::string CriticalPathRecorder::path;
+std::map<std::tuple<int, int, int>, CriticalPathRecorder::Collective>
+    CriticalPathRecorder::collectives;
+
+static inline uint64_t pack_flow(int channel_id, int flow_id) {
+  return ((uint64_t)(uint32_t)channel_id << 32) | (uint32_t)flow_id;
+}
+
+static const char* com_type_name(ComType type) {
+  switch (type) {
+    case ComType::Reduce_Scatter:
+      return "REDUCESCATTER";
+    case ComType::All_Gather:
+      return "ALLGATHER";
+    case ComType::All_Reduce:
+      return "ALLREDUCE";
+    case ComType::All_to_All:
+      return "ALLTOALL";
+    case ComType::All_Reduce_All_to_All:
+      return "ALLREDUCE_ALLTOALL";
+    case ComType::All_Reduce_NVLS:
+      return "ALLREDUCE_NVLS";
+    default:
+      return "NONE";
+  }
+}
+
+void CriticalPathRecorder::Breakdown::add(const Breakdown& other) {
+  queueing += other.queueing;
+  serialization += other.serialization;
+  propagation += other.propagation;
+  dependency += other.dependency;
+}
+
+bool CriticalPathRecorder::enabled() {
+  static const bool on = [] {
+    const char* env = std::getenv("AS_CRITICAL_PATH");
+    return env != nullptr && std::atoi(env) != 0;
+  }();
+  return on;
+}
+
+CriticalPathRecorder::CriticalPathRecorder(
+    int rank,
+    int stream_num,
+    int layer_num,
+    std::string layer_name,
+    ComType type,
+    std::string path,
+    std::vector<std::pair<int, int>> send_flows) {
+  this->rank = rank;
+  this->stream_num = stream_num;
+  this->layer_num = layer_num;
+  this->layer_name = layer_name;
+  this->type = type;
+  this->start_tick = 0;
+  keys.reserve(send_flows.size());
+  for (auto& f : send_flows) {
+    keys.push_back(pack_flow(f.first, f.second));
+  }
+  std::sort(keys.begin(), keys.end());
+  Arrival none = {-1, -1, 0, 0, 0, 0};
+  flows.resize(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    flows[i] = {(int)(keys[i] >> 32), (int)(uint32_t)keys[i], -1, 0, 0, 0, 0,
+                -1, none};
+  }
+  last_arrival = none;
+  std::lock_guard<std::mutex> lock(mtx);
+  if (CriticalPathRecorder::path.empty()) {
+    CriticalPathRecorder::path = path;
+  }
+}
+
+int CriticalPathRecorder::slot(int channel_id, int flow_id) const {
+  uint64_t key = pack_flow(channel_id, flow_id);
+  auto it = std::lower_bound(keys.begin(), keys.end(), key);
+  if (it == keys.end() || *it != key) {
+    return -1;
+  }
+  return it - keys.begin();
+}
+
+void CriticalPathRecorder::start(Tick now) {
+  start_tick = now;
+}
+
+void CriticalPathRecorder::ready(int channel_id, int flow_id, Tick now) {
+  int s = slot(channel_id, flow_id);
+  if (s < 0) {
+    return;
+  }
+  flows[s].ready = now;
+  flows[s].prev = -1;
+  flows[s].dep.sender = -1;
+}
+
+void CriticalPathRecorder::ready_after_send(
+    int channel_id,
+    int flow_id,
+    Tick now,
+    int prev_flow_id) {
+  ready(channel_id, flow_id, now);
+  int s = slot(channel_id, flow_id);
+  if (s >= 0) {
+    flows[s].prev = slot(channel_id, prev_flow_id);
+  }
+}
+
+void CriticalPathRecorder::ready_after_recv(
+    int channel_id,
+    int flow_id,
+    Tick now,
+    const ncclFlowTag& parent) {
+  ready(channel_id, flow_id, now);
+  int s = slot(channel_id, flow_id);
+  if (s >= 0) {
+    flows[s].dep = {parent.sender_node, parent.channel_id, parent.flow_size,
+                    parent.ready_tick, parent.issue_tick, now};
+  }
+}
+
+void CriticalPathRecorder::issued(
+    int channel_id,
+    int flow_id,
+    Tick now,
+    ncclFlowTag& tag) {
+  int s = slot(channel_id, flow_id);
+  if (s < 0) {
+    return;
+  }
+  flows[s].issued = now;
+  flows[s].peer = tag.receiver_node;
+  flows[s].size = tag.flow_size;
+  tag.ready_tick = flows[s].ready;
+  tag.issue_tick = now;
+}
+
+void CriticalPathRecorder::finished(int channel_id, int flow_id, Tick now) {
+  int s = slot(channel_id, flow_id);
+  if (s >= 0) {
+    flows[s].finished = now;
+  }
+}
+
+void CriticalPathRecorder::received(const ncclFlowTag& tag, Tick now) {
+  if (now >= last_arrival.arrival) {
+    last_arrival = {tag.sender_node, tag.channel_id, tag.flow_size,
+                    tag.ready_tick, tag.issue_tick, now};
+  }
+}
+
+Tick CriticalPathRecorder::clip(Tick from, Tick to) const {
+  from = std::max(from, start_tick);
+  return to > from ? to - from : 0;
+}
+
+void CriticalPathRecorder::network(
+    Breakdown& b,
+    Culprits& c,
+    AstraNetworkAPI* NI,
+    int src,
+    int dst,
+    int channel_id,
+    uint64_t size,
+    Tick from,
+    Tick to) {
+  Tick net = clip(from, to);
+  double bw = NI->get_BW_between(src, dst);
+  double latency = NI->get_latency_between(src, dst);
+  Tick serialization = bw > 0 ? (Tick)(size / bw) : net;
+  Tick propagation = latency > 0 ? (Tick)latency : 0;
+  serialization = std::min(serialization, net);
+  propagation = std::min(propagation, net - serialization);
+  Tick queueing = net - serialization - propagation;
+  b.serialization += serialization;
+  b.propagation += propagation;
+  b.queueing += queueing;
+  if (queueing > c.hot_queueing) {
+    c.hot_src = src;
+    c.hot_dst = dst;
+    c.hot_channel = channel_id;
+    c.hot_queueing = queueing;
+  }
+}
+
+void CriticalPathRecorder::remote(
+    Breakdown& b,
+    Culprits& c,
+    AstraNetworkAPI* NI,
+    const Arrival& a) {
+  // senders without a recorder leave the ticks at zero, so their whole
+  // history counts as dependency wait
+  Tick issued = a.issued != 0 ? a.issued : a.arrival;
+  Tick ready = a.ready != 0 ? std::min(a.ready, issued) : issued;
+  network(b, c, NI, a.sender, rank, a.channel_id, a.size, issued, a.arrival);
+  b.queueing += clip(ready, issued);
+  Tick wait = clip(start_tick, ready);
+  b.dependency += wait;
+  if (wait > c.wait) {
+    c.wait_rank = a.sender;
+    c.wait_channel = a.channel_id;
+    c.wait = wait;
+  }
+}
+
+void CriticalPathRecorder::finish(Tick now, AstraNetworkAPI* NI) {
+  Breakdown b;
+  Culprits c;
+  int cur = -1;
+  Tick last = 0;
+  for (size_t i = 0; i < flows.size(); i++) {
+    if (flows[i].finished != 0 && flows[i].finished >= last) {
+      last = flows[i].finished;
+      cur = i;
+    }
+  }
+  if (last_arrival.sender >= 0 && last_arrival.arrival > last) {
+    remote(b, c, NI, last_arrival);
+    cur = -1;
+  }
+  for (size_t steps = 0; cur >= 0 && steps < flows.size(); steps++) {
+    const Flow& f = flows[cur];
+    network(
+        b, c, NI, rank, f.peer, f.channel_id, f.size, f.issued, f.finished);
+    b.queueing += clip(f.ready, f.issued);
+    if (f.prev >= 0) {
+      cur = f.prev;
+      continue;
+    }
+    if (f.dep.sender >= 0) {
+      remote(b, c, NI, f.dep);
+    } else {
+      b.queueing += clip(start_tick, f.ready);
+    }
+    break;
+  }
+
+  // time between the last recorded event and the exit is local overhead
+  Tick duration = now > start_tick ? now - start_tick : 0;
+  b.queueing += duration - std::min(duration, b.total());
+
+  std::lock_guard<std::mutex> lock(mtx);
+  auto key = std::make_tuple(stream_num, layer_num, (int)type);
+  auto it = collectives.find(key);
+  if (it == collectives.end()) {
+    collectives[key] = {layer_num, layer_name, type, 1, rank, b, c};
+    return;
+  }
+  Collective& col = it->second;
+  col.ranks++;
+  if (b.total() > col.slowest.total()) {
+    col.slowest_rank = rank;
+    col.slowest = b;
+    col.culprits = c;
+  }
+}
+
+void CriticalPathRecorder::report() {
+  std::lock_guard<std::mutex> lock(mtx);
+  if (collectives.empty()) {
+    return;
+  }
+  // fold every instance of a (layer, collective) into one row; the culprits
+  // shown are those of its slowest instance
+  struct Row {
+    std::string layer_name;
+    ComType type;
+    int count = 0;
+    Breakdown sum;
+    Tick worst = 0;
+    int worst_rank = -1;
+    Culprits culprits;
+  };
+  std::map<std::pair<int, int>, Row> rows;
+  Breakdown overall;
+  for (auto& entry : collectives) {
+    const Collective& col = entry.second;
+    Row& row = rows[std::make_pair(col.layer_num, (int)col.type)];
+    row.layer_name = col.layer_name;
+    row.type = col.type;
+    row.count++;
+    row.sum.add(col.slowest);
+    overall.add(col.slowest);
+    if (col.slowest.total() >= row.worst) {
+      row.worst = col.slowest.total();
+      row.worst_rank = col.slowest_rank;
+      row.culprits = col.culprits;
+    }
+  }
+
+  std::string file = path + "critical_path.csv";
+  std::ofstream out(file);
+  if (!out) {
+    std::cerr << "unable to write " << file << std::endl;
+  } else {
+    out << "layer,collective,count,total_ns,queueing_ns,serialization_ns,"
+        << "propagation_ns,dependency_ns,slowest_rank,wait_rank,wait_channel,"
+        << "wait_ns,hot_link,hot_channel,hot_queueing_ns" << std::endl;
+    for (auto& entry : rows) {
+      const Row& row = entry.second;
+      out << row.layer_name << "," << com_type_name(row.type) << ","
+          << row.count << "," << row.sum.total() << "," << row.sum.queueing
+          << "," << row.sum.serialization << "," << row.sum.propagation
+          << "," << row.sum.dependency << "," << row.worst_rank << ","
+          << row.culprits.wait_rank << "," << row.culprits.wait_channel << ","
+          << row.culprits.wait << ",";
+      if (row.culprits.hot_src >= 0) {
+        out << row.culprits.hot_src << "->" << row.culprits.hot_dst;
+      }
+      out << "," << row.culprits.hot_channel << ","
+          << row.culprits.hot_queueing << std::endl;
+    }
+  }
+
+  double total = overall.total() > 0 ? overall.total() : 1;
+  std::cout << std::fixed << std::setprecision(1)
+            << "Critical path over " << collectives.size()
+            << " collectives: queueing " << overall.queueing * 100 / total
+            << "%, serialization " << overall.serialization * 100 / total
+            << "%, propagation " << overall.propagation * 100 / total
+            << "%, dependency " << overall.dependency * 100 / total << "% ("
+            << file << ")" << std::endl;
+  std::cout.unsetf(std::ios::fixed);
+  collectives.clear();
+}
+} // namespace AstraSim
@@ -0,0 +1,159 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __CRITICALPATH_HH__
+#define __CRITICALPATH_HH__
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "AstraNetworkAPI.hh"
+#include "Common.hh"
+
+namespace AstraSim {
+// Critical-path attribution for the flow model, enabled with
+// AS_CRITICAL_PATH=1. Each rank's NcclTreeFlowModel keeps the ready, issue
+// and finish ticks of its own send flows in an array sized when the phase
+// starts, plus the edge that made each flow ready: stream start, the previous
+// flow on the same QP, or the last parent flow received. Senders stamp their
+// ready/issue ticks into the flow tag, so the receiver also knows when the
+// remote side of a dependency edge started.
+//
+// When the phase exits the chain ending at the last local event is walked
+// backwards and its time split into queueing, serialization, propagation and
+// dependency wait. Serialization and propagation come from the network's
+// uncongested path bandwidth and latency; whatever the network time exceeds
+// them by is queueing. The slowest rank of every collective is merged into a
+// per-layer summary written to <path>critical_path.csv at exit.
+class CriticalPathRecorder {
+ public:
+  struct Breakdown {
+    Tick queueing = 0;
+    Tick serialization = 0;
+    Tick propagation = 0;
+    Tick dependency = 0;
+    Tick total() const {
+      return queueing + serialization + propagation + dependency;
+    }
+    void add(const Breakdown& other);
+  };
+  // The rank and channel whose late start was waited on the longest, and the
+  // flow that queued the longest in the network, on a rank's critical path.
+  struct Culprits {
+    int wait_rank = -1;
+    int wait_channel = -1;
+    Tick wait = 0;
+    int hot_src = -1;
+    int hot_dst = -1;
+    int hot_channel = -1;
+    Tick hot_queueing = 0;
+  };
+
+  static bool enabled();
+  CriticalPathRecorder(
+      int rank,
+      int stream_num,
+      int layer_num,
+      std::string layer_name,
+      ComType type,
+      std::string path,
+      std::vector<std::pair<int, int>> send_flows);
+  void start(Tick now);
+  void ready(int channel_id, int flow_id, Tick now);
+  void ready_after_send(
+      int channel_id,
+      int flow_id,
+      Tick now,
+      int prev_flow_id);
+  void ready_after_recv(
+      int channel_id,
+      int flow_id,
+      Tick now,
+      const ncclFlowTag& parent);
+  void issued(int channel_id, int flow_id, Tick now, ncclFlowTag& tag);
+  void finished(int channel_id, int flow_id, Tick now);
+  void received(const ncclFlowTag& tag, Tick now);
+  void finish(Tick now, AstraNetworkAPI* NI);
+  static void report();
+
+ private:
+  // a flow received from another rank, with the sender's stamped ticks
+  struct Arrival {
+    int sender;
+    int channel_id;
+    uint64_t size;
+    Tick ready;
+    Tick issued;
+    Tick arrival;
+  };
+  struct Flow {
+    int channel_id;
+    int flow_id;
+    int peer;
+    uint64_t size;
+    Tick ready;
+    Tick issued;
+    Tick finished;
+    int prev;
+    Arrival dep;
+  };
+  struct Collective {
+    int layer_num;
+    std::string layer_name;
+    ComType type;
+    int ranks;
+    int slowest_rank;
+    Breakdown slowest;
+    Culprits culprits;
+  };
+
+  int slot(int channel_id, int flow_id) const;
+  void network(
+      Breakdown& b,
+      Culprits& c,
+      AstraNetworkAPI* NI,
+      int src,
+      int dst,
+      int channel_id,
+      uint64_t size,
+      Tick from,
+      Tick to);
+  void remote(
+      Breakdown& b,
+      Culprits& c,
+      AstraNetworkAPI* NI,
+      const Arrival& a);
+  Tick clip(Tick from, Tick to) const;
+
+  int rank;
+  int stream_num;
+  int layer_num;
+  std::string layer_name;
+  ComType type;
+  Tick start_tick;
+  std::vector<uint64_t> keys;
+  std::vector<Flow> flows;
+  Arrival last_arrival;
+
+  static std::mutex mtx;
+  static std::string path;
+  static std::map<std::tuple<int, int, int>, Collective> collectives;
+};
+} // namespace AstraSim
+#endif
@@ -0,0 +1,134 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "Determinism.hh"
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include "ExitReports.hh"
+
+namespace AstraSim {
+namespace {
+thread_local uint64_t current_key = 0;
+thread_local uint64_t registered = 0;
+std::mutex fingerprint_lock;
+std::map<int, std::pair<uint64_t, uint64_t>> rank_fingerprints;
+bool reported = false;
+} // namespace
+
+void Determinism::Fingerprint::record(Tick tick, uint64_t key) {
+  if (tick != current_tick) {
+    hash = combine(hash, combine(current_tick, tick_sum));
+    current_tick = tick;
+    tick_sum = 0;
+  }
+  tick_sum += mix(key);
+  count++;
+}
+
+uint64_t Determinism::Fingerprint::value() {
+  record(current_tick + 1, 0);
+  return hash;
+}
+
+bool Determinism::enabled() {
+  static const bool on = [] {
+    const char* env = std::getenv("AS_DETERMINISTIC");
+    return env != nullptr && std::atoi(env) != 0;
+  }();
+  return on;
+}
+
+uint64_t Determinism::seed() {
+  static const uint64_t value = [] {
+    const char* env = std::getenv("AS_SEED");
+    return env != nullptr ? std::strtoull(env, nullptr, 10) : 1ULL;
+  }();
+  return value;
+}
+
+std::mt19937_64 Determinism::stream(uint64_t id) {
+  return std::mt19937_64(combine(seed(), id));
+}
+
+// splitmix64 finalizer
+uint64_t Determinism::mix(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+uint64_t Determinism::combine(uint64_t a, uint64_t b) {
+  return mix(a ^ mix(b));
+}
+
+void Determinism::enter(uint64_t key) {
+  current_key = key;
+  registered = 0;
+}
+
+uint64_t Determinism::next_key() {
+  return combine(current_key, ++registered);
+}
+
+uint64_t Determinism::message_key(
+    EventType event,
+    int src,
+    int dst,
+    int tag,
+    const ncclFlowTag& flowTag) {
+  uint64_t key = combine(static_cast<uint64_t>(event), src);
+  key = combine(key, dst);
+  key = combine(key, tag);
+  key = combine(key, flowTag.channel_id);
+  key = combine(key, flowTag.current_flow_id);
+  key = combine(key, flowTag.chunk_id);
+  return combine(key, flowTag.tag_id);
+}
+
+void Determinism::commit(int rank, Fingerprint& fingerprint) {
+  std::lock_guard<std::mutex> guard(fingerprint_lock);
+  if (rank_fingerprints.empty()) {
+    ExitReports::add(report);
+  }
+  rank_fingerprints[rank] =
+      std::make_pair(fingerprint.value(), fingerprint.events());
+}
+
+void Determinism::report() {
+  if (!enabled()) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(fingerprint_lock);
+  if (reported || rank_fingerprints.empty()) {
+    return;
+  }
+  reported = true;
+  uint64_t hash = seed();
+  uint64_t events = 0;
+  for (auto& rank : rank_fingerprints) {
+    hash = combine(hash, combine(rank.first, rank.second.first));
+    events += rank.second.second;
+  }
+  printf(
+      "Run fingerprint: %016llx (seed %llu, %zu ranks, %llu events)\n",
+      (unsigned long long)hash,
+      (unsigned long long)seed(),
+      rank_fingerprints.size(),
+      (unsigned long long)events);
+}
+} // namespace AstraSim
@@ -0,0 +1,79 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __DETERMINISM_HH__
+#define __DETERMINISM_HH__
+
+#include <cstdint>
+#include <random>
+#include "AstraNetworkAPI.hh"
+#include "Common.hh"
+
+namespace AstraSim {
+// Deterministic execution, enabled with AS_DETERMINISTIC=1.
+//
+// Every event put on a Sys event queue gets a key derived from the event
+// that was being dispatched when it was registered and its position among
+// that event's registrations. Network completions, which may arrive from
+// any thread, are keyed by their message (endpoints, tag and flow tag).
+// Events of the same tick are dispatched in key order, so the order no
+// longer depends on which thread inserted first. AS_SEED seeds the random
+// streams handed out by stream().
+//
+// Each rank also folds the keys it dispatches into a fingerprint. Keys of one
+// tick are summed, so the fingerprint only changes when the set of events a
+// rank runs at some tick changes. The per-rank values are combined in rank
+// order and printed at exit; two runs with the same fingerprint executed the
+// same events at the same ticks, whatever the thread count.
+class Determinism {
+ public:
+  class Fingerprint {
+   public:
+    void record(Tick tick, uint64_t key);
+    uint64_t value();
+    uint64_t events() const {
+      return count;
+    }
+
+   private:
+    uint64_t hash = 0;
+    uint64_t tick_sum = 0;
+    Tick current_tick = 0;
+    uint64_t count = 0;
+  };
+
+  static bool enabled();
+  static uint64_t seed();
+  // Random stream `id` of this run; equal seeds give equal streams.
+  static std::mt19937_64 stream(uint64_t id);
+  static uint64_t mix(uint64_t x);
+  static uint64_t combine(uint64_t a, uint64_t b);
+
+  // Makes `key` the event being dispatched on this thread.
+  static void enter(uint64_t key);
+  // Key for the next event registered by the one being dispatched.
+  static uint64_t next_key();
+  static uint64_t message_key(
+      EventType event,
+      int src,
+      int dst,
+      int tag,
+      const ncclFlowTag& flowTag);
+
+  static void commit(int rank, Fingerprint& fingerprint);
+  static void report();
+};
+} // namespace AstraSim
+#endif
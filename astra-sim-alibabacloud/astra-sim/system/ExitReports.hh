@@ -0,0 +1,32 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __EXITREPORTS_HH__
+#define __EXITREPORTS_HH__
+
+namespace AstraSim {
+// Reports that have to be written when the process exits. Sys::exitSimLoop
+// writes the reports of a run, but not every frontend gets there: the ns-3
+// frontend calls exit() from Sys::~Sys before Simulator::Run returns, and
+// others never tear their Sys down. A report registered here also runs from
+// std::atexit, so it must tolerate running twice or clear its state when it
+// has been written.
+class ExitReports {
+ public:
+  // registers `report` once, however often it is added
+  static void add(void (*report)());
+};
+} // namespace AstraSim
+#endif
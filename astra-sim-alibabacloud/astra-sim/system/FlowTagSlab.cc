@@ -0,0 +1,51 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "FlowTagSlab.hh"
+#include "Sys.hh"
+
+namespace AstraSim {
+std::atomic<std::vector<int>*> FlowTagSlab::chunks[FlowTagSlab::MAX_CHUNKS];
+std::atomic<uint32_t> FlowTagSlab::count(1);
+const std::vector<int> FlowTagSlab::empty_list;
+std::mutex FlowTagSlab::mtx;
+std::unordered_map<std::vector<int>, uint32_t, FlowListHash>
+    FlowTagSlab::index;
+
+uint32_t FlowTagSlab::intern(const std::vector<int>& flow_list) {
+  if (flow_list.empty()) {
+    return EMPTY;
+  }
+  std::lock_guard<std::mutex> lock(mtx);
+  auto it = index.find(flow_list);
+  if (it != index.end()) {
+    return it->second;
+  }
+  uint32_t handle = count.load(std::memory_order_relaxed);
+  uint32_t chunk = handle >> CHUNK_BITS;
+  if (chunk >= MAX_CHUNKS) {
+    Sys::sys_panic("FlowTagSlab is full, too many distinct flow lists");
+  }
+  std::vector<int>* slots = chunks[chunk].load(std::memory_order_relaxed);
+  if (slots == nullptr) {
+    slots = new std::vector<int>[CHUNK_SIZE];
+    chunks[chunk].store(slots, std::memory_order_release);
+  }
+  slots[handle & CHUNK_MASK] = flow_list;
+  index.emplace(flow_list, handle);
+  count.store(handle + 1, std::memory_order_release);
+  return handle;
+}
+} // namespace AstraSim
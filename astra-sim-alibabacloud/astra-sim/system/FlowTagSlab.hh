@@ -0,0 +1,68 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __FLOWTAGSLAB_HH__
+#define __FLOWTAGSLAB_HH__
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace AstraSim {
+struct FlowListHash {
+  size_t operator()(const std::vector<int>& flow_list) const {
+    size_t h = flow_list.size();
+    for (int f : flow_list) {
+      h ^= (size_t)f + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    }
+    return h;
+  }
+};
+
+// Interns the child flow lists carried by ncclFlowTag. Each distinct list is
+// stored once in append-only chunks and referred to by a 32-bit handle, so a
+// flow tag is a plain struct that can be copied through the network layer
+// without touching the heap. Stored lists are never modified or freed, which
+// lets MTP threads read them without taking the lock.
+class FlowTagSlab {
+ public:
+  static const uint32_t EMPTY = 0;
+  static uint32_t intern(const std::vector<int>& flow_list);
+  static const std::vector<int>& get(uint32_t handle) {
+    if (handle == EMPTY) {
+      return empty_list;
+    }
+    return chunks[handle >> CHUNK_BITS].load(std::memory_order_acquire)
+        [handle & CHUNK_MASK];
+  }
+  static uint32_t size() {
+    return count.load(std::memory_order_acquire);
+  }
+
+ private:
+  static const uint32_t CHUNK_BITS = 12;
+  static const uint32_t CHUNK_SIZE = 1u << CHUNK_BITS;
+  static const uint32_t CHUNK_MASK = CHUNK_SIZE - 1;
+  static const uint32_t MAX_CHUNKS = 1u << 14;
+  static std::atomic<std::vector<int>*> chunks[MAX_CHUNKS];
+  static std::atomic<uint32_t> count;
+  static const std::vector<int> empty_list;
+  static std::mutex mtx;
+  static std::unordered_map<std::vector<int>, uint32_t, FlowListHash> index;
+};
+} // namespace AstraSim
+#endif
@@ -0,0 +1,185 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "JobManifest.hh"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include "Sys.hh"
+#include "astra-sim/workload/Workload.hh"
+
+namespace AstraSim {
+namespace {
+std::vector<ClusterJob> manifest;
+// node -> index in manifest, filled before the Sys objects are built and
+// only read afterwards
+std::map<int, int> placement;
+
+bool parse_range(const std::string& text, int& first, int& last) {
+  size_t dash = text.find('-');
+  try {
+    size_t used;
+    first = std::stoi(text.substr(0, dash), &used);
+    if (used != (dash == std::string::npos ? text.size() : dash)) {
+      return false;
+    }
+    if (dash == std::string::npos) {
+      last = first;
+      return true;
+    }
+    last = std::stoi(text.substr(dash + 1), &used);
+    return used == text.size() - dash - 1;
+  } catch (const std::exception&) {
+    return false;
+  }
+}
+
+void start_job(void* arg) {
+  static_cast<Sys*>(arg)->workload->fire();
+}
+} // namespace
+
+bool JobManifest::load(
+    const std::string& path,
+    int gpus,
+    int gpus_per_node,
+    std::string& err) {
+  std::ifstream in(path);
+  if (!in) {
+    err = "unable to open job manifest " + path;
+    return false;
+  }
+  std::vector<bool> used(gpus, false);
+  std::string line;
+  int line_no = 0;
+  while (std::getline(in, line)) {
+    line_no++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos) {
+      line.erase(hash);
+    }
+    std::istringstream fields(line);
+    std::string name, workload, range, start;
+    if (!(fields >> name)) {
+      continue;
+    }
+    std::string where = path + ":" + std::to_string(line_no) + ": ";
+    if (!(fields >> workload >> range)) {
+      err = where + "expected <name> <workload> <ranks> [start us]";
+      return false;
+    }
+    double start_us = 0;
+    if (fields >> start) {
+      try {
+        start_us = std::stod(start);
+      } catch (const std::exception&) {
+        start_us = -1;
+      }
+      if (start_us < 0) {
+        err = where + "invalid start time " + start;
+        return false;
+      }
+    }
+    int first, last;
+    if (!parse_range(range, first, last) || first < 0 || last < first ||
+        last >= gpus) {
+      err = where + "invalid rank range " + range + " for " +
+          std::to_string(gpus) + " gpus";
+      return false;
+    }
+    int ranks = last - first + 1;
+    if (first % gpus_per_node != 0 || ranks % gpus_per_node != 0) {
+      err = where + "rank range " + range + " does not cover whole servers of " +
+          std::to_string(gpus_per_node) + " gpus";
+      return false;
+    }
+    for (int r = first; r <= last; r++) {
+      if (used[r]) {
+        err = where + "rank " + std::to_string(r) +
+            " already belongs to another job";
+        return false;
+      }
+      used[r] = true;
+    }
+    for (auto& job : manifest) {
+      if (job.name == name) {
+        err = where + "duplicate job name " + name;
+        return false;
+      }
+    }
+    manifest.push_back(ClusterJob{
+        name,
+        workload,
+        first,
+        ranks,
+        static_cast<Tick>(start_us * FREQ),
+        first});
+  }
+  if (manifest.empty()) {
+    err = "job manifest " + path + " lists no jobs";
+    return false;
+  }
+  return true;
+}
+
+bool JobManifest::enabled() {
+  return !manifest.empty();
+}
+
+std::vector<ClusterJob>& JobManifest::jobs() {
+  return manifest;
+}
+
+void JobManifest::place(int node, int job) {
+  placement[node] = job;
+}
+
+const ClusterJob* JobManifest::of(int node) {
+  auto it = placement.find(node);
+  return it == placement.end() ? nullptr : &manifest[it->second];
+}
+
+void JobManifest::fire(Sys* sys) {
+  const ClusterJob* job = sys->job;
+  if (job == nullptr || job->start == 0) {
+    sys->workload->fire();
+    return;
+  }
+  timespec_t delta;
+  delta.time_res = NS;
+  delta.time_val = job->start;
+  sys->NI->sim_schedule(delta, start_job, sys);
+}
+
+void JobManifest::finished(Sys* sys) {
+  const ClusterJob* job = sys->job;
+  if (job == nullptr) {
+    return;
+  }
+  Tick end = Sys::boostedTick();
+  int passes = sys->workload->TOTAL_PASS;
+  double span_us = (end - job->start) / FREQ;
+  std::ostringstream line;
+  line << std::fixed << std::setprecision(3) << "job " << job->name
+       << " ranks " << job->first_rank << "-"
+       << job->first_rank + job->ranks - 1 << " start " << job->start / FREQ
+       << " us, finish " << end / FREQ << " us, " << passes
+       << " iterations, " << span_us / (passes > 0 ? passes : 1)
+       << " us per iteration";
+  std::cout << line.str() << std::endl;
+}
+} // namespace AstraSim
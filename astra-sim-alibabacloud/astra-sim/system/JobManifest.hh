@@ -0,0 +1,59 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __JOBMANIFEST_HH__
+#define __JOBMANIFEST_HH__
+
+#include <string>
+#include <vector>
+#include "astra-sim/system/Common.hh"
+
+namespace AstraSim {
+class Sys;
+
+struct ClusterJob {
+  std::string name;
+  std::string workload;
+  int first_rank; // global rank of the job's rank 0
+  int ranks;
+  Tick start; // ns
+  int leader; // node whose Sys writes the job's reports
+};
+
+// A cluster run hosts several independent jobs on one fabric. The manifest
+// lists one job per line,
+//   <name> <workload file> <first rank>-<last rank> [start us]
+// with "#" comments. Rank ranges cover whole servers and must not overlap;
+// ranks outside every range stay idle. Each job builds its own
+// communicator groups over its global ranks and reports under its name.
+class JobManifest {
+ public:
+  static bool load(
+      const std::string& path,
+      int gpus,
+      int gpus_per_node,
+      std::string& err);
+  static bool enabled();
+  static std::vector<ClusterJob>& jobs();
+  // The frontend places every node that hosts a Sys of a job before the
+  // Sys objects are built.
+  static void place(int node, int job);
+  static const ClusterJob* of(int node);
+  // Fires the workload of the sys at its job's start time.
+  static void fire(Sys* sys);
+  static void finished(Sys* sys);
+};
+} // namespace AstraSim
+#endif
@@ -0,0 +1,246 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "MemoryAccounting.hh"
+#include <sys/resource.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "ExitReports.hh"
+
+namespace AstraSim {
+namespace {
+struct Probe {
+  const char* name;
+  std::function<int64_t()> measure;
+  int64_t current;
+  int64_t peak;
+};
+
+struct Settings {
+  bool on = false;
+  double interval = 0;
+  uint64_t budget = 0;
+  Settings() {
+    const char* env = std::getenv("AS_MEM_REPORT");
+    if (env != nullptr) {
+      interval = std::atof(env);
+    }
+    env = std::getenv("AS_MEM_BUDGET");
+    if (env != nullptr && !MemoryAccounting::parse_bytes(env, budget)) {
+      fprintf(stderr, "invalid AS_MEM_BUDGET %s\n", env);
+      exit(1);
+    }
+    on = interval > 0 || budget > 0;
+    if (on) {
+      ExitReports::add(MemoryAccounting::report);
+    }
+  }
+};
+
+Settings& settings() {
+  static Settings s;
+  return s;
+}
+
+std::vector<MemoryAccounting::Counter*>& counters() {
+  static std::vector<MemoryAccounting::Counter*> all;
+  return all;
+}
+
+std::mutex sample_lock;
+std::vector<Probe> probes;
+std::atomic<bool> eviction_requested(false);
+std::chrono::steady_clock::time_point last_report, last_eviction;
+bool reported = false;
+
+std::string human(int64_t bytes) {
+  char text[32];
+  if (bytes >= (1LL << 30)) {
+    snprintf(text, sizeof(text), "%.2f GiB", bytes / double(1LL << 30));
+  } else if (bytes >= (1LL << 20)) {
+    snprintf(text, sizeof(text), "%.1f MiB", bytes / double(1LL << 20));
+  } else {
+    snprintf(text, sizeof(text), "%.1f KiB", bytes / 1024.0);
+  }
+  return text;
+}
+
+uint64_t peak_resident_bytes() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+}
+
+// Evaluates the probes; caller holds sample_lock.
+void measure_probes() {
+  for (auto& probe : probes) {
+    probe.current = probe.measure();
+    if (probe.current > probe.peak) {
+      probe.peak = probe.current;
+    }
+  }
+}
+} // namespace
+
+MemoryAccounting::Counter::Counter(const char* name) : name(name) {
+  counters().push_back(this);
+}
+
+void MemoryAccounting::Counter::add(int64_t delta) {
+  int64_t now = bytes.fetch_add(delta, std::memory_order_relaxed) + delta;
+  int64_t seen = high.load(std::memory_order_relaxed);
+  while (now > seen &&
+         !high.compare_exchange_weak(seen, now, std::memory_order_relaxed)) {
+  }
+}
+
+void MemoryAccounting::Counter::sub(int64_t delta) {
+  bytes.fetch_sub(delta, std::memory_order_relaxed);
+}
+
+bool MemoryAccounting::enabled() {
+  return settings().on;
+}
+
+void MemoryAccounting::set_budget(uint64_t bytes) {
+  Settings& s = settings();
+  if (!s.on && bytes > 0) {
+    s.on = true;
+    ExitReports::add(report);
+  }
+  s.budget = bytes;
+}
+
+uint64_t MemoryAccounting::budget() {
+  return settings().budget;
+}
+
+bool MemoryAccounting::parse_bytes(const std::string& text, uint64_t& bytes) {
+  size_t pos = 0;
+  double value;
+  try {
+    value = std::stod(text, &pos);
+  } catch (const std::exception&) {
+    return false;
+  }
+  std::string unit = text.substr(pos);
+  uint64_t scale = 1;
+  if (unit == "K" || unit == "k") {
+    scale = 1ULL << 10;
+  } else if (unit == "M" || unit == "m") {
+    scale = 1ULL << 20;
+  } else if (unit == "G" || unit == "g") {
+    scale = 1ULL << 30;
+  } else if (!unit.empty()) {
+    return false;
+  }
+  if (value <= 0) {
+    return false;
+  }
+  bytes = static_cast<uint64_t>(value * scale);
+  return true;
+}
+
+void MemoryAccounting::add_probe(
+    const char* name,
+    std::function<int64_t()> probe) {
+  std::lock_guard<std::mutex> guard(sample_lock);
+  probes.push_back(Probe{name, probe, 0, 0});
+}
+
+uint64_t MemoryAccounting::resident_bytes() {
+  long pages = 0, resident = 0;
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm == nullptr) {
+    return peak_resident_bytes();
+  }
+  if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+    resident = 0;
+  }
+  fclose(statm);
+  return static_cast<uint64_t>(resident) * sysconf(_SC_PAGESIZE);
+}
+
+void MemoryAccounting::sample() {
+  std::unique_lock<std::mutex> guard(sample_lock, std::try_to_lock);
+  if (!guard.owns_lock()) {
+    return;
+  }
+  auto now = std::chrono::steady_clock::now();
+  uint64_t resident = resident_bytes();
+  Settings& s = settings();
+  if (s.budget > 0 && resident > s.budget &&
+      now - last_eviction > std::chrono::seconds(1)) {
+    last_eviction = now;
+    eviction_requested.store(true);
+    printf(
+        "Memory: resident %s over the %s budget, evicting caches\n",
+        human(resident).c_str(),
+        human(s.budget).c_str());
+  }
+  if (s.interval > 0 &&
+      now - last_report > std::chrono::duration<double>(s.interval)) {
+    last_report = now;
+    measure_probes();
+    std::string line = "Memory: resident " + human(resident);
+    for (auto counter : counters()) {
+      line += std::string(" | ") + counter->name + " " +
+          human(counter->current());
+    }
+    for (auto& probe : probes) {
+      line += std::string(" | ") + probe.name + " " + human(probe.current);
+    }
+    printf("%s\n", line.c_str());
+  }
+}
+
+bool MemoryAccounting::take_eviction_request() {
+  return eviction_requested.load(std::memory_order_relaxed) &&
+      eviction_requested.exchange(false);
+}
+
+void MemoryAccounting::report() {
+  if (!enabled()) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(sample_lock);
+  if (reported) {
+    return;
+  }
+  reported = true;
+  measure_probes();
+  printf("Memory: peak resident %s\n", human(peak_resident_bytes()).c_str());
+  printf("%-28s %12s %12s\n", "structure", "current", "peak");
+  for (auto counter : counters()) {
+    printf(
+        "%-28s %12s %12s\n",
+        counter->name,
+        human(counter->current()).c_str(),
+        human(counter->peak()).c_str());
+  }
+  for (auto& probe : probes) {
+    printf(
+        "%-28s %12s %12s\n",
+        probe.name,
+        human(probe.current).c_str(),
+        human(probe.peak).c_str());
+  }
+}
+} // namespace AstraSim
@@ -0,0 +1,100 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __MEMORYACCOUNTING_HH__
+#define __MEMORYACCOUNTING_HH__
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+
+namespace AstraSim {
+// Memory accounting per subsystem, enabled by AS_MEM_REPORT=<seconds> or a
+// memory budget (ns-3 --mem-budget, AS_MEM_BUDGET).
+//
+// Structures owned by the system layer keep an explicit Counter of their
+// estimated bytes, updated where they grow and shrink. Structures owned by a
+// frontend register a probe that estimates their bytes when sampled. Samples
+// are taken from Sys::call_events every few thousand events: with
+// AS_MEM_REPORT one line per interval is printed, and the peaks of all
+// counters and of the process resident set are printed at exit.
+//
+// When the resident set exceeds the budget an eviction is requested; the
+// MockNcclGroup flow-model cache honours it the next time it is used, since
+// cached models can be regenerated on demand.
+class MemoryAccounting {
+ public:
+  class Counter {
+   public:
+    explicit Counter(const char* name);
+    void add(int64_t bytes);
+    void sub(int64_t bytes);
+    int64_t current() const {
+      return bytes.load(std::memory_order_relaxed);
+    }
+    int64_t peak() const {
+      return high.load(std::memory_order_relaxed);
+    }
+    const char* name;
+
+   private:
+    std::atomic<int64_t> bytes{0};
+    std::atomic<int64_t> high{0};
+  };
+
+  // Rough size of a std::map / std::list node holding `T`.
+  template <typename T>
+  static constexpr int64_t node_bytes() {
+    return sizeof(T) + 4 * sizeof(void*);
+  }
+
+  template <typename Container>
+  static int64_t container_bytes(const Container& container) {
+    return container.size() *
+        node_bytes<typename Container::value_type>();
+  }
+  // For maps of maps, such as the ns-3 pair tables.
+  template <typename Map>
+  static int64_t nested_map_bytes(const Map& map) {
+    int64_t bytes = container_bytes(map);
+    for (auto& inner : map) {
+      bytes += container_bytes(inner.second);
+    }
+    return bytes;
+  }
+
+  static bool enabled();
+  // Also enables accounting; call before the Sys objects are created.
+  static void set_budget(uint64_t bytes);
+  static uint64_t budget();
+  static bool parse_bytes(const std::string& text, uint64_t& bytes);
+  static void add_probe(const char* name, std::function<int64_t()> probe);
+
+  static void tick() {
+    thread_local uint32_t calls = 0;
+    if (enabled() && (++calls & 0xfff) == 0) {
+      sample();
+    }
+  }
+  static void sample();
+  // True once per budget overrun; the caller is expected to evict.
+  static bool take_eviction_request();
+  static uint64_t resident_bytes();
+  static void report();
+};
+} // namespace AstraSim
+#endif
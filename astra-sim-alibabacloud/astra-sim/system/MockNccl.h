@@ -32,6 +32,11 @@
 #define NCCL_PROTO_SIMPLE 2
 #define NCCL_WORK_SIZE 512
 
+// p2p defaults: NCCL_NCHANNELS_PER_NET_PEER, NCCL_P2P_NVL_CHUNKSIZE, NCCL_P2P_NET_CHUNKSIZE
+#define NCCL_P2P_CHANNELS_PER_PEER 2
+#define NCCL_P2P_NVL_CHUNKSIZE (1 << 19)
+#define NCCL_P2P_NET_CHUNKSIZE (1 << 17)
+
 /* Array indexes used below */
 #define VOLTA_COMPCAP_IDX 0
 #define AMPERE_COMPCAP_IDX 1
@@ -34,6 +34,8 @@ namespace MockNccl {
     int chunk_id;
     int chunk_count;
     std::string conn_type;
+    // FlowTagSlab handle of child_flow_id, set by the flow model that sends it
+    uint32_t child_flow_handle = 0;
     SingleFlow(){};
     SingleFlow(
         int _flow_id,
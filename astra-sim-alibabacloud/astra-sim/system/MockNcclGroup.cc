@@ -13,6 +13,9 @@
 *limitations under the License.
 */
 #include "MockNcclGroup.h"
+#include "astra-sim/system/RankLayout.hh"
+#include "astra-sim/system/NodeHardware.hh"
+#include "astra-sim/system/RailTraffic.hh"
 #include "MockNcclChannel.h"
 #include<vector>
 #include<map>
@@ -20,10 +23,27 @@
 #include <queue>
 #include <cmath>
 #include <algorithm>
+#include <climits>
+#include <iostream>
+#include "astra-sim/system/Determinism.hh"
+#include "astra-sim/system/MemoryAccounting.hh"
 #include "astra-sim/system/MockNcclLog.h"
 using namespace std;
 namespace MockNccl {
-  MockNcclGroup::MockNcclGroup(int _ngpus,int _gpus_per_nodes,int _TP_size,int _DP_size,int _PP_size,int _EP_size,int _DP_EP_size,std::vector<int>_NVSwitch,GPUType _gpu_type):g_flow_id(0),gpu_type(_gpu_type){
+  static AstraSim::MemoryAccounting::Counter flow_model_cache_bytes("flow_model_cache");
+
+  int64_t FlowModelsBytes(const FlowModels& models) {
+    int64_t bytes = 0;
+    for (auto& flow : models) {
+      bytes += AstraSim::MemoryAccounting::node_bytes<FlowModels::value_type>();
+      bytes += sizeof(int) *
+          (flow.second.prev.capacity() + flow.second.parent_flow_id.capacity() +
+           flow.second.child_flow_id.capacity());
+    }
+    return bytes;
+  }
+
+  MockNcclGroup::MockNcclGroup(int _ngpus,int _gpus_per_nodes,int _TP_size,int _CP_size,int _DP_size,int _PP_size,int _EP_size,int _DP_EP_size,std::vector<int>_NVSwitch,GPUType _gpu_type,int _first_rank):g_flow_id(0),gpu_type(_gpu_type),gpus_per_node(_gpus_per_nodes){
     /*init groups
     */
     MockNcclLog *NcclLog = MockNcclLog::getInstance();
@@ -33,17 +53,17 @@ namespace MockNccl {
     }
     int all_group_idx = 0;
     int nNodes = _ngpus/_gpus_per_nodes;
-    int nlocalranks = _gpus_per_nodes;
     int TP_nums = _ngpus/_TP_size;
     int DP_nums = _ngpus/_DP_size;
     int PP_nums = _ngpus/_PP_size;
     int EP_nums = _ngpus/_EP_size;
     int DP_EP_nums = _ngpus/_DP_EP_size;
-    if (TP_nums <= 0 || DP_nums <= 0 || PP_nums <= 0 || EP_nums <= 0 || DP_EP_nums <= 0 || (_TP_size * _DP_size * _PP_size != _ngpus) || (_EP_size * _DP_EP_size != _DP_size)){
+    int CP_nums = _ngpus/_CP_size;
+    if (TP_nums <= 0 || DP_nums <= 0 || PP_nums <= 0 || EP_nums <= 0 || DP_EP_nums <= 0 || CP_nums <= 0 || (_TP_size * _CP_size * _DP_size * _PP_size != _ngpus) || (_EP_size * _DP_EP_size != _DP_size)){
       NcclLog->writeLog(NcclLogLevel::ERROR,"The group division method is incorrect.");
       return;
     }
-    int nNodesPerTPGroup = _TP_size / nlocalranks + (_TP_size % nlocalranks > 0 ? 1 : 0);
+    AstraSim::RankLayout layout(_ngpus,_gpus_per_nodes,_TP_size,_CP_size,_DP_size,_PP_size,_EP_size);
     std::vector<int>ranks;
     std::vector<int>NVSwitchs;
     // init TP group 
@@ -53,7 +73,7 @@ namespace MockNccl {
         ranks.clear();
         TPnodes.clear();
         for(int j =0;j<_TP_size;j++){
-          int rank = i*_TP_size+j;
+          int rank = _first_rank+layout.gpu(i*_TP_size+j);
           ranks.push_back(rank);
           GroupIndex[std::make_pair(rank, TP)] = all_group_idx;
           int node_idx = rank / _gpus_per_nodes;
@@ -64,18 +84,26 @@ namespace MockNccl {
           NVSwitchs.push_back(_NVSwitch[idx]);
           GroupIndex[std::make_pair(_NVSwitch[idx],TP)] = all_group_idx;
         }
-        AllGroups[all_group_idx]=GroupInfo(all_group_idx,TP,nNodesPerTPGroup,_TP_size,ranks,NVSwitchs);
+        AllGroups[all_group_idx]=GroupInfo(all_group_idx,TP,TPnodes.size(),_TP_size,ranks,NVSwitchs);
         all_group_idx ++;
       }
     }
+    // ranks are laid out TP fastest, then CP, then DP, then PP: a pipeline
+    // stage owns TP_size*CP_size*DP_size consecutive ranks and CP/DP/EP
+    // groups stay inside a stage. The layout then maps these ranks to GPUs
+    // (AS_RANK_ORDER and AS_RANK_PLACEMENT); a job of a cluster manifest
+    // starts at _first_rank.
+    int model_size = _TP_size * _CP_size;
+    int stage_size = model_size * _DP_size;
     // init DP group
     if(_DP_size>1){
       std::set<int>DPnodes;
       for(int i =0;i<DP_nums;i++){
         ranks.clear();
         DPnodes.clear();
+        int stage = i / model_size;
         for(int j =0;j<_DP_size;j++){
-          int rank = i+j*DP_nums;
+          int rank = _first_rank+layout.gpu(stage*stage_size+i%model_size+j*model_size);
           ranks.push_back(rank);
           GroupIndex[std::make_pair(rank, DP)] = all_group_idx;
           int node_idx = rank/_gpus_per_nodes;
@@ -92,7 +120,25 @@ namespace MockNccl {
     }
     // init PP group
     if(_PP_size > 1){
-
+      std::set<int>PPnodes;
+      for(int i =0;i<PP_nums;i++){
+        ranks.clear();
+        PPnodes.clear();
+        for(int j =0;j<_PP_size;j++){
+          int rank = _first_rank+layout.gpu(i+j*stage_size);
+          ranks.push_back(rank);
+          GroupIndex[std::make_pair(rank, PP)] = all_group_idx;
+          int node_idx = rank/_gpus_per_nodes;
+          PPnodes.insert(node_idx);
+        }
+        NVSwitchs.clear();
+        for(int idx:PPnodes){
+          NVSwitchs.push_back(_NVSwitch[idx]);
+          GroupIndex[std::make_pair(_NVSwitch[idx],PP)] = all_group_idx;
+        }
+        AllGroups[all_group_idx]=GroupInfo(all_group_idx,PP,PPnodes.size(),_PP_size,ranks,NVSwitchs);
+        all_group_idx ++;
+      }
     }
     // init EP
     std::map<int,GroupInfo> AllTPGroups;
@@ -104,13 +150,15 @@ namespace MockNccl {
     if(_EP_size>1){
       int TP_idx=0;
       std::set<int> EPnodes;
+      // TP groups are numbered CP fastest, so the EP peers of a TP group
+      // are _CP_size groups apart
       for (int i = 0; i < TP_nums / _EP_size; i++){
-        TP_idx = i*_EP_size;
+        TP_idx = (i / _CP_size) * _EP_size * _CP_size + i % _CP_size;
         for(int j =0;j<_EP_size;j++){
           for(int k = 0;k<AllTPGroups[TP_idx].Ranks.size();k++){
             ranks.clear();
             EPnodes.clear();
-            for(int l = TP_idx;l<TP_idx+_EP_size;l++){
+            for(int l = TP_idx;l<TP_idx+_EP_size*_CP_size;l+=_CP_size){
               int tmp_rank = AllTPGroups[l].Ranks[k];
               int node_idx = tmp_rank/_gpus_per_nodes;
               ranks.push_back(tmp_rank);
@@ -133,12 +181,14 @@ namespace MockNccl {
       int TP_idx = 0;
       std::set<int> DP_EP_nodes;
       for (int i = 0; i < TP_nums / _DP_EP_size; i++){
-        TP_idx = i;
+        int cp = i % _CP_size;
+        int ep_group = i / _CP_size;
+        TP_idx = cp + ((ep_group / _EP_size) * _DP_size + ep_group % _EP_size) * _CP_size;
         for (int j = 0; j < _DP_EP_size; j++){
           for (int k = 0; k < AllTPGroups[TP_idx].Ranks.size(); k++){
             ranks.clear();
             DP_EP_nodes.clear();
-            for (int l = TP_idx; l < TP_idx + _DP_EP_size * _EP_size; l += _EP_size){
+            for (int l = TP_idx; l < TP_idx + _DP_EP_size * _EP_size * _CP_size; l += _EP_size * _CP_size){
               int tmp_rank = AllTPGroups[l].Ranks[k];
               int node_idx = tmp_rank / _gpus_per_nodes;
               ranks.push_back(tmp_rank);
@@ -156,6 +206,44 @@ namespace MockNccl {
         }
       }
     }
+    // init CP group
+    if(_CP_size > 1){
+      std::set<int>CPnodes;
+      for(int i =0;i<CP_nums;i++){
+        ranks.clear();
+        CPnodes.clear();
+        int outer = i / _TP_size;
+        for(int j =0;j<_CP_size;j++){
+          int rank = _first_rank+layout.gpu(outer*model_size+i%_TP_size+j*_TP_size);
+          ranks.push_back(rank);
+          GroupIndex[std::make_pair(rank, CP)] = all_group_idx;
+          int node_idx = rank/_gpus_per_nodes;
+          CPnodes.insert(node_idx);
+        }
+        NVSwitchs.clear();
+        for(int idx:CPnodes){
+          NVSwitchs.push_back(_NVSwitch[idx]);
+          GroupIndex[std::make_pair(_NVSwitch[idx],CP)] = all_group_idx;
+        }
+        AllGroups[all_group_idx]=GroupInfo(all_group_idx,CP,CPnodes.size(),_CP_size,ranks,NVSwitchs);
+        all_group_idx ++;
+      }
+    }
+    // rings and trees give every server of a group the same number of ranks
+    if (AstraSim::RankLayout::configured()) {
+      for (auto& group : AllGroups) {
+        std::map<int,int> per_server;
+        for (int rank : group.second.Ranks)
+          per_server[rank / _gpus_per_nodes]++;
+        for (auto& server : per_server) {
+          if (server.second != per_server.begin()->second) {
+            std::cerr << "rank layout puts " << per_server.begin()->second << " and " << server.second
+                      << " ranks of one group on different servers, groups must be spread evenly" << std::endl;
+            exit(1);
+          }
+        }
+      }
+    }
     return;
   }
   
@@ -226,6 +314,32 @@ namespace MockNccl {
     return localrings;
   }
 
+  // Full rings of the group, one per local rank. The sorted ranks are split
+  // into nNodes servers of equal size and every server takes its ranks in
+  // the rotation of the ring id, so a placement that does not keep the
+  // servers of a group at a constant stride still gets its own ranks.
+  std::map<int, std::vector<int>> MockNcclGroup::gen_rings(int rank, GroupType type){
+    std::map<int,std::vector<int>>rings;
+    MockNcclLog* NcclLog = MockNcclLog::getInstance();
+    if(GroupIndex.count(std::make_pair(rank,type)) == 0){
+      NcclLog->writeLog(NcclLogLevel::ERROR,"There is no relevant group info, resulting in an error in gen_rings");
+      return {};
+    }
+    GroupInfo& gp_info = AllGroups[GroupIndex[std::make_pair(rank,type)]];
+    std::vector<int> ranks = gp_info.Ranks;
+    int nNodes = gp_info.nNodes;
+    int nlocalranks = ranks.size()/nNodes;
+    std::sort(ranks.begin(), ranks.end());
+    for(int i = 0; i < nlocalranks; i++){
+      for(int node = 0; node < nNodes; node++){
+        for(int j = 0; j < nlocalranks; j++){
+          rings[i].push_back(ranks[node * nlocalranks + (i + j) % nlocalranks]);
+        }
+      }
+    }
+    return rings;
+  }
+
   RingChannels MockNcclGroup::genringchannels(int rank, MockNccl::GroupType type) {
     std::map<int,std::map<int,std::vector<int>>>ringchannels;
     std::map<int,std::vector<int>>localrings;
@@ -240,7 +354,6 @@ namespace MockNccl {
     int end_rank;
     int nNodes;
     int nlocalRanks;
-    int delta;
     if(GroupIndex.count(std::make_pair(rank,type))==0){
       NcclLog->writeLog(NcclLogLevel::ERROR,"No corresponding group information is generated, and there is an error in creating the ring channel.");
     }
@@ -248,31 +361,32 @@ namespace MockNccl {
     gp_info = AllGroups[GroupIndex[std::make_pair(rank,type)]];
     nNodes = gp_info.nNodes;
     nlocalRanks = gp_info.nRanks/nNodes;
-    localrings = gen_local_ring(rank,type);
+    localrings = gen_rings(rank,type);
 
-    delta = nNodes > 1 ? gp_info.Ranks[nlocalRanks]-gp_info.Ranks[0] : 0;
     for(ring_it = localrings.begin();ring_it != localrings.end();ring_it++) {
+      const std::vector<int>& ring = ring_it->second;
       prev = -1;
       next = -1;
       for(int i = 0; i < nNodes; i++) {
         int node_send;
         int node_recv;
-        node_recv = ring_it->second[0] + i * delta;
-        node_send = ring_it->second[nlocalRanks-1] + i * delta;
+        node_recv = ring[i * nlocalRanks];
+        node_send = ring[i * nlocalRanks + nlocalRanks - 1];
         for(int j = 0; j < nlocalRanks; j++) {
-          current = ring_it->second[j] + i * delta;  
-          if (j == nlocalRanks-1) {
-            next = ring_it->second[0] + (i + 1) * delta;
+          current = ring[i * nlocalRanks + j];
+          if (i * nlocalRanks + j + 1 == ring.size()) {
+            // past the last server; closed below
+            next = -1;
           } else {
-            next = ring_it->second[j+1] + i * delta;
+            next = ring[i * nlocalRanks + j + 1];
           }
           ringchannels[ring_it->first][current] = {prev,next,node_recv,node_send};
           prev = current;
         }
       }
-      end_rank = ring_it->second[nlocalRanks-1] + (nNodes - 1) * delta;
-      ringchannels[ring_it->first][ring_it->second[0]][0] = end_rank;
-      ringchannels[ring_it->first][end_rank][1] = ring_it->second[0];
+      end_rank = ring.back();
+      ringchannels[ring_it->first][ring[0]][0] = end_rank;
+      ringchannels[ring_it->first][end_rank][1] = ring[0];
     }
     Allringchannels[gp_idx]=ringchannels;
     return ringchannels;
@@ -303,10 +417,19 @@ namespace MockNccl {
       case DP_EP:
         flow_model_name = "DP_EP";
         break;
+      case PP:
+        flow_model_name = "PP";
+        break;
+      case CP:
+        flow_model_name = "CP";
+        break;
       default:
         break;
     }
     flow_model_name = flow_model_name + "_" + std::to_string(gp_idx) + "_" + std::to_string(layer_num) + "_" + std::to_string(static_cast<int>(loopstate)) + "_" + std::to_string(static_cast<int>(op)) + "_" + std::to_string(data_size);
+    if(AstraSim::MemoryAccounting::take_eviction_request()){
+      evict_flow_models();
+    }
     if(flow_models.count(flow_model_name)){
       FlowName2nums[flow_model_name] ++;
       std::shared_ptr<void> presult;
@@ -316,14 +439,83 @@ namespace MockNccl {
         presult = nullptr;
       }
       return presult;
+    } else if (AstraSim::Determinism::enabled()) {
+      // Draw flow ids from a range owned by the group, so the ids do not
+      // depend on which group's rank got here first. Cached flow models
+      // keep their ids, so a range is never reused.
+      int stride = INT_MAX / (AllGroups.rbegin()->first + 1);
+      int base = gp_idx * stride;
+      if (group_flow_cursor.count(gp_idx) == 0) {
+        group_flow_cursor[gp_idx] = base;
+      }
+      int global_flow_id = g_flow_id;
+      g_flow_id = group_flow_cursor[gp_idx];
+      flow_models[flow_model_name] = genFlowModels(type,rank,op,data_size);
+      if (g_flow_id < group_flow_cursor[gp_idx] ||
+          (int64_t)g_flow_id > (int64_t)base + stride) {
+        std::cerr << "AS_DETERMINISTIC: communication group " << gp_idx
+                  << " used up its range of " << stride << " flow ids"
+                  << std::endl;
+        exit(1);
+      }
+      group_flow_cursor[gp_idx] = g_flow_id;
+      g_flow_id = global_flow_id;
+      FlowName2nums[flow_model_name]= 1;
+      FlowName2ranks[flow_model_name]= gp_info.Ranks.size();
+      account_flow_models(flow_model_name);
+      return flow_models[flow_model_name][rank];
     } else {
       flow_models[flow_model_name] = genFlowModels(type,rank,op,data_size);
       FlowName2nums[flow_model_name]= 1;
+      FlowName2ranks[flow_model_name]= gp_info.Ranks.size();
+      account_flow_models(flow_model_name);
       return flow_models[flow_model_name][rank];
     }
   }
 
+  void MockNcclGroup::account_flow_models(const std::string& flow_model_name){
+    if(!AstraSim::MemoryAccounting::enabled())
+      return;
+    // ranks of a collective may share one model
+    std::set<FlowModels*> counted;
+    int64_t bytes = AstraSim::MemoryAccounting::node_bytes<decltype(flow_models)::value_type>();
+    for(auto& it : flow_models[flow_model_name]){
+      if(it.second != nullptr && counted.insert(it.second.get()).second)
+        bytes += FlowModelsBytes(*it.second);
+    }
+    FlowName2bytes[flow_model_name] = bytes;
+    cached_flow_model_bytes += bytes;
+    flow_model_cache_bytes.add(bytes);
+  }
+
+  void MockNcclGroup::evict_flow_models(){
+    // A model is shared by the ranks of its collective and matched on its
+    // flow ids, so it stays until all of them have fetched it; ranks that
+    // got here later would otherwise regenerate it with other ids.
+    for(auto it = flow_models.begin(); it != flow_models.end();){
+      const std::string& name = it->first;
+      int ranks = std::max(1, FlowName2ranks[name]);
+      if(FlowName2nums[name] % ranks != 0){
+        ++it;
+        continue;
+      }
+      int64_t bytes = FlowName2bytes[name];
+      flow_model_cache_bytes.sub(bytes);
+      cached_flow_model_bytes -= bytes;
+      FlowName2nums.erase(name);
+      FlowName2ranks.erase(name);
+      FlowName2bytes.erase(name);
+      it = flow_models.erase(it);
+    }
+  }
+
   std::map<int,std::shared_ptr<FlowModels>> MockNcclGroup::genFlowModels(GroupType type , int rank, AstraSim::ComType op,uint64_t data_size){
+    if (type == PP) {
+      return genP2PFlowModels(type,rank,data_size);
+    }
+    if (type == CP && op == AstraSim::ComType::All_to_All) {
+      return genRingP2PFlowModels(type,rank,data_size);
+    }
     switch (op) {
       case AstraSim::ComType::All_Reduce:
         return genAllReduceFlowModels(type,rank,data_size);
@@ -361,6 +553,11 @@ namespace MockNccl {
       ringchannels = Allringchannels[gp_idx];
       gp_info = AllGroups[gp_idx];
     }
+    bool PXN_ENABLE = false;
+    const char* PXN_ENV = std::getenv("AS_PXN_ENABLE");
+    if (PXN_ENV && strcmp(PXN_ENV, "1") == 0) {
+      PXN_ENABLE = true;
+    }
     nranks = gp_info.nRanks;
     chunkcount = nranks - 1;
     chunksize = data_size / nranks;
@@ -373,9 +570,156 @@ namespace MockNccl {
       }
       for(int j=0;j<gp_info.Ranks.size();j++){
         if(i == j ) continue;
-        tmp_result = SingleFlow(g_flow_id,gp_info.Ranks[i],gp_info.Ranks[j],chunksize,prev,{},{},0,0,1,"RING");
-        result[std::make_pair(0, g_flow_id)] = tmp_result;
-        g_flow_id++;
+        int proxy = PXN_ENABLE ? pxn_proxy(gp_info,0,gp_info.Ranks[i],gp_info.Ranks[j]) : -1;
+        if (proxy == -1) {
+          tmp_result = SingleFlow(g_flow_id,gp_info.Ranks[i],gp_info.Ranks[j],chunksize,prev,{},{},0,0,1,"RING");
+          result[std::make_pair(0, g_flow_id)] = tmp_result;
+          g_flow_id++;
+        } else {
+          // NVLink hop to the proxy, which forwards the chunk over its NIC
+          tmp_result = SingleFlow(g_flow_id,gp_info.Ranks[i],proxy,chunksize,prev,{},{g_flow_id + 1},0,0,1,"RING");
+          result[std::make_pair(0, g_flow_id)] = tmp_result;
+          g_flow_id++;
+          tmp_result = SingleFlow(g_flow_id,proxy,gp_info.Ranks[j],chunksize,{gp_info.Ranks[i]},{g_flow_id - 1},{},0,0,1,"PXN");
+          result[std::make_pair(0, g_flow_id)] = tmp_result;
+          g_flow_id++;
+        }
+      }
+    }
+    for(auto flow_models_it = result.begin();flow_models_it!=result.end();flow_models_it++){
+      int src = flow_models_it->second.src;
+      int dst = flow_models_it->second.dest;
+      rank2flowmodels[src][std::make_pair(flow_models_it->first.first,flow_models_it->first.second)]=flow_models_it->second;
+      rank2flowmodels[dst][std::make_pair(flow_models_it->first.first,flow_models_it->first.second)]=flow_models_it->second;
+    }
+    for(auto it = rank2flowmodels.begin();it!=rank2flowmodels.end();it++){
+      rank2pflowmodels[it->first] = std::make_shared<FlowModels>(it->second);
+    }
+    return rank2pflowmodels;
+  }
+
+  int MockNcclGroup::pxn_proxy(const GroupInfo& gp_info, int channel, int src, int dst){
+    int nic = AstraSim::RailTraffic::nic(dst, channel, gpus_per_node);
+    if (src / gpus_per_node == dst / gpus_per_node ||
+        AstraSim::RailTraffic::nic(src, channel, gpus_per_node) == nic) {
+      return -1;
+    }
+    // only ranks of the group run its flows
+    for (int rank : gp_info.Ranks) {
+      if (rank != src && rank / gpus_per_node == src / gpus_per_node &&
+          AstraSim::RailTraffic::nic(rank, channel, gpus_per_node) == nic) {
+        return rank;
+      }
+    }
+    return -1;
+  }
+
+  // Pipeline send/recv: every stage sends data_size bytes to the next stage.
+  // As in NCCL's p2p path the transfer is spread over a few channels per peer
+  // and each channel moves it in fixed-size chunks, one after another.
+  std::map<int,std::shared_ptr<FlowModels>> MockNcclGroup::genP2PFlowModels(GroupType type, int rank, uint64_t data_size){
+    FlowModels result = {};
+    std::map<int,FlowModels>rank2flowmodels;
+    std::map<int,std::shared_ptr<FlowModels>>rank2pflowmodels;
+    SingleFlow tmp_result;
+    GroupInfo gp_info;
+    int gp_idx;
+    MockNcclLog* NcclLog = MockNcclLog::getInstance();
+    if(GroupIndex.count(std::make_pair(rank,type))==0){
+      NcclLog->writeLog(NcclLogLevel::ERROR,"There is no corresponding group info, resulting in an error in generating the p2p flow model.");
+      return {};
+    } else {
+      gp_idx = GroupIndex[std::make_pair(rank,type)];
+      gp_info = AllGroups[gp_idx];
+    }
+    for (int i = 0; i + 1 < gp_info.Ranks.size(); i++) {
+      int src = gp_info.Ranks[i];
+      int dst = gp_info.Ranks[i + 1];
+      bool same_node = src / gpus_per_node == dst / gpus_per_node;
+      uint64_t chunksize = same_node ? NCCL_P2P_NVL_CHUNKSIZE : NCCL_P2P_NET_CHUNKSIZE;
+      // channels that would carry no bytes are left out, and the last
+      // channel carries the remainder
+      int nchannels = std::max<uint64_t>(1, std::min<uint64_t>(NCCL_P2P_CHANNELS_PER_PEER, data_size));
+      std::vector<int> prev = {};
+      if (i > 0) {
+        prev.push_back(gp_info.Ranks[i - 1]);
+      }
+      for (int channel_id = 0; channel_id < nchannels; channel_id++) {
+        uint64_t channel_size = data_size / nchannels;
+        if (channel_id + 1 == nchannels) {
+          channel_size += data_size % nchannels;
+        }
+        int chunkcount = channel_size == 0 ? 1 : (channel_size + chunksize - 1) / chunksize;
+        uint64_t send_size = 0;
+        for (int chunkid = 0; chunkid < chunkcount; chunkid++) {
+          uint64_t real_chunksize = std::min(chunksize, channel_size - send_size);
+          tmp_result = SingleFlow(g_flow_id,src,dst,real_chunksize,prev,{},{},channel_id,chunkid,chunkcount,"P2P");
+          result[std::make_pair(channel_id, g_flow_id)] = tmp_result;
+          g_flow_id++;
+          send_size += real_chunksize;
+        }
+      }
+    }
+    for(auto flow_models_it = result.begin();flow_models_it!=result.end();flow_models_it++){
+      int src = flow_models_it->second.src;
+      int dst = flow_models_it->second.dest;
+      rank2flowmodels[src][std::make_pair(flow_models_it->first.first,flow_models_it->first.second)]=flow_models_it->second;
+      rank2flowmodels[dst][std::make_pair(flow_models_it->first.first,flow_models_it->first.second)]=flow_models_it->second;
+    }
+    for(auto it = rank2flowmodels.begin();it!=rank2flowmodels.end();it++){
+      rank2pflowmodels[it->first] = std::make_shared<FlowModels>(it->second);
+    }
+    return rank2pflowmodels;
+  }
+
+  // Ring attention: every rank passes a data_size block to the next rank
+  // of the ring, nranks-1 times, and forwards in step s the block it
+  // received in step s-1. The block is spread over the p2p channels.
+  std::map<int,std::shared_ptr<FlowModels>> MockNcclGroup::genRingP2PFlowModels(GroupType type, int rank, uint64_t data_size){
+    FlowModels result = {};
+    std::map<int,FlowModels>rank2flowmodels;
+    std::map<int,std::shared_ptr<FlowModels>>rank2pflowmodels;
+    SingleFlow tmp_result;
+    GroupInfo gp_info;
+    int gp_idx;
+    MockNcclLog* NcclLog = MockNcclLog::getInstance();
+    if(GroupIndex.count(std::make_pair(rank,type))==0){
+      NcclLog->writeLog(NcclLogLevel::ERROR,"There is no corresponding group info, resulting in an error in generating the ring p2p flow model.");
+      return {};
+    } else {
+      gp_idx = GroupIndex[std::make_pair(rank,type)];
+      gp_info = AllGroups[gp_idx];
+    }
+    int nranks = gp_info.Ranks.size();
+    int chunkcount = nranks - 1;
+    // channel ids must stay below the ring count the flow model is told, and
+    // channels with no bytes are left out
+    int nchannels = std::max<uint64_t>(1, std::min<uint64_t>(
+        std::min<uint64_t>(NCCL_P2P_CHANNELS_PER_PEER, Allringchannels[gp_idx].size()), data_size));
+    for (int channel_id = 0; channel_id < nchannels; channel_id++) {
+      uint64_t channel_size = data_size / nchannels;
+      if (channel_id + 1 == nchannels) {
+        channel_size += data_size % nchannels;
+      }
+      // flow each rank received in the previous step
+      std::map<int,int> received;
+      for (int step = 0; step < chunkcount; step++) {
+        std::map<int,int> sent;
+        for (int i = 0; i < nranks; i++) {
+          int src = gp_info.Ranks[i];
+          int dst = gp_info.Ranks[(i + 1) % nranks];
+          std::vector<int> prev = {gp_info.Ranks[(i + nranks - 1) % nranks]};
+          std::vector<int> parents = {};
+          if (step > 0) {
+            parents.push_back(received[src]);
+            result[std::make_pair(channel_id, received[src])].child_flow_id.push_back(g_flow_id);
+          }
+          tmp_result = SingleFlow(g_flow_id,src,dst,channel_size,prev,parents,{},channel_id,step,chunkcount,"RING");
+          result[std::make_pair(channel_id, g_flow_id)] = tmp_result;
+          sent[dst] = g_flow_id;
+          g_flow_id++;
+        }
+        received = sent;
       }
     }
     for(auto flow_models_it = result.begin();flow_models_it!=result.end();flow_models_it++){
@@ -1730,7 +2074,6 @@ namespace MockNccl {
     int current;
     int nNodes;
     int nlocalRanks;
-    int delta;
     int gp_idx;
     if(GroupIndex.count(std::make_pair(rank,type))==0){
       NcclLog->writeLog(NcclLogLevel::ERROR,"There is no corresponding group info , resulting in an error in get_nvls_tree_channels.");
@@ -1746,17 +2089,7 @@ namespace MockNccl {
 
     nNodes = gp_info.nNodes;
     nlocalRanks = gp_info.nRanks/nNodes;
-    localrings = gen_local_ring(rank,type);
-    delta = nNodes > 1 ? gp_info.Ranks[nlocalRanks]-gp_info.Ranks[0] : 0;
-    std::map<int,std::vector<int>>rings;
-    for(ring_it = localrings.begin();ring_it != localrings.end();ring_it++) {
-      for(int i = 0; i < nNodes; i++) {
-        for(int j = 0; j < nlocalRanks; j++) {
-          current = ring_it->second[j] + i * delta;
-          rings[ring_it->first].push_back(current);
-        }
-      }
-    }
+    std::map<int,std::vector<int>>rings = gen_rings(rank,type);
     std::map<int, std::map<int, std::vector<int>>>
         allnode2ranks; 
     for (ring_it = rings.begin(); ring_it != rings.end(); ring_it++) {
@@ -1860,7 +2193,6 @@ namespace MockNccl {
     int current;
     int nNodes;
     int nlocalRanks;
-    int delta;
     MockNcclLog* NcclLog = MockNcclLog::getInstance();
     if(GroupIndex.count(std::make_pair(rank,type))==0){
       NcclLog->writeLog(NcclLogLevel::ERROR,"There is no corresponding group info and group ring channel, resulting in an error in gettreechannels.");
@@ -1874,17 +2206,7 @@ namespace MockNccl {
   
     nNodes = gp_info.nNodes;
     nlocalRanks = gp_info.nRanks/nNodes;
-    localrings = gen_local_ring(rank,type);
-    delta = nNodes > 1 ? gp_info.Ranks[nlocalRanks]-gp_info.Ranks[0] : 0;
-    std::map<int,std::vector<int>>rings;
-    for(ring_it = localrings.begin();ring_it != localrings.end();ring_it++) {
-      for(int i = 0; i < nNodes; i++) {
-        for(int j = 0; j < nlocalRanks; j++) {
-          current = ring_it->second[j] + i * delta; 
-          rings[ring_it->first].push_back(current);
-        }
-      }
-    }
+    std::map<int,std::vector<int>>rings = gen_rings(rank,type);
     std::vector<DoubleBinaryTreeNode*> roots;
     roots = genInterDouBinTree(gp_info);
     std::map<int, std::map<int, std::vector<int>>>
@@ -2052,10 +2374,20 @@ namespace MockNccl {
     case DP_EP:
       ncclInfoName = "DP_EP";
       break;
+    case PP:
+      ncclInfoName = "PP";
+      break;
+    case CP:
+      ncclInfoName = "CP";
+      break;
     default:
       break;
     }
     ncclInfoName+= "_"+std::to_string(static_cast<int>(op))+"_"+std::to_string(data_size);
+    // groups of a mixed cluster may pick different algorithms
+    if (AstraSim::NodeHardware::configured()) {
+      ncclInfoName += "_" + std::to_string(gp_info.group_index);
+    }
     if(nccl_infos.count(ncclInfoName)){ 
       return nccl_infos[ncclInfoName];
     }else{ 
@@ -2073,16 +2405,24 @@ namespace MockNccl {
     switch (op) {
       case AstraSim::ComType::All_Reduce:
           if(type==TP){
-            if(gpu_type==GPUType::A100||gpu_type==GPUType::A800){
+            // NVLS needs NVLink SHARP on every server of the group
+            bool nvls_capable = AstraSim::NodeHardware::nvls_capable(gpu_type);
+            if (AstraSim::NodeHardware::configured()) {
+              AstraSim::NodeSpec base{gpu_type, 0, 0, 0, 1};
+              for (int rank : gp_info.Ranks) {
+                nvls_capable = nvls_capable &&
+                    AstraSim::NodeHardware::nvls_capable(
+                        AstraSim::NodeHardware::of(rank / gpus_per_node, base).gpu_type);
+              }
+            }
+            if(!nvls_capable){
               info->algorithm = NCCL_ALGO_RING;
-            }else if(gpu_type==GPUType::H100||gpu_type==GPUType::H800){
+            }else{
               if (gp_info.nRanks >= 8 && NVLSenable) {
                 info->algorithm = NCCL_ALGO_NVLS;
               } else {
                 info->algorithm = NCCL_ALGO_RING;
               }
-            } else{
-              info->algorithm = NCCL_ALGO_RING;
             }
           } else {
             info->algorithm = NCCL_ALGO_RING;
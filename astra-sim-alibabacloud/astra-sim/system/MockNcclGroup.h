@@ -36,6 +36,8 @@ namespace MockNccl {
   typedef struct TuneInfo* TuneInfo_t;
   struct ncclChannelNode;
   typedef std::map<std::pair<int,int>,SingleFlow> FlowModels; 
+  // estimated heap bytes of a flow model, for memory accounting
+  int64_t FlowModelsBytes(const FlowModels& models);
   typedef std::map<int,std::map<int,std::vector<int>>> RingChannels; 
   typedef std::map<int,std::map<int,std::vector<ncclChannelNode*>>> NVLStreechannels;  
   typedef std::map<int,std::map<int,ncclTree>> TreeChannels;
@@ -45,6 +47,7 @@ namespace MockNccl {
     PP,
     EP,
     DP_EP,
+    CP,
     NONE
   };
   struct ncclInfo {
@@ -119,7 +122,7 @@ namespace MockNccl {
     };
    public:
     MockNcclGroup(){}
-    MockNcclGroup(int _ngpus,int _gpus_per_nodes, int _TP_size,int _DP_size,int _PP_size,int _EP_size,int _DP_EP_size,std::vector<int>_NVSwitch,GPUType _gpu_type);
+    MockNcclGroup(int _ngpus,int _gpus_per_nodes, int _TP_size,int _CP_size,int _DP_size,int _PP_size,int _EP_size,int _DP_EP_size,std::vector<int>_NVSwitch,GPUType _gpu_type,int _first_rank = 0);
     ~MockNcclGroup(){};
 
     std::map<std::pair<int,GroupType>,int> GroupIndex;
@@ -131,15 +134,31 @@ namespace MockNccl {
     std::map<int,TreeChannels> AllNVLSchannels;
 
     int g_flow_id;
+    // next flow id of each group in deterministic mode
+    std::map<int,int> group_flow_cursor;
     GPUType gpu_type;
+    int gpus_per_node;
     std::map<std::string,int> FlowName2nums;
+    // ranks that fetch each flow model, and its accounted bytes
+    std::map<std::string,int> FlowName2ranks;
+    std::map<std::string,int64_t> FlowName2bytes;
     std::map<std::string ,std::map<int,std::shared_ptr<FlowModels> >> flow_models; 
     std::map<std::string ,struct ncclInfo*> nccl_infos;  
     std::shared_ptr<void> getFlowModels(GroupType type , int rank, AstraSim::ComType op,uint64_t data_size,int layer_num,State loopstate);
+    // drops the cached flow models that every rank of their group has
+    // fetched; they are regenerated on next use
+    void evict_flow_models();
    private:
+    void account_flow_models(const std::string& flow_model_name);
+    int64_t cached_flow_model_bytes = 0;
     std::map<int,std::shared_ptr<FlowModels>> genFlowModels(GroupType type , int rank, AstraSim::ComType op,uint64_t data_size);
     std::map<int,std::shared_ptr<FlowModels>> genReduceScatterFlowModels(GroupType type , int rank, uint64_t data_size);
     std::map<int,std::shared_ptr<FlowModels>> genAlltoAllFlowModels(GroupType type, int rank, uint64_t data_size);
+    // member of the group on src's server that sends to dst over dst's rail
+    // for PXN, or -1 to send directly
+    int pxn_proxy(const GroupInfo& gp_info, int channel, int src, int dst);
+    std::map<int,std::shared_ptr<FlowModels>> genP2PFlowModels(GroupType type, int rank, uint64_t data_size);
+    std::map<int,std::shared_ptr<FlowModels>> genRingP2PFlowModels(GroupType type, int rank, uint64_t data_size);
     std::map<int,std::shared_ptr<FlowModels>> genAllReduceFlowModels(GroupType type , int rank,uint64_t data_size);
     std::map<int,std::shared_ptr<FlowModels>> genAllReduceRingFlowModels(GroupType type , int rank,uint64_t data_size);
     std::map<int,std::shared_ptr<FlowModels>> genAllreduceNVLSFlowModels(
@@ -162,6 +181,7 @@ namespace MockNccl {
         MockNccl::GroupInfo* groupInfo,
         std::map<int, std::map<int, std::vector<int>>>& ringchannels);
     std::map<int, std::vector<int>> gen_local_ring(int rank, GroupType type);
+    std::map<int, std::vector<int>> gen_rings(int rank, GroupType type);
     RingChannels genringchannels(
         int rank,
         GroupType type);
@@ -0,0 +1,207 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "NodeHardware.hh"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+namespace AstraSim {
+namespace {
+enum Field { GPU = 1, NVLINK = 2, NIC = 4, NICS = 8, COMPUTE = 16 };
+
+struct Entry {
+  int first;
+  int last;
+  int fields; // the Field bits the line sets
+  NodeSpec spec;
+};
+
+bool parse_gpu(const std::string& text, GPUType& gpu_type) {
+  if (text == "A100" || text == "a100") {
+    gpu_type = GPUType::A100;
+  } else if (text == "A800" || text == "a800") {
+    gpu_type = GPUType::A800;
+  } else if (text == "H100" || text == "h100") {
+    gpu_type = GPUType::H100;
+  } else if (text == "H800" || text == "h800") {
+    gpu_type = GPUType::H800;
+  } else if (text == "H20" || text == "h20") {
+    gpu_type = GPUType::H20;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void fail(const std::string& path, int line, const std::string& what) {
+  std::cerr << "AS_NODE_HARDWARE: " << path << ":" << line << ": " << what
+            << std::endl;
+  exit(1);
+}
+
+std::vector<Entry> load(const std::string& path) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "AS_NODE_HARDWARE: unable to open " << path << std::endl;
+    exit(1);
+  }
+  std::vector<Entry> entries;
+  std::string line;
+  int line_no = 0;
+  while (std::getline(in, line)) {
+    line_no++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos) {
+      line.erase(hash);
+    }
+    std::istringstream fields(line);
+    std::string nodes;
+    if (!(fields >> nodes)) {
+      continue;
+    }
+    Entry entry{0, 0, 0, {GPUType::NONE, 0, 0, 0, 1}};
+    size_t dash = nodes.find('-');
+    char* end;
+    entry.first = strtol(nodes.c_str(), &end, 10);
+    entry.last = dash == std::string::npos
+        ? entry.first
+        : strtol(nodes.c_str() + dash + 1, &end, 10);
+    if (*end != '\0' || entry.first < 0 || entry.last < entry.first) {
+      fail(path, line_no, "bad node range \"" + nodes + "\"");
+    }
+    std::string field;
+    while (fields >> field) {
+      size_t eq = field.find('=');
+      std::string key = field.substr(0, eq);
+      std::string value = eq == std::string::npos ? "" : field.substr(eq + 1);
+      char* value_end = nullptr;
+      if (key == "gpu") {
+        if (!parse_gpu(value, entry.spec.gpu_type)) {
+          fail(path, line_no,
+               "unknown gpu \"" + value + "\", expected A100, A800, H100, H800 or H20");
+        }
+        entry.fields |= GPU;
+        continue;
+      } else if (key == "nvlink") {
+        entry.spec.nvlink_bw = strtof(value.c_str(), &value_end);
+        entry.fields |= NVLINK;
+      } else if (key == "nic") {
+        entry.spec.bw_per_nic = strtof(value.c_str(), &value_end);
+        entry.fields |= NIC;
+      } else if (key == "nics") {
+        long nics = strtol(value.c_str(), &value_end, 10);
+        if (nics < 1) {
+          fail(path, line_no, "nics must be at least 1");
+        }
+        entry.spec.nics_per_server = nics;
+        entry.fields |= NICS;
+      } else if (key == "compute") {
+        entry.spec.compute = strtof(value.c_str(), &value_end);
+        if (entry.spec.compute <= 0) {
+          fail(path, line_no, "compute must be positive");
+        }
+        entry.fields |= COMPUTE;
+      } else {
+        fail(path, line_no,
+             "unknown field \"" + field + "\", expected gpu, nvlink, nic, nics or compute");
+      }
+      if (value.empty() || *value_end != '\0') {
+        fail(path, line_no, "bad value in \"" + field + "\"");
+      }
+    }
+    entries.push_back(entry);
+  }
+  return entries;
+}
+
+const std::vector<Entry>& entries() {
+  static std::once_flag once;
+  static std::vector<Entry> loaded;
+  std::call_once(once, [] {
+    const char* path = std::getenv("AS_NODE_HARDWARE");
+    if (path != nullptr && *path != '\0') {
+      loaded = load(path);
+    }
+  });
+  return loaded;
+}
+
+bool same(const NodeSpec& a, const NodeSpec& b) {
+  return a.gpu_type == b.gpu_type && a.nvlink_bw == b.nvlink_bw &&
+      a.bw_per_nic == b.bw_per_nic && a.nics_per_server == b.nics_per_server &&
+      a.compute == b.compute;
+}
+} // namespace
+
+bool NodeHardware::configured() {
+  const char* path = std::getenv("AS_NODE_HARDWARE");
+  return path != nullptr && *path != '\0';
+}
+
+NodeSpec NodeHardware::of(int node, const NodeSpec& base) {
+  NodeSpec spec = base;
+  // later lines override earlier ones
+  for (const Entry& entry : entries()) {
+    if (node < entry.first || node > entry.last) {
+      continue;
+    }
+    if (entry.fields & GPU) {
+      spec.gpu_type = entry.spec.gpu_type;
+    }
+    if (entry.fields & NVLINK) {
+      spec.nvlink_bw = entry.spec.nvlink_bw;
+    }
+    if (entry.fields & NIC) {
+      spec.bw_per_nic = entry.spec.bw_per_nic;
+    }
+    if (entry.fields & NICS) {
+      spec.nics_per_server = entry.spec.nics_per_server;
+    }
+    if (entry.fields & COMPUTE) {
+      spec.compute = entry.spec.compute;
+    }
+  }
+  return spec;
+}
+
+std::vector<NodeSpec> NodeHardware::distinct(
+    const std::vector<int>& nodes,
+    const NodeSpec& base) {
+  std::vector<NodeSpec> specs;
+  for (int node : nodes) {
+    NodeSpec spec = of(node, base);
+    if (std::none_of(specs.begin(), specs.end(), [&](const NodeSpec& seen) {
+          return same(seen, spec);
+        })) {
+      specs.push_back(spec);
+    }
+  }
+  return specs;
+}
+
+float NodeHardware::slowest_compute(int first, int count) {
+  NodeSpec base{GPUType::NONE, 0, 0, 0, 1};
+  float slowest = 0;
+  for (int node = first; node < first + count; node++) {
+    slowest = std::max(slowest, of(node, base).compute);
+  }
+  return slowest > 0 ? slowest : 1;
+}
+} // namespace AstraSim
@@ -0,0 +1,55 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __NODEHARDWARE_HH__
+#define __NODEHARDWARE_HH__
+
+#include <cstdint>
+#include <vector>
+#include "astra-sim/system/Common.hh"
+
+namespace AstraSim {
+struct NodeSpec {
+  GPUType gpu_type;
+  float nvlink_bw; // GB/s, <= 0 derives it from gpu_type
+  float bw_per_nic; // GB/s, <= 0 derives it from the NIC type
+  uint32_t nics_per_server;
+  float compute; // compute time relative to the GPU the workload was profiled on
+};
+
+// Hardware of the servers of a mixed cluster. AS_NODE_HARDWARE names a
+// file with one line per server or range of servers,
+//   <first node>[-<last node>] [gpu=H20] [nvlink=GB/s] [nic=GB/s] [nics=N]
+//                              [compute=x]
+// with "#" comments. Node n holds GPUs n*gpus_per_server onwards; a field
+// a line leaves out, or a server no line names, keeps the value the run
+// was started with.
+class NodeHardware {
+ public:
+  // AS_NODE_HARDWARE is set
+  static bool configured();
+  static NodeSpec of(int node, const NodeSpec& base);
+  // The different specs among `nodes`.
+  static std::vector<NodeSpec> distinct(
+      const std::vector<int>& nodes,
+      const NodeSpec& base);
+  // compute factor of the slowest of nodes [first, first + count)
+  static float slowest_compute(int first, int count);
+  static bool nvls_capable(GPUType gpu_type) {
+    return gpu_type == GPUType::H100 || gpu_type == GPUType::H800;
+  }
+};
+} // namespace AstraSim
+#endif
@@ -0,0 +1,326 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "OverlapTimeline.hh"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include "TraceExporter.hh"
+
+namespace AstraSim {
+std::mutex OverlapTimeline::mtx;
+std::string OverlapTimeline::path;
+std::map<int, OverlapTimeline::Timeline> OverlapTimeline::timelines;
+std::vector<std::string> OverlapTimeline::names;
+std::unordered_map<std::string, uint32_t> OverlapTimeline::name_ids;
+
+static const char* stream_names[] = {
+    "compute", "TP", "CP", "EP", "DP", "DP_EP", "PP"};
+
+bool OverlapTimeline::enabled() {
+  static const bool on = [] {
+    const char* env = std::getenv("AS_OVERLAP_STATS");
+    bool set = env != nullptr && std::atoi(env) != 0;
+#ifdef ANALYTI
+    if (set) {
+      std::cout << "AS_OVERLAP_STATS: collectives have no duration in "
+                << "SimAI-Analytical, the overlap report needs SimAI-Simulation "
+                << "or SimAI-phynet" << std::endl;
+    }
+#endif
+    return set;
+  }();
+  return on;
+}
+
+bool OverlapTimeline::recorded(int rank) {
+  static const std::vector<std::pair<int, int>> ranks = [] {
+    const char* env = std::getenv("AS_OVERLAP_RANKS");
+    return env != nullptr
+        ? TraceExporter::parse_ranks(env, "AS_OVERLAP_RANKS")
+        : std::vector<std::pair<int, int>>();
+  }();
+  if (ranks.empty()) {
+    return true;
+  }
+  for (auto& range : ranks) {
+    if (rank >= range.first && rank <= range.second) {
+      return true;
+    }
+  }
+  return false;
+}
+
+OverlapTimeline::Stream OverlapTimeline::stream_of(MockNccl::GroupType group) {
+  switch (group) {
+    case MockNccl::GroupType::CP:
+      return CP;
+    case MockNccl::GroupType::EP:
+      return EP;
+    case MockNccl::GroupType::DP:
+      return DP;
+    case MockNccl::GroupType::DP_EP:
+      return DP_EP;
+    case MockNccl::GroupType::PP:
+      return PP;
+    default:
+      return TP;
+  }
+}
+
+void OverlapTimeline::compute(int rank, Tick begin, Tick end) {
+  if (end <= begin) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mtx);
+  timelines[rank].streams[Compute].push_back({begin, end, 0});
+}
+
+void OverlapTimeline::collective(
+    int rank,
+    Stream stream,
+    const std::string& name,
+    Tick begin,
+    Tick end,
+    const std::string& path) {
+  std::lock_guard<std::mutex> lock(mtx);
+  if (OverlapTimeline::path.empty()) {
+    OverlapTimeline::path = path;
+  }
+  auto id = name_ids.find(name);
+  if (id == name_ids.end()) {
+    id = name_ids.emplace(name, names.size()).first;
+    names.push_back(name);
+  }
+  timelines[rank].streams[stream].push_back({begin, end, id->second});
+}
+
+// sorted disjoint intervals covering `intervals`
+static std::vector<std::pair<Tick, Tick>> merge(
+    std::vector<std::pair<Tick, Tick>> intervals) {
+  std::sort(intervals.begin(), intervals.end());
+  std::vector<std::pair<Tick, Tick>> busy;
+  for (auto& interval : intervals) {
+    if (interval.second <= interval.first) {
+      continue;
+    }
+    if (!busy.empty() && interval.first <= busy.back().second) {
+      busy.back().second = std::max(busy.back().second, interval.second);
+    } else {
+      busy.push_back(interval);
+    }
+  }
+  return busy;
+}
+
+// time of [begin, end) covered by the disjoint intervals `busy`
+static Tick overlap(
+    Tick begin,
+    Tick end,
+    const std::vector<std::pair<Tick, Tick>>& busy) {
+  auto it = std::upper_bound(
+      busy.begin(),
+      busy.end(),
+      begin,
+      [](Tick t, const std::pair<Tick, Tick>& interval) {
+        return t < interval.second;
+      });
+  Tick total = 0;
+  for (; it != busy.end() && it->first < end; ++it) {
+    total += std::min(end, it->second) - std::max(begin, it->first);
+  }
+  return total;
+}
+
+static Tick length(const std::vector<std::pair<Tick, Tick>>& busy) {
+  Tick total = 0;
+  for (auto& interval : busy) {
+    total += interval.second - interval.first;
+  }
+  return total;
+}
+
+static Tick overlap(
+    const std::vector<std::pair<Tick, Tick>>& a,
+    const std::vector<std::pair<Tick, Tick>>& b) {
+  Tick total = 0;
+  for (auto& interval : a) {
+    total += overlap(interval.first, interval.second, b);
+  }
+  return total;
+}
+
+void OverlapTimeline::report() {
+  std::lock_guard<std::mutex> lock(mtx);
+  if (names.empty()) {
+    timelines.clear();
+    return;
+  }
+  struct Row {
+    uint64_t count = 0;
+    Tick total = 0;
+    Tick with[STREAMS] = {};
+    Tick exposed = 0;
+    Tick concurrent = 0; // integral of the other collectives in flight
+  };
+  std::map<std::pair<uint32_t, int>, Row> rows;
+  Tick busy_sum[STREAMS] = {};
+  Tick hidden_sum[STREAMS] = {};
+  Tick comm_sum = 0, comm_exposed_sum = 0;
+  int peak = 0;
+
+  std::string streams_file = path + "overlap_streams.csv";
+  std::ofstream streams_out(streams_file);
+  if (!streams_out) {
+    std::cerr << "unable to write " << streams_file << std::endl;
+  } else {
+    streams_out << "rank,stream,busy_ns,hidden_ns,exposed_ns,peak_concurrent"
+                << std::endl;
+  }
+  for (auto& entry : timelines) {
+    Timeline& timeline = entry.second;
+    std::vector<std::pair<Tick, Tick>> busy[STREAMS];
+    std::vector<std::pair<Tick, Tick>> all_comm;
+    // collectives in flight: count[k] from at[k] to at[k + 1]
+    std::vector<std::pair<Tick, int>> events;
+    for (int s = 0; s < STREAMS; s++) {
+      std::vector<std::pair<Tick, Tick>> intervals;
+      intervals.reserve(timeline.streams[s].size());
+      for (auto& interval : timeline.streams[s]) {
+        intervals.push_back(std::make_pair(interval.begin, interval.end));
+        if (s != Compute && interval.end > interval.begin) {
+          events.push_back(std::make_pair(interval.begin, 1));
+          events.push_back(std::make_pair(interval.end, -1));
+        }
+      }
+      if (s != Compute) {
+        all_comm.insert(all_comm.end(), intervals.begin(), intervals.end());
+      }
+      busy[s] = merge(intervals);
+    }
+    all_comm = merge(all_comm);
+    std::sort(events.begin(), events.end());
+    std::vector<Tick> at;
+    std::vector<int> count;
+    int in_flight = 0, rank_peak = 0;
+    for (auto& event : events) {
+      in_flight += event.second;
+      if (!at.empty() && at.back() == event.first) {
+        count.back() = in_flight;
+      } else {
+        at.push_back(event.first);
+        count.push_back(in_flight);
+      }
+      rank_peak = std::max(rank_peak, in_flight);
+    }
+    peak = std::max(peak, rank_peak);
+
+    for (int s = 0; s < STREAMS; s++) {
+      if (s == Compute || busy[s].empty()) {
+        continue;
+      }
+      Tick stream_busy = length(busy[s]);
+      Tick hidden = overlap(busy[s], busy[Compute]);
+      busy_sum[s] += stream_busy;
+      hidden_sum[s] += hidden;
+      if (streams_out) {
+        streams_out << entry.first << "," << stream_names[s] << ","
+                    << stream_busy << "," << hidden << ","
+                    << stream_busy - hidden << "," << std::endl;
+      }
+      for (auto& interval : timeline.streams[s]) {
+        Row& row = rows[std::make_pair(interval.name, s)];
+        Tick len = interval.end - interval.begin;
+        row.count++;
+        row.total += len;
+        if (len == 0) {
+          continue;
+        }
+        for (int t = 0; t < STREAMS; t++) {
+          if (t != s) {
+            row.with[t] += overlap(interval.begin, interval.end, busy[t]);
+          }
+        }
+        row.exposed += len - overlap(interval.begin, interval.end, busy[Compute]);
+        // in-flight count integrated over the collective, itself excluded
+        size_t k = std::upper_bound(at.begin(), at.end(), interval.begin) -
+            at.begin() - 1;
+        for (; k < at.size() && at[k] < interval.end; k++) {
+          Tick from = std::max(at[k], interval.begin);
+          Tick to = k + 1 < at.size() ? std::min(at[k + 1], interval.end)
+                                      : interval.end;
+          row.concurrent += (Tick)count[k] * (to - from);
+        }
+        row.concurrent -= len;
+      }
+    }
+    Tick comm = length(all_comm);
+    Tick comm_hidden = overlap(all_comm, busy[Compute]);
+    comm_sum += comm;
+    comm_exposed_sum += comm - comm_hidden;
+    if (streams_out) {
+      streams_out << entry.first << ",all," << comm << "," << comm_hidden << ","
+                  << comm - comm_hidden << "," << rank_peak << std::endl;
+    }
+  }
+
+  std::string file = path + "overlap.csv";
+  std::ofstream out(file);
+  if (!out) {
+    std::cerr << "unable to write " << file << std::endl;
+  } else {
+    out << "collective,stream,count,total_ns";
+    for (int t = 0; t < STREAMS; t++) {
+      out << "," << stream_names[t] << "_ns";
+    }
+    out << ",exposed_ns,mean_concurrent" << std::endl;
+    for (auto& entry : rows) {
+      const Row& row = entry.second;
+      out << names[entry.first.first] << "," << stream_names[entry.first.second]
+          << "," << row.count << "," << row.total;
+      for (int t = 0; t < STREAMS; t++) {
+        out << ",";
+        if (t != entry.first.second) {
+          out << row.with[t];
+        }
+      }
+      out << "," << row.exposed << ","
+          << std::fixed << std::setprecision(2)
+          << (row.total > 0 ? (double)row.concurrent / row.total : 0.0)
+          << std::endl;
+      out.unsetf(std::ios::fixed);
+    }
+  }
+
+  std::cout << std::fixed << std::setprecision(1) << "Overlap over "
+            << timelines.size() << " ranks:";
+  for (int s = 0; s < STREAMS; s++) {
+    if (busy_sum[s] > 0) {
+      std::cout << " " << stream_names[s] << " " << busy_sum[s] / 1000.0
+                << " us, " << hidden_sum[s] * 100.0 / busy_sum[s]
+                << "% hidden;";
+    }
+  }
+  std::cout << " exposed comm " << comm_exposed_sum / 1000.0 << " of "
+            << comm_sum / 1000.0 << " us, peak " << peak
+            << " collectives in flight (" << file << ")" << std::endl;
+  std::cout.unsetf(std::ios::fixed);
+  timelines.clear();
+  names.clear();
+  name_ids.clear();
+}
+} // namespace AstraSim
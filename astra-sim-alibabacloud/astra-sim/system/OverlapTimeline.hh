@@ -0,0 +1,75 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __OVERLAPTIMELINE_HH__
+#define __OVERLAPTIMELINE_HH__
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "astra-sim/system/MockNcclChannel.h"
+
+namespace AstraSim {
+// Per-rank timelines of compute and of every communication stream, enabled
+// by AS_OVERLAP_STATS=1; AS_OVERLAP_RANKS takes a list such as "0-7,64" to
+// record only some ranks. A stream is the parallel group a collective runs
+// in. Recording appends the interval of a compute delay or of a collective,
+// from issue to completion, to the rank's array for that stream.
+//
+// At exit every array is sorted and merged into disjoint busy intervals, and
+// interval sweeps give, for every collective, how long it ran next to
+// compute and next to each other stream, how much of it was exposed, and how
+// many other collectives were in flight on average. <path>overlap.csv has
+// one row per collective name and stream summed over instances and ranks,
+// and <path>overlap_streams.csv the busy, hidden and exposed time of every
+// stream of every rank.
+class OverlapTimeline {
+ public:
+  enum Stream { Compute, TP, CP, EP, DP, DP_EP, PP, STREAMS };
+
+  static bool enabled();
+  static bool recorded(int rank);
+  static Stream stream_of(MockNccl::GroupType group);
+  static void compute(int rank, Tick begin, Tick end);
+  static void collective(
+      int rank,
+      Stream stream,
+      const std::string& name,
+      Tick begin,
+      Tick end,
+      const std::string& path);
+  static void report();
+
+ private:
+  struct Interval {
+    Tick begin;
+    Tick end;
+    uint32_t name; // collectives only
+  };
+  struct Timeline {
+    std::vector<Interval> streams[STREAMS];
+  };
+  static std::mutex mtx;
+  static std::string path;
+  static std::map<int, Timeline> timelines;
+  static std::vector<std::string> names;
+  static std::unordered_map<std::string, uint32_t> name_ids;
+};
+} // namespace AstraSim
+#endif
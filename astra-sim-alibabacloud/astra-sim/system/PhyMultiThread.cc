@@ -53,10 +53,8 @@ insert_recv_cqe(void* buff) {
       ptrrecvdata->tag_id,
       ptrrecvdata->nvls_on);
     NcclLog->writeLog(NcclLogLevel::DEBUG,"PhyMultiThread.cc::insert_recv_cqe src_id %d dst_id %d flow_id %d channel_id %d",flowTag.sender_node,flowTag.receiver_node,flowTag.current_flow_id,flowTag.channel_id);
-    flowTag.tree_flow_list.clear();
-    for(int i =0;i<ptrrecvdata->child_flow_size;i++){
-        flowTag.tree_flow_list.push_back(ptrrecvdata->child_flow_list[i]);
-    }
+    // the sender's slab handle means nothing here; the flow model takes the
+    // child flows from its own copy of the flow
     receive_finished_callback(flowTag);
 }
 
@@ -76,10 +74,7 @@ insert_send_cqe(void* buff) {
       ptrrecvdata->tag_id,
       ptrrecvdata->nvls_on);
     NcclLog->writeLog(NcclLogLevel::DEBUG,"PhyMultiThread.cc::insert_send_cqe src_id %d dst_id %d flow_id %d channel_id %d",flowTag.sender_node,flowTag.receiver_node,flowTag.current_flow_id,flowTag.channel_id);
-    flowTag.tree_flow_list.clear();
-    for(int i =0;i<ptrrecvdata->child_flow_size;i++){
-        flowTag.tree_flow_list.push_back(ptrrecvdata->child_flow_list[i]);
-    }
+    flowTag.tree_flow_handle = ptrrecvdata->tree_flow_handle;
     send_finished_callback(flowTag);
 }
 
@@ -0,0 +1,106 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "RailTraffic.hh"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include "NodeHardware.hh"
+
+namespace AstraSim {
+std::mutex RailTraffic::mtx;
+std::string RailTraffic::path;
+std::map<std::pair<int, int>, RailTraffic::Counter> RailTraffic::counters;
+
+int RailTraffic::nic(int gpu, int channel, int gpus_per_node) {
+  NodeSpec base{GPUType::NONE, 0, 0, (uint32_t)gpus_per_node, 1};
+  int nics = NodeHardware::configured()
+      ? NodeHardware::of(gpu / gpus_per_node, base).nics_per_server
+      : gpus_per_node;
+  int local = gpu % gpus_per_node;
+  if (nics >= gpus_per_node) {
+    int per_gpu = nics / gpus_per_node;
+    return local * per_gpu + channel % per_gpu;
+  }
+  return local * nics / gpus_per_node;
+}
+
+bool RailTraffic::enabled() {
+  static const bool on = [] {
+    const char* env = std::getenv("AS_RAIL_STATS");
+    return env != nullptr && std::atoi(env) != 0;
+  }();
+  return on;
+}
+
+void RailTraffic::sent(
+    int src,
+    int dst,
+    int channel,
+    uint64_t bytes,
+    int gpus_per_node,
+    const std::string& path) {
+  int server = src / gpus_per_node;
+  if (server == dst / gpus_per_node) {
+    return;
+  }
+  int rail = nic(src, channel, gpus_per_node);
+  std::lock_guard<std::mutex> lock(mtx);
+  if (RailTraffic::path.empty()) {
+    RailTraffic::path = path;
+  }
+  Counter& counter = counters[std::make_pair(server, rail)];
+  counter.bytes += bytes;
+  counter.flows++;
+}
+
+void RailTraffic::report() {
+  std::lock_guard<std::mutex> lock(mtx);
+  if (counters.empty()) {
+    return;
+  }
+  std::string file = path + "rail_traffic.csv";
+  std::ofstream out(file);
+  if (!out) {
+    std::cerr << "unable to write " << file << std::endl;
+  } else {
+    out << "server,nic,bytes,flows" << std::endl;
+    for (auto& entry : counters) {
+      out << entry.first.first << "," << entry.first.second << ","
+          << entry.second.bytes << "," << entry.second.flows << std::endl;
+    }
+  }
+  // load of each rail against the mean rail
+  std::map<int, uint64_t> rails;
+  uint64_t total = 0;
+  for (auto& entry : counters) {
+    rails[entry.first.second] += entry.second.bytes;
+    total += entry.second.bytes;
+  }
+  uint64_t busiest = 0;
+  for (auto& rail : rails) {
+    busiest = std::max(busiest, rail.second);
+  }
+  double mean = (double)total / rails.size();
+  std::cout << std::fixed << std::setprecision(2) << "Rail traffic over "
+            << rails.size() << " rails: " << total / 1048576.0
+            << " MB, busiest rail " << busiest / mean << "x the mean ("
+            << file << ")" << std::endl;
+  std::cout.unsetf(std::ios::fixed);
+  counters.clear();
+}
+} // namespace AstraSim
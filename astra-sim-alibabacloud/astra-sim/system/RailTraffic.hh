@@ -0,0 +1,59 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __RAILTRAFFIC_HH__
+#define __RAILTRAFFIC_HH__
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace AstraSim {
+// NIC selection on rail-optimized fabrics, where NIC k of every server sits
+// on rail k. A GPU sends to other servers through the NICs next to it:
+// with more NICs than GPUs its channels take turns over its own NICs, with
+// fewer NICs neighbouring GPUs share one. The NIC count of a server comes
+// from AS_NODE_HARDWARE and defaults to one NIC per GPU, as in the SimAI
+// topologies.
+// AS_RAIL_STATS=1 counts the bytes every NIC sends to other servers and
+// writes them to <path>rail_traffic.csv at exit.
+class RailTraffic {
+ public:
+  // NIC of the server of `gpu` that carries channel `channel` of the gpu
+  static int nic(int gpu, int channel, int gpus_per_node);
+  static bool enabled();
+  static void sent(
+      int src,
+      int dst,
+      int channel,
+      uint64_t bytes,
+      int gpus_per_node,
+      const std::string& path);
+  static void report();
+
+ private:
+  struct Counter {
+    uint64_t bytes = 0;
+    uint64_t flows = 0;
+  };
+  static std::mutex mtx;
+  static std::string path;
+  // (server, nic)
+  static std::map<std::pair<int, int>, Counter> counters;
+};
+} // namespace AstraSim
+#endif
@@ -0,0 +1,231 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "RankLayout.hh"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <tuple>
+
+namespace AstraSim {
+namespace {
+enum Dim { TP_DIM, CP_DIM, EP_DIM, DP_DIM, PP_DIM };
+
+// the dimensions fastest first
+std::vector<int> parse_order(const std::string& text) {
+  std::vector<int> order;
+  std::istringstream in(text);
+  std::string token;
+  bool seen[5] = {false, false, false, false, false};
+  while (std::getline(in, token, '-')) {
+    int dim;
+    if (token == "tp") {
+      dim = TP_DIM;
+    } else if (token == "cp") {
+      dim = CP_DIM;
+    } else if (token == "ep") {
+      dim = EP_DIM;
+    } else if (token == "dp") {
+      dim = DP_DIM;
+    } else if (token == "pp") {
+      dim = PP_DIM;
+    } else {
+      std::cerr << "AS_RANK_ORDER: unknown dimension \"" << token
+                << "\", expected tp, cp, ep, dp or pp" << std::endl;
+      exit(1);
+    }
+    if (seen[dim]) {
+      std::cerr << "AS_RANK_ORDER: " << token << " is listed twice"
+                << std::endl;
+      exit(1);
+    }
+    seen[dim] = true;
+    order.push_back(dim);
+  }
+  if (!seen[TP_DIM] || !seen[DP_DIM] || !seen[PP_DIM]) {
+    std::cerr << "AS_RANK_ORDER: " << text << " must list tp, dp and pp"
+              << std::endl;
+    exit(1);
+  }
+  if (!seen[CP_DIM]) {
+    order.insert(std::find(order.begin(), order.end(), TP_DIM) + 1, CP_DIM);
+  }
+  if (!seen[EP_DIM]) {
+    order.insert(std::find(order.begin(), order.end(), DP_DIM), EP_DIM);
+  }
+  return order;
+}
+
+std::vector<int> load_placement(const std::string& path, int ngpus) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "AS_RANK_PLACEMENT: unable to open " << path << std::endl;
+    exit(1);
+  }
+  std::vector<int> gpus;
+  std::vector<bool> used(ngpus, false);
+  std::string line;
+  while (std::getline(in, line)) {
+    size_t hash = line.find('#');
+    if (hash != std::string::npos) {
+      line.erase(hash);
+    }
+    std::istringstream fields(line);
+    int gpu;
+    while (fields >> gpu) {
+      if (gpu < 0 || gpu >= ngpus || used[gpu]) {
+        std::cerr << "AS_RANK_PLACEMENT: " << path << " places rank "
+                  << gpus.size() << " on "
+                  << (gpu < 0 || gpu >= ngpus ? "invalid" : "already used")
+                  << " gpu " << gpu << std::endl;
+        exit(1);
+      }
+      used[gpu] = true;
+      gpus.push_back(gpu);
+    }
+    if (!fields.eof()) {
+      std::cerr << "AS_RANK_PLACEMENT: " << path << " has a non-numeric entry"
+                << std::endl;
+      exit(1);
+    }
+  }
+  if (gpus.size() != (size_t)ngpus) {
+    std::cerr << "AS_RANK_PLACEMENT: " << path << " places " << gpus.size()
+              << " ranks, the job has " << ngpus << std::endl;
+    exit(1);
+  }
+  return gpus;
+}
+} // namespace
+
+bool RankLayout::configured() {
+  return std::getenv("AS_RANK_ORDER") != nullptr ||
+      std::getenv("AS_RANK_PLACEMENT") != nullptr;
+}
+
+RankLayout::RankLayout(
+    int ngpus,
+    int gpus_per_node,
+    int TP,
+    int CP,
+    int DP,
+    int PP,
+    int EP)
+    : gpus_per_node(gpus_per_node), size{TP, CP, EP, DP / EP, PP} {
+  gpus.resize(ngpus);
+  const char* order_env = std::getenv("AS_RANK_ORDER");
+  std::vector<int> order = parse_order(
+      order_env != nullptr && *order_env != '\0' ? order_env : "tp-cp-ep-dp-pp");
+  int stride[5];
+  int next = 1;
+  for (int dim : order) {
+    stride[dim] = next;
+    next *= size[dim];
+  }
+  for (int rank = 0; rank < ngpus; rank++) {
+    int rest = rank;
+    int ordered = 0;
+    for (int dim = TP_DIM; dim <= PP_DIM; dim++) {
+      ordered += rest % size[dim] * stride[dim];
+      rest /= size[dim];
+    }
+    gpus[rank] = ordered;
+  }
+  const char* placement = std::getenv("AS_RANK_PLACEMENT");
+  if (placement != nullptr && *placement != '\0') {
+    std::vector<int> placed = load_placement(placement, ngpus);
+    for (int& gpu : gpus) {
+      gpu = placed[gpu];
+    }
+  }
+}
+
+const RankLayout& RankLayout::get(
+    int ngpus,
+    int gpus_per_node,
+    int TP,
+    int CP,
+    int DP,
+    int PP,
+    int EP) {
+  static std::mutex lock;
+  static std::map<std::tuple<int, int, int, int, int, int>, RankLayout*>
+      layouts;
+  std::lock_guard<std::mutex> guard(lock);
+  RankLayout*& layout = layouts[std::make_tuple(ngpus, TP, CP, DP, PP, EP)];
+  if (layout == nullptr) {
+    layout = new RankLayout(ngpus, gpus_per_node, TP, CP, DP, PP, EP);
+  }
+  return *layout;
+}
+
+std::map<int, int> RankLayout::per_server(MockNccl::GroupType type) const {
+  // canonical stride and size of the dimension that varies in the group
+  int stride, members;
+  switch (type) {
+    case MockNccl::TP:
+      stride = 1;
+      members = size[TP_DIM];
+      break;
+    case MockNccl::CP:
+      stride = size[TP_DIM];
+      members = size[CP_DIM];
+      break;
+    case MockNccl::EP:
+      stride = size[TP_DIM] * size[CP_DIM];
+      members = size[EP_DIM];
+      break;
+    case MockNccl::DP_EP:
+      stride = size[TP_DIM] * size[CP_DIM] * size[EP_DIM];
+      members = size[DP_DIM];
+      break;
+    case MockNccl::DP:
+      stride = size[TP_DIM] * size[CP_DIM];
+      members = size[EP_DIM] * size[DP_DIM];
+      break;
+    default:
+      stride = size[TP_DIM] * size[CP_DIM] * size[EP_DIM] * size[DP_DIM];
+      members = size[PP_DIM];
+      break;
+  }
+  std::map<int, int> servers;
+  for (int i = 0; i < members; i++) {
+    servers[gpus[i * stride] / gpus_per_node]++;
+  }
+  return servers;
+}
+
+void RankLayout::span(MockNccl::GroupType type, int& nodes, int& per_node)
+    const {
+  std::map<int, int> servers = per_server(type);
+  nodes = servers.size();
+  per_node = 0;
+  for (auto& server : servers) {
+    per_node = std::max(per_node, server.second);
+  }
+}
+
+std::vector<int> RankLayout::servers(MockNccl::GroupType type) const {
+  std::vector<int> nodes;
+  for (auto& server : per_server(type)) {
+    nodes.push_back(server.first);
+  }
+  return nodes;
+}
+} // namespace AstraSim
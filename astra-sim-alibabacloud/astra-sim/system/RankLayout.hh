@@ -0,0 +1,72 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __RANKLAYOUT_HH__
+#define __RANKLAYOUT_HH__
+
+#include <map>
+#include <string>
+#include <vector>
+#include "astra-sim/system/MockNcclChannel.h"
+
+namespace AstraSim {
+// Maps the ranks of the parallel groups onto GPUs. Groups are enumerated
+// over canonical ranks, TP fastest, then CP, then EP, then the DP left
+// after EP, then PP. AS_RANK_ORDER reorders those dimensions Megatron
+// style, fastest first, e.g. "tp-cp-dp-ep-pp" or "dp-tp-pp"; cp defaults
+// to just after tp and ep to just before dp.
+// AS_RANK_PLACEMENT names a file listing the GPU of every rank of that
+// order, so ranks can be spread over racks or rails. GPU ids are relative
+// to the first rank of the job.
+class RankLayout {
+ public:
+  RankLayout(
+      int ngpus,
+      int gpus_per_node,
+      int TP,
+      int CP,
+      int DP,
+      int PP,
+      int EP);
+  // AS_RANK_ORDER or AS_RANK_PLACEMENT is set
+  static bool configured();
+  // The layout shared by the analytical estimates, built on first use.
+  static const RankLayout& get(
+      int ngpus,
+      int gpus_per_node,
+      int TP,
+      int CP,
+      int DP,
+      int PP,
+      int EP);
+  int gpu(int rank) const {
+    return gpus[rank];
+  }
+  // Servers and GPUs per server of the group of `type` holding rank 0.
+  void span(MockNccl::GroupType type, int& nodes, int& per_node) const;
+  // The servers that group spans, ascending.
+  std::vector<int> servers(MockNccl::GroupType type) const;
+
+ private:
+  // GPUs per server of the group of `type` holding rank 0
+  std::map<int, int> per_server(MockNccl::GroupType type) const;
+
+  int gpus_per_node;
+  // sizes of tp, cp, ep, the DP left after EP and pp
+  int size[5];
+  std::vector<int> gpus;
+};
+} // namespace AstraSim
+#endif
@@ -27,5 +27,19 @@ RecvPacketEventHadndlerData::RecvPacketEventHadndlerData(
     : BasicEventHandlerData(owner->owner, event) {
   this->flowTag = _flowTag;
 }
+RecvPacketEventHadndlerData::RecvPacketEventHadndlerData(
+    Sys* node,
+    EventType event,
+    AstraSim::ncclFlowTag flowTag)
+    : BasicEventHandlerData(node, event) {
+  this->owner = nullptr;
+  this->vnet = -1;
+  this->stream_num = -1;
+  this->message_end = true;
+  ready_time = Sys::boostedTick();
+  flow_id = -2;
+  child_flow_id = -1;
+  this->flowTag = flowTag;
+}
 
 } // namespace AstraSim
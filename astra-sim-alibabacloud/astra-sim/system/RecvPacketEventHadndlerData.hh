@@ -42,6 +42,8 @@ class RecvPacketEventHadndlerData : public BasicEventHandlerData,
       int vnet,
       int stream_num);
   RecvPacketEventHadndlerData(BaseStream*owner,EventType _event,AstraSim::ncclFlowTag _flowTag);
+  // receive that belongs to no stream, e.g. a rendezvous clear-to-send
+  RecvPacketEventHadndlerData(Sys* node, EventType event, AstraSim::ncclFlowTag flowTag);
 };
 } // namespace AstraSim
 #endif
@@ -16,7 +16,10 @@ RendezvousRecvData::RendezvousRecvData(
     sim_request request,
     void (*msg_handler)(void* fun_arg),
     void* fun_arg)
-    : BasicEventHandlerData(generator, EventType::RendezvousRecv) {
+    : SendPacketEventHandlerData(generator, nodeId, src, tag) {
+  this->event = EventType::RendezvousRecv;
+  this->owner = nullptr;
+  this->channel_id = -1;
   this->recv = new SimRecvCaller(
       generator, buffer, count, type, src, tag, request, msg_handler, fun_arg);
 }
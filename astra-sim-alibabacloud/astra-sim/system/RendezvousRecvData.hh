@@ -18,13 +18,15 @@ LICENSE file in the root directory of this source tree.
 #include <sstream>
 #include <tuple>
 #include <vector>
-#include "BasicEventHandlerData.hh"
 #include "Common.hh"
+#include "SendPacketEventHandlerData.hh"
 #include "SimRecvCaller.hh"
 
 namespace AstraSim {
 class Sys;
-class RendezvousRecvData : public BasicEventHandlerData, public MetaData {
+// Clear-to-send of a data receive; the network reports its completion as it
+// does for any send.
+class RendezvousRecvData : public SendPacketEventHandlerData {
  public:
   SimRecvCaller* recv;
   RendezvousRecvData(
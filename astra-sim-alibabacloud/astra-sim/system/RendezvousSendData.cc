@@ -16,8 +16,12 @@ RendezvousSendData::RendezvousSendData(
     int tag,
     sim_request request,
     void (*msg_handler)(void* fun_arg),
-    void* fun_arg)
-    : BasicEventHandlerData(generator, EventType::RendezvousSend) {
+    void* fun_arg,
+    ncclFlowTag control)
+    : RecvPacketEventHadndlerData(
+          generator,
+          EventType::RendezvousSend,
+          control) {
   this->send = new SimSendCaller(
       generator, buffer, count, type, dst, tag, request, msg_handler, fun_arg);
 }
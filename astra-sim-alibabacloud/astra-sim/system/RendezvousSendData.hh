@@ -18,13 +18,15 @@ LICENSE file in the root directory of this source tree.
 #include <sstream>
 #include <tuple>
 #include <vector>
-#include "BasicEventHandlerData.hh"
 #include "Common.hh"
+#include "RecvPacketEventHadndlerData.hh"
 #include "SimSendCaller.hh"
 
 namespace AstraSim {
 class Sys;
-class RendezvousSendData : public BasicEventHandlerData, public MetaData {
+// Waits for the clear-to-send of a data send; the network fills it in as it
+// does any receive.
+class RendezvousSendData : public RecvPacketEventHadndlerData {
  public:
   SimSendCaller* send;
   RendezvousSendData(
@@ -37,7 +39,8 @@ class RendezvousSendData : public BasicEventHandlerData, public MetaData {
       int tag,
       sim_request request,
       void (*msg_handler)(void* fun_arg),
-      void* fun_arg);
+      void* fun_arg,
+      ncclFlowTag control);
 };
 } // namespace AstraSim
 #endif
@@ -0,0 +1,165 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "SendChannelTable.hh"
+
+namespace AstraSim {
+static inline uint64_t pack_key(int dst, int tag) {
+  return ((uint64_t)(uint32_t)dst << 32) | (uint32_t)tag;
+}
+
+static inline size_t hash_key(uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  return (size_t)key;
+}
+
+SendChannelTable::SendChannelTable(Sys* sys, int sender)
+    : sys(sys),
+      sender(sender),
+      locked(false),
+      keys(64, 0),
+      slots(64, nullptr),
+      used(0),
+      free_list(nullptr),
+      queued(0),
+      in_flight(0),
+      retired(false) {}
+
+SendChannelTable::Channel* SendChannelTable::find_or_insert(int dst, int tag) {
+  uint64_t key = pack_key(dst, tag);
+  size_t mask = slots.size() - 1;
+  size_t i = hash_key(key) & mask;
+  while (slots[i] != nullptr) {
+    if (keys[i] == key) {
+      return slots[i];
+    }
+    i = (i + 1) & mask;
+  }
+  channels.emplace_back();
+  keys[i] = key;
+  slots[i] = &channels.back();
+  if (++used * 2 > slots.size()) {
+    grow();
+  }
+  return &channels.back();
+}
+
+void SendChannelTable::grow() {
+  std::vector<uint64_t> old_keys;
+  std::vector<Channel*> old_slots;
+  old_keys.swap(keys);
+  old_slots.swap(slots);
+  keys.assign(old_slots.size() * 2, 0);
+  slots.assign(old_slots.size() * 2, nullptr);
+  size_t mask = slots.size() - 1;
+  for (size_t j = 0; j < old_slots.size(); j++) {
+    if (old_slots[j] == nullptr) {
+      continue;
+    }
+    size_t i = hash_key(old_keys[j]) & mask;
+    while (slots[i] != nullptr) {
+      i = (i + 1) & mask;
+    }
+    keys[i] = old_keys[j];
+    slots[i] = old_slots[j];
+  }
+}
+
+SendChannelTable::Descriptor* SendChannelTable::begin_send(
+    int dst,
+    int tag,
+    void* buffer,
+    uint64_t count,
+    int type,
+    const sim_request& request,
+    void (*msg_handler)(void* fun_arg)) {
+  lock_table();
+  Channel* channel = find_or_insert(dst, tag);
+  Descriptor* desc = free_list;
+  if (desc != nullptr) {
+    free_list = desc->next;
+  } else {
+    descriptors.emplace_back(sys, sender, this);
+    desc = &descriptors.back();
+  }
+  desc->receiverNodeId = dst;
+  desc->tag = tag;
+  desc->channel = channel;
+  desc->next = nullptr;
+  in_flight++;
+  if (!channel->busy) {
+    channel->busy = true;
+    unlock_table();
+    return desc;
+  }
+  desc->buffer = buffer;
+  desc->count = count;
+  desc->type = type;
+  desc->request = request;
+  desc->msg_handler = msg_handler;
+  if (channel->tail == nullptr) {
+    channel->head = desc;
+  } else {
+    channel->tail->next = desc;
+  }
+  channel->tail = desc;
+  queued.fetch_add(1, std::memory_order_release);
+  unlock_table();
+  return nullptr;
+}
+
+SendChannelTable::Descriptor* SendChannelTable::finish_send(Descriptor* sent) {
+  lock_table();
+  Channel* channel = sent->channel;
+  Descriptor* next = channel->head;
+  if (next == nullptr) {
+    channel->busy = false;
+  } else {
+    channel->head = next->next;
+    if (channel->head == nullptr) {
+      channel->tail = nullptr;
+    }
+    next->next = nullptr;
+    queued.fetch_sub(1, std::memory_order_release);
+  }
+  sent->next = free_list;
+  free_list = sent;
+  in_flight--;
+  unlock_table();
+  return next;
+}
+
+void SendChannelTable::retire() {
+  lock_table();
+  retired = true;
+  bool idle = in_flight == 0;
+  unlock_table();
+  if (idle) {
+    delete this;
+  }
+}
+
+void SendChannelTable::release_orphan(Descriptor* sent) {
+  SendChannelTable* table = sent->table;
+  table->lock_table();
+  bool idle = --table->in_flight == 0 && table->retired;
+  table->unlock_table();
+  if (idle) {
+    delete table;
+  }
+}
+} // namespace AstraSim
@@ -0,0 +1,103 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __SENDCHANNELTABLE_HH__
+#define __SENDCHANNELTABLE_HH__
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "SendPacketEventHandlerData.hh"
+
+namespace AstraSim {
+// Per-rank serialization of zero-delay sends: only one send per (dst, tag) is
+// handed to the network at a time and the rest wait in FIFO order until the
+// frontend reports PacketSent. Channels live in an open-addressing table keyed
+// by the packed (dst, tag) pair and never move once created. Send descriptors
+// come from a pool owned by the table and double as the PacketSent event
+// data, so steady-state sends do not touch the heap. The table has its own
+// spin lock, so ranks on different MTP threads do not contend with each other.
+class SendChannelTable {
+ public:
+  struct Channel;
+  struct Descriptor : public SendPacketEventHandlerData {
+    Descriptor(Sys* sys, int sender, SendChannelTable* table)
+        : SendPacketEventHandlerData(sys, sender, -1, -1), table(table) {}
+    SendChannelTable* table;
+    Channel* channel = nullptr;
+    Descriptor* next = nullptr;
+    // arguments of a send waiting for its channel
+    void* buffer = nullptr;
+    uint64_t count = 0;
+    int type = 0;
+    sim_request request;
+    void (*msg_handler)(void* fun_arg) = nullptr;
+  };
+  struct Channel {
+    bool busy = false;
+    Descriptor* head = nullptr;
+    Descriptor* tail = nullptr;
+  };
+
+  SendChannelTable(Sys* sys, int sender);
+  // Claims the (dst, tag) channel. Returns the descriptor to pass to the
+  // network as fun_arg, or nullptr when the send was queued behind the one in
+  // flight.
+  Descriptor* begin_send(
+      int dst,
+      int tag,
+      void* buffer,
+      uint64_t count,
+      int type,
+      const sim_request& request,
+      void (*msg_handler)(void* fun_arg));
+  // Retires a sent descriptor and returns the next queued send on its channel,
+  // if any, which the caller must hand to the network.
+  Descriptor* finish_send(Descriptor* sent);
+  bool has_pending() const {
+    return queued.load(std::memory_order_acquire) != 0;
+  }
+  // Called when the owning Sys goes away. Sends still in flight keep the
+  // table alive until they complete through release_orphan.
+  void retire();
+  static void release_orphan(Descriptor* sent);
+
+ private:
+  Channel* find_or_insert(int dst, int tag);
+  void grow();
+  void lock_table() {
+    while (locked.exchange(true, std::memory_order_acquire))
+      ;
+  }
+  void unlock_table() {
+    locked.store(false, std::memory_order_release);
+  }
+
+  Sys* sys;
+  int sender;
+  std::atomic<bool> locked;
+  std::vector<uint64_t> keys;
+  std::vector<Channel*> slots;
+  size_t used;
+  std::deque<Channel> channels;
+  std::deque<Descriptor> descriptors;
+  Descriptor* free_list;
+  std::atomic<int> queued;
+  int in_flight;
+  bool retired;
+};
+} // namespace AstraSim
+#endif
@@ -64,6 +64,8 @@ struct TransportData{
   int tag_id;
   int child_flow_size;
   int child_flow_list[MAX_CHILD_FLOW_SIZE];
+  // FlowTagSlab handle of child_flow_list in the sending process
+  uint32_t tree_flow_handle;
   bool nvls_on;
   TransportData(
       int _channel_id,
@@ -85,6 +87,7 @@ struct TransportData{
         flow_size(_flow_size),
         pQps(_pQps),
         tag_id(_tag_id),
+        tree_flow_handle(0),
         nvls_on(_nvls_on) {};
   ~TransportData(){};
 };
@@ -0,0 +1,122 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "StartupProfiler.hh"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace AstraSim {
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+struct PhaseStats {
+  const char* name;
+  int calls;
+  double busy;
+  Clock::time_point first;
+  Clock::time_point last;
+};
+
+std::mutex stats_lock;
+// in order of first appearance, a handful of entries
+std::vector<PhaseStats> stats;
+bool reported = false;
+
+void record(const char* name, Clock::time_point start, Clock::time_point end) {
+  std::lock_guard<std::mutex> guard(stats_lock);
+  for (auto& phase : stats) {
+    if (std::strcmp(phase.name, name) == 0) {
+      phase.calls++;
+      phase.busy += std::chrono::duration<double>(end - start).count();
+      if (start < phase.first) {
+        phase.first = start;
+      }
+      if (end > phase.last) {
+        phase.last = end;
+      }
+      return;
+    }
+  }
+  stats.push_back(PhaseStats{
+      name, 1, std::chrono::duration<double>(end - start).count(), start, end});
+}
+} // namespace
+
+StartupProfiler::Phase::Phase(const char* name)
+    : name(name), start(Clock::now()), running(true) {}
+
+StartupProfiler::Phase::~Phase() {
+  stop();
+}
+
+void StartupProfiler::Phase::stop() {
+  if (running) {
+    running = false;
+    record(name, start, Clock::now());
+  }
+}
+
+bool StartupProfiler::enabled() {
+  static const bool on = [] {
+    const char* env = std::getenv("AS_STARTUP_PROFILE");
+    return env != nullptr && std::atoi(env) != 0;
+  }();
+  return on;
+}
+
+int StartupProfiler::threads() {
+  static const int count = [] {
+    const char* env = std::getenv("AS_STARTUP_THREADS");
+    if (env != nullptr && std::atoi(env) > 0) {
+      return std::atoi(env);
+    }
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }();
+  return count;
+}
+
+void StartupProfiler::report() {
+  std::lock_guard<std::mutex> guard(stats_lock);
+  if (reported || !enabled() || stats.empty()) {
+    return;
+  }
+  reported = true;
+  std::vector<PhaseStats> phases = stats;
+  std::stable_sort(
+      phases.begin(), phases.end(), [](const PhaseStats& a, const PhaseStats& b) {
+        return a.first < b.first;
+      });
+  Clock::time_point origin = phases[0].first;
+  printf("Startup phases (startup threads: %d):\n", threads());
+  printf(
+      "%-20s %8s %10s %10s %10s\n", "phase", "calls", "start s", "wall s",
+      "busy s");
+  for (auto& phase : phases) {
+    printf(
+        "%-20s %8d %10.3f %10.3f %10.3f\n",
+        phase.name,
+        phase.calls,
+        std::chrono::duration<double>(phase.first - origin).count(),
+        std::chrono::duration<double>(phase.last - phase.first).count(),
+        phase.busy);
+  }
+  fflush(stdout);
+}
+} // namespace AstraSim
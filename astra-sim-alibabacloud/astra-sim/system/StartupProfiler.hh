@@ -0,0 +1,53 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __STARTUPPROFILER_HH__
+#define __STARTUPPROFILER_HH__
+
+#include <chrono>
+
+namespace AstraSim {
+// Wall-clock timing of the startup phases (configuration, topology, routes,
+// Sys and workload construction, communicator setup). Phases are always
+// recorded; AS_STARTUP_PROFILE=1 prints them once startup is complete.
+//
+// A phase may run many times and on several threads at once, e.g. one
+// "sys_init" per rank on the startup workers; the report then shows both
+// the wall span from its first start to its last end and the busy time
+// summed over all runs.
+class StartupProfiler {
+ public:
+  class Phase {
+   public:
+    explicit Phase(const char* name);
+    ~Phase();
+    // Ends the phase before the end of its scope; later calls are no-ops.
+    void stop();
+
+   private:
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+    bool running;
+  };
+
+  static bool enabled();
+  // Workers used to build the Sys objects in parallel, AS_STARTUP_THREADS;
+  // defaults to the hardware concurrency, 1 keeps the serial startup.
+  static int threads();
+  static void report();
+};
+} // namespace AstraSim
+
+#endif
@@ -7,8 +7,15 @@ LICENSE file in the root directory of this source tree.
 #include "BaseStream.hh"
 #include "DataSet.hh"
 #include "MemBus.hh"
+#include "NodeHardware.hh"
 #include "QueueLevels.hh"
+#include "OverlapTimeline.hh"
+#include "RailTraffic.hh"
 #include "SimRecvCaller.hh"
+#include "CriticalPath.hh"
+#include "SendChannelTable.hh"
+#include "StartupProfiler.hh"
+#include "TraceExporter.hh"
 #include "SimSendCaller.hh"
 #include "StreamBaseline.hh"
 #include "Common.hh"
@@ -32,15 +39,28 @@ LICENSE file in the root directory of this source tree.
 
 #include <algorithm>
 #include <cmath>
+#include <mutex>
 #include <numeric>
 
-MockNccl::MockNcclGroup* GlobalGroup = nullptr;
+// one group per job, keyed by the job's first rank (0 for a single job)
+static std::map<int, MockNccl::MockNcclGroup*> GlobalGroups;
 
 namespace AstraSim {
 std::atomic<bool> Sys::g_sys_inCriticalSection(false);
 Tick Sys::offset = 0;
 uint8_t* Sys::dummy_data = new uint8_t[2];
 std::vector<Sys*> Sys::all_generators;
+// Ranks may be constructed concurrently (ns-3 startup workers); guards
+// all_generators and the shared MockNcclGroup while they are set up.
+static std::mutex startup_lock;
+std::atomic<uint64_t> Sys::eager_messages(0);
+std::atomic<uint64_t> Sys::rendezvous_messages(0);
+std::atomic<uint64_t> Sys::rendezvous_control_bytes(0);
+static MemoryAccounting::Counter event_queue_bytes("sys_event_queue");
+static const int64_t EVENT_ENTRY_BYTES = MemoryAccounting::node_bytes<
+    std::tuple<Callable*, EventType, CallData*, uint64_t>>();
+static const int64_t EVENT_TICK_BYTES = MemoryAccounting::node_bytes<
+    std::pair<const Tick, std::list<std::tuple<Callable*, EventType, CallData*, uint64_t>>>>();
 
 Sys::~Sys() {
   end_sim_time = std::chrono::high_resolution_clock::now();
@@ -98,6 +118,10 @@ Sys::~Sys() {
     delete workload;
   if (offline_greedy != nullptr)
     delete offline_greedy;
+  send_channels->retire();
+  if (Determinism::enabled()) {
+    Determinism::commit(id, fingerprint);
+  }
   bool shouldExit = true;
   
   for(int i = 0; i < num_gpus; ++ i) {
@@ -109,6 +133,12 @@ Sys::~Sys() {
   }
 
   if (shouldExit) {
+    report_protocol_stats();
+    CriticalPathRecorder::report();
+    RailTraffic::report();
+    OverlapTimeline::report();
+    Determinism::report();
+    MemoryAccounting::report();
     exitSimLoop("Exiting");
   }
   #else
@@ -156,6 +186,8 @@ Sys::Sys(
   this->MEM = MEM;
   this->id = id;
   this->npu_offset=npu_offset;
+  this->job = JobManifest::of(id + npu_offset);
+  this->send_channels = new SendChannelTable(this, id + npu_offset);
   this->method = "baseline";
   this->finished_workloads = 0;
   this->streams_finished = 0;
@@ -174,15 +206,37 @@ Sys::Sys(
   this->local_reduction_delay = 1;
   this->active_chunks_per_dimension = 1;
   this->seprate_log = seprate_log;
-  this->rendezvous_enabled = rendezvous_enabled;
+  rendezvous_control_flows = 0;
+  set_rendezvous_protocol(
+      rendezvous_enabled ? 0 : RENDEZVOUS_DISABLED, 8192);
   this->NVSwitchs = _NVSwitchs;
   this->all_gpus = _all_gpus;
   this->gpu_type = _gpu_type;
   this->ngpus_per_node = _ngpus_per_node;
-  if ((id + npu_offset + 1) > all_generators.size()) {
-    all_generators.resize(id + npu_offset + 1);
+  if (NodeHardware::configured() && _ngpus_per_node > 0 && !_all_gpus.empty()) {
+    // compute times are profiled on one GPU type; a server of another kind
+    // stretches them by its compute factor
+    int first_gpu = job == nullptr ? 0 : job->first_rank;
+#ifdef ANALYTI
+    // this Sys stands for every rank of the job, which keeps the pace of
+    // its slowest server
+    this->compute_scale *= NodeHardware::slowest_compute(
+        first_gpu / _ngpus_per_node,
+        std::max(1, _all_gpus[0] / _ngpus_per_node));
+#else
+    if (id + npu_offset >= first_gpu && id + npu_offset < first_gpu + _all_gpus[0]) {
+      this->compute_scale *= NodeHardware::slowest_compute(
+          (id + npu_offset) / _ngpus_per_node, 1);
+    }
+#endif
+  }
+  {
+    std::lock_guard<std::mutex> guard(startup_lock);
+    if ((id + npu_offset + 1) > all_generators.size()) {
+      all_generators.resize(id + npu_offset + 1);
+    }
+    all_generators[id+npu_offset] = this;
   }
-  all_generators[id+npu_offset] = this;
 
   inp_scheduling_policy = "LIFO";
   communication_delay = 10 * injection_scale;
@@ -282,6 +336,7 @@ Sys::Sys(
       model_shared_bus,
       communication_delay,
       true);
+  StartupProfiler::Phase workload_phase("workload_parse");
   workload = new Workload(
       run_name,
       this,
@@ -296,7 +351,10 @@ Sys::Sys(
         "Unable to initialize the workload layer because it can not open the workload file");
     return;
   }
+  workload_phase.stop();
   #if defined(NS3_MTP) || defined(NS3_MPI) || defined(PHY_MTP)
+  StartupProfiler::Phase comm_phase("comm_init");
+  std::unique_lock<std::mutex> comm_guard(startup_lock);
   result = mock_nccl_grobal_group_init();
   if(result == false) {
     sys_panic(
@@ -307,6 +365,8 @@ Sys::Sys(
     sys_panic(
         "Unable to initialize the system mockncclComm because the file can not be openned");
   }
+  comm_guard.unlock();
+  comm_phase.stop();
   #endif
   if (inter_dimension_scheduling == InterDimensionScheduling::OfflineGreedy ||
       inter_dimension_scheduling ==
@@ -439,6 +499,20 @@ int Sys::get_priority(SchedulingPolicy pref_scheduling) {
     }
   }
 }
+// Flow tag of the clear-to-send of a data flow; both ends build the same
+// one from the tag_id the network matches the data flow on: the sender from
+// its request, the receiver from its RecvPacketEventHadndlerData.
+ncclFlowTag Sys::rendezvous_control_tag(
+    int data_tag_id,
+    int sender,
+    int receiver) {
+  ncclFlowTag flowTag;
+  flowTag.tag_id = data_tag_id + RENDEZVOUS_TAG_OFFSET;
+  flowTag.sender_node = sender;
+  flowTag.receiver_node = receiver;
+  flowTag.flow_size = rendezvous_control_size;
+  return flowTag;
+}
 int Sys::rendezvous_sim_send(
     Tick delay,
     void* buffer,
@@ -449,22 +523,33 @@ int Sys::rendezvous_sim_send(
     sim_request* request,
     void (*msg_handler)(void* fun_arg),
     void* fun_arg) {
+  ncclFlowTag control =
+      rendezvous_control_tag(request->flowTag.tag_id, dst, id);
   RendezvousSendData* rsd = new RendezvousSendData(
-      id, this, buffer, count, type, dst, tag, *request, msg_handler, fun_arg);
+      id,
+      this,
+      buffer,
+      count,
+      type,
+      dst,
+      tag,
+      *request,
+      msg_handler,
+      fun_arg,
+      control);
   sim_request newReq = *request;
-  uint64_t rendevouz_size = 8192;
-  newReq.dstRank = request->srcRank;
-  newReq.srcRank = request->dstRank;
-  newReq.reqCount = rendevouz_size;
-  int newTag = tag + 500000000;
-  newReq.tag = newTag;
+  newReq.srcRank = dst;
+  newReq.dstRank = id;
+  newReq.reqCount = rendezvous_control_size;
+  newReq.tag = control.tag_id;
+  newReq.flowTag = control;
   sim_recv(
       delay,
       buffer,
-      rendevouz_size,
+      rendezvous_control_size,
       type,
       dst,
-      newTag,
+      control.tag_id,
       &newReq,
       &Sys::handleEvent,
       rsd);
@@ -481,36 +566,12 @@ int Sys::sim_send(
     void (*msg_handler)(void* fun_arg),
     void* fun_arg) {
   if (delay == 0 && fun_arg == nullptr) {
-    Sys::sysCriticalSection cs;
-      
-    SendPacketEventHandlerData* fun_arg_tmp =
-        new SendPacketEventHandlerData(this, id+npu_offset, dst, tag);
-    fun_arg = (void*)fun_arg_tmp;
-    if (is_there_pending_sends.find(std::make_pair(dst, tag)) == is_there_pending_sends.end() ||
-    is_there_pending_sends[std::make_pair(dst, tag)] == false) {
-      is_there_pending_sends[std::make_pair(dst, tag)] = true;
-      cs.ExitSection();
-    } else {
-      if (pending_sends.find(std::make_pair(dst, tag)) ==
-          pending_sends.end()) {
-        std::list<SimSendCaller*> tmp;
-        pending_sends[std::make_pair(dst, tag)] = tmp;
-      }
-      pending_sends[std::make_pair(dst, tag)].push_back(
-          new SimSendCaller(
-              this,
-              buffer,
-              count,
-              type,
-              dst,
-              tag,
-              *request,
-              msg_handler,
-              fun_arg));
-      
-      cs.ExitSection();
+    SendChannelTable::Descriptor* send = send_channels->begin_send(
+        dst, tag, buffer, count, type, *request, msg_handler);
+    if (send == nullptr) {
       return 1;
     }
+    fun_arg = (void*)send;
   }
 
   if (delay == 0) {
@@ -543,10 +604,13 @@ int Sys::front_end_sim_send(
     sim_request* request,
     void (*msg_handler)(void* fun_arg),
     void* fun_arg) {
-  if (rendezvous_enabled) {
+  if (count >= rendezvous_threshold) {
+    rendezvous_messages++;
+    rendezvous_control_bytes += rendezvous_control_size;
     return rendezvous_sim_send(
         delay, buffer, count, type, dst, tag, request, msg_handler, fun_arg);
   } else {
+    eager_messages++;
     return sim_send(
         delay, buffer, count, type, dst, tag, request, msg_handler, fun_arg);
   }
@@ -561,22 +625,26 @@ int Sys::rendezvous_sim_recv(
     sim_request* request,
     void (*msg_handler)(void* fun_arg),
     void* fun_arg) {
+  // receives always hand the network a RecvPacketEventHadndlerData, whose
+  // flow tag it matches against the sender's
+  RecvPacketEventHadndlerData* ehd = (RecvPacketEventHadndlerData*)fun_arg;
+  ncclFlowTag control = rendezvous_control_tag(ehd->flowTag.tag_id, id, src);
+  control.current_flow_id = -2 - (int)(rendezvous_control_flows++ % INT32_MAX);
   RendezvousRecvData* rrd = new RendezvousRecvData(
       id, this, buffer, count, type, src, tag, *request, msg_handler, fun_arg);
   sim_request newReq = *request;
-  uint64_t rendevouz_size = 8192;
-  newReq.dstRank = request->srcRank;
-  newReq.srcRank = request->dstRank;
-  newReq.reqCount = rendevouz_size;
-  int newTag = tag + 500000000;
-  newReq.tag = newTag;
+  newReq.srcRank = id;
+  newReq.dstRank = src;
+  newReq.reqCount = rendezvous_control_size;
+  newReq.tag = control.tag_id;
+  newReq.flowTag = control;
   sim_send(
       delay,
       buffer,
-      rendevouz_size,
+      rendezvous_control_size,
       type,
       src,
-      newTag,
+      control.tag_id,
       &newReq,
       &Sys::handleEvent,
       rrd);
@@ -622,7 +690,7 @@ int Sys::front_end_sim_recv(
     sim_request* request,
     void (*msg_handler)(void* fun_arg),
     void* fun_arg) {
-  if (rendezvous_enabled) {
+  if (count >= rendezvous_threshold) {
     return rendezvous_sim_recv(
         delay, buffer, count, type, src, tag, request, msg_handler, fun_arg);
   } else {
@@ -630,6 +698,37 @@ int Sys::front_end_sim_recv(
         delay, buffer, count, type, src, tag, request, msg_handler, fun_arg);
   }
 }
+void Sys::set_rendezvous_protocol(
+    uint64_t threshold,
+    uint64_t control_size) {
+  const char* threshold_env = std::getenv("AS_RENDEZVOUS_THRESHOLD");
+  const char* control_env = std::getenv("AS_RENDEZVOUS_CONTROL_SIZE");
+  try {
+    if (threshold_env != nullptr) {
+      threshold = std::stoull(threshold_env);
+    }
+    if (control_env != nullptr) {
+      control_size = std::stoull(control_env);
+    }
+  } catch (const std::exception& e) {
+    sys_panic("invalid AS_RENDEZVOUS_THRESHOLD or AS_RENDEZVOUS_CONTROL_SIZE");
+  }
+  if (control_size == 0) {
+    sys_panic("rendezvous control message size must be positive");
+  }
+  rendezvous_threshold = threshold;
+  rendezvous_control_size = control_size;
+}
+void Sys::report_protocol_stats() {
+  uint64_t rendezvous = rendezvous_messages.load();
+  if (rendezvous == 0) {
+    return;
+  }
+  std::cout << "Point-to-point messages: " << eager_messages.load()
+            << " eager, " << rendezvous << " rendezvous, "
+            << rendezvous_control_bytes.load() << " control bytes"
+            << std::endl;
+}
 Tick Sys::mem_read(uint64_t bytes) {
   if (MEM == nullptr) {
     return 10;
@@ -1352,29 +1451,42 @@ std::map<std::pair<int,int>, MockNccl::SingleFlow> Sys::generate_nvl_test_flow_m
   return result;
 }
 
+int Sys::mock_nccl_pp_size(int ngpus, int model_size){
+  int PP_size = workload->pipeline_model_parallelism;
+  if (PP_size <= 1 || ngpus % (model_size * PP_size) != 0)
+    return 1;
+  return PP_size;
+}
+
 bool Sys::mock_nccl_grobal_group_init(){
-  if (GlobalGroup != nullptr)
+  int first_rank = job == nullptr ? 0 : job->first_rank;
+  if (GlobalGroups.count(first_rank) != 0)
     return true;
   else {
-    int total_nodes = this->total_nodes;
+    int total_nodes = job == nullptr ? this->total_nodes : job->ranks;
     int TP_size = workload->model_parallel_npu_group == 0
         ? total_nodes
         : workload->model_parallel_npu_group;
-    int PP_size = 1;
-    int DP_size = all_gpus[0] / (TP_size * PP_size);
+    int CP_size = workload->context_parallel_npu_group;
+    int PP_size = mock_nccl_pp_size(all_gpus[0], TP_size * CP_size);
+    int DP_size = all_gpus[0] / (TP_size * CP_size * PP_size);
     int EP_size = workload->expert_parallel_npu_group;
     int DP_EP_size = DP_size / EP_size;
-    GlobalGroup = new MockNccl::MockNcclGroup(all_gpus[0],ngpus_per_node,TP_size,DP_size,PP_size,EP_size,DP_EP_size,NVSwitchs,gpu_type);
+    GlobalGroups[first_rank] = new MockNccl::MockNcclGroup(all_gpus[0],ngpus_per_node,TP_size,CP_size,DP_size,PP_size,EP_size,DP_EP_size,NVSwitchs,gpu_type,first_rank);
     return true;
   }
 }
 
 bool Sys::mock_nccl_comms_init(){
+    int total_nodes = job == nullptr ? this->total_nodes : job->ranks;
+    MockNccl::MockNcclGroup* GlobalGroup =
+        GlobalGroups[job == nullptr ? 0 : job->first_rank];
     int TP_size = workload->model_parallel_npu_group == 0
        ? total_nodes
        : workload->model_parallel_npu_group;
-    int PP_size = 1;
-    int DP_size = total_nodes / (TP_size * PP_size);
+    int CP_size = workload->context_parallel_npu_group;
+    int PP_size = mock_nccl_pp_size(total_nodes, TP_size * CP_size);
+    int DP_size = total_nodes / (TP_size * CP_size * PP_size);
     int EP_size = workload->expert_parallel_npu_group;
     int DP_EP_size = DP_size / EP_size;
     MockNccl::MockNcclComm* pComm;
@@ -1386,6 +1498,10 @@ bool Sys::mock_nccl_comms_init(){
       pComm = new MockNccl::MockNcclComm(id,MockNccl::GroupType::DP,GlobalGroup);
       mock_nccl_comms[DP] = pComm;
     }
+    if(PP_size > 1) {
+      pComm = new MockNccl::MockNcclComm(id,MockNccl::GroupType::PP,GlobalGroup);
+      mock_nccl_comms[PP] = pComm;
+    }
     if(EP_size > 1 ){
       pComm = new MockNccl::MockNcclComm(id,MockNccl::GroupType::EP,GlobalGroup);
       mock_nccl_comms[EP] = pComm;
@@ -1394,6 +1510,10 @@ bool Sys::mock_nccl_comms_init(){
       pComm = new MockNccl::MockNcclComm(id,MockNccl::GroupType::DP_EP,GlobalGroup);
       mock_nccl_comms[DP_EP] = pComm;
     }
+    if(CP_size > 1){
+      pComm = new MockNccl::MockNcclComm(id,MockNccl::GroupType::CP,GlobalGroup);
+      mock_nccl_comms[CP] = pComm;
+    }
     return true;
 }
 
@@ -1667,9 +1787,13 @@ DataSet* Sys::generate_collective(
   return dataset;
 }
 void Sys::call_events() {
+  MemoryAccounting::tick();
   if(event_queue.find(Sys::boostedTick())==event_queue.end()){
     goto FINISH_CHECK;
   }
+  if (Determinism::enabled()) {
+    call_events_in_key_order();
+  }
   for (auto& callable : event_queue[Sys::boostedTick()]) {
     try {
       pending_events--;
@@ -1681,22 +1805,65 @@ void Sys::call_events() {
   }
   {
   Sys::sysCriticalSection cs;
+  if (MemoryAccounting::enabled()) {
+    event_queue_bytes.sub(
+        EVENT_ENTRY_BYTES * event_queue[Sys::boostedTick()].size() +
+        EVENT_TICK_BYTES);
+  }
   if (event_queue[Sys::boostedTick()].size() > 0) {
     event_queue[Sys::boostedTick()].clear();
   }
   event_queue.erase(Sys::boostedTick());
   cs.ExitSection();
   }
-  FINISH_CHECK: if ((finished_workloads == 1 && event_queue.size() == 0 && pending_sends.size() == 0) ||
+  FINISH_CHECK: if ((finished_workloads == 1 && event_queue.size() == 0 && !send_channels->has_pending()) ||
       initialized == false) {
     delete this;
   }
 
 }
+// Runs the current tick's events sorted by their tie-break key. Events the
+// dispatched ones register for this same tick are sorted and run in a
+// following round; ties keep registration order.
+void Sys::call_events_in_key_order() {
+  Tick now = Sys::boostedTick();
+  while (true) {
+    std::list<std::tuple<Callable*, EventType, CallData*, uint64_t>> round;
+    {
+      #ifdef NS3_MTP
+      Sys::sysCriticalSection cs;
+      #endif
+      round.splice(round.end(), event_queue[now]);
+      for (auto& callable : round) {
+        fingerprint.record(now, std::get<3>(callable));
+      }
+      #ifdef NS3_MTP
+      cs.ExitSection();
+      #endif
+    }
+    if (round.empty()) {
+      return;
+    }
+    if (MemoryAccounting::enabled()) {
+      event_queue_bytes.sub(EVENT_ENTRY_BYTES * round.size());
+    }
+    round.sort([](const std::tuple<Callable*, EventType, CallData*, uint64_t>& a,
+                  const std::tuple<Callable*, EventType, CallData*, uint64_t>& b) {
+      return std::get<3>(a) < std::get<3>(b);
+    });
+    for (auto& callable : round) {
+      pending_events--;
+      Determinism::enter(std::get<3>(callable));
+      (std::get<0>(callable))
+          ->call(std::get<1>(callable), std::get<2>(callable));
+    }
+  }
+}
 void Sys::exitSimLoop(std::string msg) {
   if(id == 0 ){
   std::cout << msg << std::endl;
   }
+  TraceExporter::close();
   NI->sim_finish();
   return;
 }
@@ -1909,12 +2076,20 @@ void Sys::zero_latecy_register_event(
     Sys::sysCriticalSection cs;
     #endif
     if (event_queue.find(Sys::boostedTick() + mycycles) == event_queue.end()) {
-      std::list<std::tuple<Callable*, EventType, CallData*>> tmp;
+      std::list<std::tuple<Callable*, EventType, CallData*, uint64_t>> tmp;
       event_queue[Sys::boostedTick() + mycycles] = tmp;
       should_schedule = true;
     }
     event_queue[Sys::boostedTick() + mycycles].push_back(
-        std::make_tuple(callable, event, callData));
+        std::make_tuple(
+            callable,
+            event,
+            callData,
+            Determinism::enabled() ? Determinism::next_key() : 0));
+    if (MemoryAccounting::enabled()) {
+      event_queue_bytes.add(
+          EVENT_ENTRY_BYTES + (should_schedule ? EVENT_TICK_BYTES : 0));
+    }
     #ifdef NS3_MTP
     cs.ExitSection();
     #endif
@@ -1959,12 +2134,20 @@ void Sys::try_register_event(
         Sys::sysCriticalSection cs;
     #endif
     if (event_queue.find(Sys::boostedTick() + cycles) == event_queue.end()) {
-      std::list<std::tuple<Callable*, EventType, CallData*>> tmp;
+      std::list<std::tuple<Callable*, EventType, CallData*, uint64_t>> tmp;
       event_queue[Sys::boostedTick() + cycles] = tmp;
       should_schedule = true;
     }
     event_queue[Sys::boostedTick() + cycles].push_back(
-        std::make_tuple(callable, event, callData));
+        std::make_tuple(
+            callable,
+            event,
+            callData,
+            Determinism::enabled() ? Determinism::next_key() : 0));
+    if (MemoryAccounting::enabled()) {
+      event_queue_bytes.add(
+          EVENT_ENTRY_BYTES + (should_schedule ? EVENT_TICK_BYTES : 0));
+    }
     #ifdef NS3_MTP
     cs.ExitSection();
     #endif
@@ -2039,74 +2222,85 @@ void Sys::handleEvent(void* arg) {
     delete rrd;
   } else if (event == EventType::PacketReceived) {
     RecvPacketEventHadndlerData* rcehd = (RecvPacketEventHadndlerData*)ehd;
+    if (Determinism::enabled()) {
+      node->enter_message(Determinism::message_key(
+          event, rcehd->stream_num, node->id, rcehd->vnet, rcehd->flowTag));
+    }
     StreamBaseline* owner = static_cast<StreamBaseline*>(rcehd->owner);
     owner->consume(rcehd);
     delete rcehd;
   } else if (event == EventType::PacketSent) {
-    SendPacketEventHandlerData* sendhd = (SendPacketEventHandlerData*)ehd;
-    NcclLog->writeLog(NcclLogLevel::DEBUG,"packet sent, sender id:  %d, node id:  %d",sendhd->senderNodeId,node->id);
-    #ifdef NS3_MTP
-    Sys::sysCriticalSection cs;
-    #endif
-    #ifdef PHY_MTP
-    Sys::sysCriticalSection cs;
-    #endif
-    if(all_generators[sendhd->senderNodeId]== nullptr){
+    SendChannelTable::Descriptor* sent = static_cast<SendChannelTable::Descriptor*>(
+        (SendPacketEventHandlerData*)ehd);
+    NcclLog->writeLog(NcclLogLevel::DEBUG,"packet sent, sender id:  %d, node id:  %d",sent->senderNodeId,node->id);
+    if(all_generators[sent->senderNodeId]== nullptr){
+      SendChannelTable::release_orphan(sent);
+      return;
+    }
+    if (Determinism::enabled()) {
+      node->enter_message(Determinism::message_key(
+          event,
+          sent->senderNodeId,
+          sent->receiverNodeId,
+          sent->tag,
+          sent->request.flowTag));
+    }
+    SendChannelTable::Descriptor* next = node->send_channels->finish_send(sent);
+    if (next != nullptr) {
+      node->NI->sim_send(
+          next->buffer,
+          next->count,
+          next->type,
+          next->receiverNodeId,
+          next->tag,
+          &next->request,
+          next->msg_handler,
+          next);
+    } else if (node->finished_workloads == 1 || node->initialized == false) {
       #ifdef NS3_MTP
-      cs.ExitSection();
+      Sys::sysCriticalSection cs;
       #endif
       #ifdef PHY_MTP
-      cs.ExitSection();
+      Sys::sysCriticalSection cs;
       #endif
-      goto SEND_HANDLER_END;
-    }
-    
-    if (node->pending_sends.find(
-            std::make_pair(sendhd->receiverNodeId, sendhd->tag)) ==
-            node->pending_sends.end() ||
-            node->pending_sends[std::make_pair(sendhd->receiverNodeId, sendhd->tag)]
-                .size() == 0) {
-
-      node->is_there_pending_sends[std::make_pair(
-          sendhd->receiverNodeId, sendhd->tag)] = false;
-      
       if(node->event_queue.find(Sys::boostedTick())==node->event_queue.end())
-        if ((node->finished_workloads == 1 && node->event_queue.size() == 0 && node->pending_sends.size() == 0) ||
+        if ((node->finished_workloads == 1 && node->event_queue.size() == 0 && !node->send_channels->has_pending()) ||
       node->initialized == false) {
         delete node;
       }
-      #ifdef NS3_MTP  
+      #ifdef NS3_MTP
       cs.ExitSection();
       #endif
       #ifdef PHY_MTP
       cs.ExitSection();
       #endif
-    } else {
-
-      SimSendCaller* simSendCaller =
-          node->pending_sends[std::make_pair(sendhd->receiverNodeId, sendhd->tag)]
-                           .front();
-      node->pending_sends[std::make_pair(sendhd->receiverNodeId, sendhd->tag)]
-          .pop_front();
-      if(node->pending_sends[std::make_pair(sendhd->receiverNodeId, sendhd->tag)].size() == 0)
-        node->pending_sends.erase(std::make_pair(sendhd->receiverNodeId, sendhd->tag));
-
-      #ifdef NS3_MTP  
-      cs.ExitSection();
-      #endif
-      #ifdef PHY_MTP  
-      cs.ExitSection();
-      #endif
-      simSendCaller->call(EventType::General, nullptr);
     }
-    SEND_HANDLER_END: delete sendhd;
   }else if(event==EventType::PacketSentFinshed){
     AstraSim::SendPacketEventHandlerData* ehd = (AstraSim::SendPacketEventHandlerData*) arg;
+    if (Determinism::enabled()) {
+      node->enter_message(Determinism::message_key(
+          event,
+          ehd->senderNodeId,
+          ehd->receiverNodeId,
+          ehd->tag,
+          ehd->flowTag));
+    }
     if(ehd->owner!=nullptr)
       ehd->owner->sendcallback(ehd);
   }
 }
 
+void Sys::enter_message(uint64_t key) {
+  #ifdef NS3_MTP
+  Sys::sysCriticalSection cs;
+  #endif
+  fingerprint.record(Sys::boostedTick(), key);
+  #ifdef NS3_MTP
+  cs.ExitSection();
+  #endif
+  Determinism::enter(key);
+}
+
 AstraSim::timespec_t Sys::generate_time(int cycles) {
   timespec_t tmp = NI->sim_get_time();
   double addition = cycles * ((double)CLOCK_PERIOD);
@@ -23,6 +23,9 @@ LICENSE file in the root directory of this source tree.
 #include "Callable.hh"
 #include "CollectivePhase.hh"
 #include "Common.hh"
+#include "Determinism.hh"
+#include "JobManifest.hh"
+#include "MemoryAccounting.hh"
 #include "SendPacketEventHandlerData.hh"
 #include "UsageTracker.hh"
 #include "astra-sim/system/MockNcclChannel.h"
@@ -41,6 +44,7 @@ class StreamBaseline;
 class DataSet;
 class SimSendCaller;
 class SimRecvCaller;
+class SendChannelTable;
 class QueueLevels;
 class Workload;
 class LogicalTopology;
@@ -52,6 +56,7 @@ enum ParallelStrategy {
     PP,
     EP,
     DP_EP,
+    CP,
     NONE
 };
 class Sys : public Callable {
@@ -91,6 +96,12 @@ class Sys : public Callable {
   int npu_offset;
   int nvswitch_id; 
   int num_gpus;
+  // the job of a cluster manifest this node runs, nullptr for a single job
+  const ClusterJob* job;
+  // writes the workload reports: rank 0, or the leader of the job
+  bool leads_job() const {
+    return job == nullptr ? id == 0 : id + npu_offset == job->leader;
+  }
   std::vector<int>NVSwitchs; 
   int ngpus_per_node;
   GPUType gpu_type;
@@ -121,9 +132,23 @@ class Sys : public Callable {
 
   int priority_counter;
   bool boost_mode;
-  bool rendezvous_enabled;
   bool initialized;
 
+  // Point-to-point protocol selection. Messages of at least
+  // rendezvous_threshold bytes wait for a rendezvous_control_size byte
+  // clear-to-send from the receiver; smaller ones are sent eagerly.
+  // The control message carries the tag_id of the data flow offset by
+  // RENDEZVOUS_TAG_OFFSET, and a negative flow id of its own so the
+  // network does not merge it with other flows between the same nodes.
+  static const uint64_t RENDEZVOUS_DISABLED = UINT64_MAX;
+  static const int RENDEZVOUS_TAG_OFFSET = 500000000;
+  uint64_t rendezvous_threshold;
+  uint64_t rendezvous_control_size;
+  std::atomic<uint32_t> rendezvous_control_flows;
+  static std::atomic<uint64_t> eager_messages;
+  static std::atomic<uint64_t> rendezvous_messages;
+  static std::atomic<uint64_t> rendezvous_control_bytes;
+
   int processing_latency;
   int communication_delay;
 
@@ -153,8 +178,12 @@ class Sys : public Callable {
   std::vector<std::vector<std::string>> ata_ratio_data;
   QueueLevels* vLevels;
   std::map<std::string, LogicalTopology*> logical_topologies;
-  std::map<Tick, std::list<std::tuple<Callable*, EventType, CallData*>>>
+  // the last element is the tie-break key used in deterministic mode
+  std::map<
+      Tick,
+      std::list<std::tuple<Callable*, EventType, CallData*, uint64_t>>>
       event_queue;
+  Determinism::Fingerprint fingerprint;
   int total_nodes;
   static Tick offset;
   static std::vector<Sys*> all_generators;
@@ -212,6 +241,7 @@ class Sys : public Callable {
       CallData* callData,
       Tick& cycles);
   void call_events();
+  void call_events_in_key_order();
   void workload_finished() {
     finished_workloads++;
   };
@@ -222,8 +252,7 @@ class Sys : public Callable {
   void exitSimLoop(std::string msg);
   bool seprate_log;
 
-  std::map<std::pair<int, int>, std::list<SimSendCaller*>> pending_sends;
-  std::map<std::pair<int, int>, bool> is_there_pending_sends;
+  SendChannelTable* send_channels;
 
   Sys(AstraNetworkAPI* NI,
       AstraMemoryAPI* MEM,
@@ -242,7 +271,7 @@ class Sys : public Callable {
       std::string path,
       std::string run_name,
       bool seprate_log,
-      bool rendezvous_enabledstd,
+      bool rendezvous_enabled,
       GPUType _gpu_type,
       std::vector<int> _all_gpus,
       std::vector<int> _NVSwitchs,
@@ -256,6 +285,8 @@ class Sys : public Callable {
   std::vector<CollectiveImplementation*>
   generate_collective_implementation_from_input(std::string input);
   int break_dimension(int model_parallel_npu_group);
+  void set_rendezvous_protocol(uint64_t threshold, uint64_t control_size);
+  static void report_protocol_stats();
   int front_end_sim_send(
       Tick delay,
       void* buffer,
@@ -316,6 +347,7 @@ class Sys : public Callable {
       sim_request* request,
       void (*msg_handler)(void* fun_arg),
       void* fun_arg);
+  ncclFlowTag rendezvous_control_tag(int data_tag_id, int sender, int receiver);
   Tick mem_read(uint64_t bytes);
   Tick mem_write(uint64_t bytes);
   static int get_layer_numbers(std::string workload_input);
@@ -373,6 +405,7 @@ class Sys : public Callable {
   uint64_t determine_chunk_size(uint64_t size, ComType type);
   int get_priority(SchedulingPolicy pref_scheduling);
   static void handleEvent(void* arg);
+  void enter_message(uint64_t key);
   timespec_t generate_time(int cycles);
 
   class sysCriticalSection
@@ -403,6 +436,7 @@ class Sys : public Callable {
   struct MockNccl::ncclInfo* get_nccl_Info(ParallelStrategy comm_ps, uint64_t data_size, ComType collective_type);
   bool mock_nccl_comms_init();
   bool mock_nccl_grobal_group_init();
+  int mock_nccl_pp_size(int ngpus, int model_size);
 };
 } // namespace AstraSim
 #endif
@@ -0,0 +1,256 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "TraceExporter.hh"
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include "ExitReports.hh"
+
+namespace AstraSim {
+TraceExporter* TraceExporter::instance = nullptr;
+static std::once_flag trace_init;
+
+std::vector<std::pair<int, int>> TraceExporter::parse_ranks(
+    const char* spec,
+    const char* var) {
+  std::vector<std::pair<int, int>> ranks;
+  std::stringstream ss(spec);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (item.empty()) {
+      continue;
+    }
+    try {
+      size_t dash = item.find('-');
+      int lo = std::stoi(item.substr(0, dash));
+      int hi = dash == std::string::npos ? lo : std::stoi(item.substr(dash + 1));
+      if (lo < 0 || hi < lo) {
+        throw std::invalid_argument(item);
+      }
+      ranks.push_back(std::make_pair(lo, hi));
+    } catch (const std::exception& e) {
+      std::cerr << "Error: bad " << var << " entry: " << item << std::endl;
+      exit(1);
+    }
+  }
+  return ranks;
+}
+
+static void write_us(std::ofstream& out, Tick t) {
+  out << t / 1000 << '.' << (char)('0' + t / 100 % 10)
+      << (char)('0' + t / 10 % 10) << (char)('0' + t % 10);
+}
+
+static void write_name(std::ofstream& out, const std::string& name) {
+  out << '"';
+  for (char c : name) {
+    if (c == '"' || c == '\\') {
+      out << '\\';
+    }
+    out << c;
+  }
+  out << '"';
+}
+
+TraceExporter* TraceExporter::get() {
+  std::call_once(trace_init, [] {
+    const char* file = std::getenv("AS_TRACE");
+    if (file != nullptr && *file != '\0') {
+      instance = new TraceExporter(file);
+      ExitReports::add(TraceExporter::close);
+    }
+  });
+  return instance;
+}
+
+void TraceExporter::close() {
+  get();
+  delete instance;
+  instance = nullptr;
+}
+
+TraceExporter::TraceExporter(const std::string& file)
+    : out(file), flow_sample(0), flow_counter(0), stopping(false),
+      next_id(0), first_event(true) {
+  if (!out) {
+    std::cerr << "Error: unable to open trace file " << file << std::endl;
+    exit(1);
+  }
+  const char* ranks_env = std::getenv("AS_TRACE_RANKS");
+  if (ranks_env != nullptr) {
+    ranks = parse_ranks(ranks_env, "AS_TRACE_RANKS");
+  }
+  const char* flows_env = std::getenv("AS_TRACE_FLOWS");
+  if (flows_env != nullptr) {
+    flow_sample = std::strtoull(flows_env, nullptr, 10);
+  }
+  batch.reserve(BATCH);
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  writer = std::thread(&TraceExporter::writer_loop, this);
+}
+
+TraceExporter::~TraceExporter() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!batch.empty()) {
+      full.push_back(std::move(batch));
+    }
+    stopping = true;
+  }
+  cv.notify_one();
+  writer.join();
+  out << "]}" << std::endl;
+}
+
+bool TraceExporter::traced(int rank) const {
+  if (ranks.empty()) {
+    return true;
+  }
+  for (auto& range : ranks) {
+    if (rank >= range.first && rank <= range.second) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TraceExporter::sample_flow() {
+  return flow_sample != 0 && flow_counter++ % flow_sample == 0;
+}
+
+uint32_t TraceExporter::intern(const std::string& name) {
+  auto it = name_ids.find(name);
+  if (it != name_ids.end()) {
+    return it->second;
+  }
+  uint32_t id = names.size();
+  names.push_back(name);
+  name_ids[name] = id;
+  return id;
+}
+
+void TraceExporter::record(Record r, const std::string* name) {
+  std::lock_guard<std::mutex> lock(mtx);
+  if (name != nullptr) {
+    r.name = intern(*name);
+  }
+  batch.push_back(r);
+  if (batch.size() >= BATCH) {
+    full.push_back(std::move(batch));
+    batch = std::vector<Record>();
+    batch.reserve(BATCH);
+    cv.notify_one();
+  }
+}
+
+void TraceExporter::compute(
+    int rank,
+    const std::string& name,
+    Tick begin,
+    Tick end) {
+  record({Kind::Compute, rank, -1, -1, 0, begin, end, 0}, &name);
+}
+
+void TraceExporter::collective(
+    int rank,
+    const std::string& name,
+    Tick begin,
+    Tick end,
+    uint64_t bytes) {
+  record({Kind::Collective, rank, -1, -1, 0, begin, end, bytes}, &name);
+}
+
+void TraceExporter::flow(
+    int rank,
+    int channel_id,
+    int peer,
+    Tick begin,
+    Tick end,
+    uint64_t bytes) {
+  record({Kind::Flow, rank, channel_id, peer, 0, begin, end, bytes}, nullptr);
+}
+
+void TraceExporter::writer_loop() {
+  while (true) {
+    std::vector<Record> work;
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock, [this] { return stopping || !full.empty(); });
+      if (full.empty()) {
+        return;
+      }
+      work = std::move(full.front());
+      full.pop_front();
+      for (size_t i = writer_names.size(); i < names.size(); i++) {
+        writer_names.push_back(names[i]);
+      }
+    }
+    write_batch(work);
+  }
+}
+
+void TraceExporter::write_batch(const std::vector<Record>& records) {
+  for (const Record& r : records) {
+    if (r.rank >= (int)seen_ranks.size()) {
+      seen_ranks.resize(r.rank + 1, false);
+    }
+    if (!seen_ranks[r.rank]) {
+      seen_ranks[r.rank] = true;
+      out << (first_event ? "\n" : ",\n")
+          << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << r.rank
+          << ",\"args\":{\"name\":\"rank " << r.rank << "\"}},\n"
+          << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << r.rank
+          << ",\"tid\":0,\"args\":{\"name\":\"compute\"}}";
+      first_event = false;
+    }
+    out << (first_event ? "\n" : ",\n");
+    first_event = false;
+    if (r.kind == Kind::Compute) {
+      out << "{\"name\":";
+      write_name(out, writer_names[r.name]);
+      out << ",\"cat\":\"compute\",\"ph\":\"X\",\"pid\":" << r.rank
+          << ",\"tid\":0,\"ts\":";
+      write_us(out, r.begin);
+      out << ",\"dur\":";
+      write_us(out, r.end - r.begin);
+      out << "}";
+      continue;
+    }
+    // collectives and flows overlap freely, so they go on async tracks
+    uint64_t id = next_id++;
+    const char* cat = r.kind == Kind::Collective ? "collective" : "flow";
+    for (int end = 0; end < 2; end++) {
+      if (end) {
+        out << ",\n";
+      }
+      out << "{\"name\":";
+      if (r.kind == Kind::Collective) {
+        write_name(out, writer_names[r.name]);
+      } else {
+        out << "\"ch" << r.channel_id << " ->" << r.peer << "\"";
+      }
+      out << ",\"cat\":\"" << cat << "\",\"ph\":\"" << (end ? 'e' : 'b')
+          << "\",\"id\":" << id << ",\"pid\":" << r.rank << ",\"tid\":0"
+          << ",\"ts\":";
+      write_us(out, end ? r.end : r.begin);
+      if (!end) {
+        out << ",\"args\":{\"bytes\":" << r.bytes << "}";
+      }
+      out << "}";
+    }
+  }
+}
+} // namespace AstraSim
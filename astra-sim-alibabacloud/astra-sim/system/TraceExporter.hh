@@ -0,0 +1,115 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __TRACEEXPORTER_HH__
+#define __TRACEEXPORTER_HH__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Common.hh"
+
+namespace AstraSim {
+// Chrome trace-event timeline (loadable in chrome://tracing and Perfetto),
+// enabled by AS_TRACE=<file>. Every rank is a process with a compute track
+// (complete events from the Workload iterate paths), and async tracks for
+// collectives (DataSet creation to notify_stream_finished) and, with
+// AS_TRACE_FLOWS=<n>, one in n NcclTreeFlowModel flows. AS_TRACE_RANKS takes
+// a list such as "0-7,64" to keep large runs loadable.
+//
+// Recording only appends a fixed-size record to a batch under a short lock;
+// full batches are handed to a writer thread that formats and writes them.
+class TraceExporter {
+ public:
+  enum class Kind : uint8_t { Compute, Collective, Flow };
+
+  // nullptr unless AS_TRACE is set
+  static TraceExporter* get();
+  static void close();
+  // rank list such as "0-7,64" from the environment variable `var`; exits on
+  // a bad entry
+  static std::vector<std::pair<int, int>> parse_ranks(
+      const char* spec,
+      const char* var);
+
+  bool traced(int rank) const;
+  bool sample_flow();
+  void compute(int rank, const std::string& name, Tick begin, Tick end);
+  void collective(
+      int rank,
+      const std::string& name,
+      Tick begin,
+      Tick end,
+      uint64_t bytes);
+  void flow(
+      int rank,
+      int channel_id,
+      int peer,
+      Tick begin,
+      Tick end,
+      uint64_t bytes);
+
+ private:
+  struct Record {
+    Kind kind;
+    int rank;
+    int channel_id;
+    int peer;
+    uint32_t name;
+    Tick begin;
+    Tick end;
+    uint64_t bytes;
+  };
+  static const size_t BATCH = 16384;
+
+  TraceExporter(const std::string& file);
+  ~TraceExporter();
+  void record(Record r, const std::string* name);
+  uint32_t intern(const std::string& name);
+  void writer_loop();
+  void write_batch(const std::vector<Record>& batch);
+
+  std::ofstream out;
+  std::vector<std::pair<int, int>> ranks;
+  uint64_t flow_sample;
+  std::atomic<uint64_t> flow_counter;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::vector<Record> batch;
+  std::deque<std::vector<Record>> full;
+  std::vector<std::string> names;
+  std::unordered_map<std::string, uint32_t> name_ids;
+  bool stopping;
+  std::thread writer;
+
+  // owned by the writer thread
+  std::vector<std::string> writer_names;
+  std::vector<bool> seen_ranks;
+  uint64_t next_id;
+  bool first_event;
+
+  static TraceExporter* instance;
+};
+} // namespace AstraSim
+#endif
@@ -119,12 +119,12 @@ float calculateBusBw(CalculationParameters* params) {
     float all_gather_bus_bw = 0.0;
     
     int gpus_per_node = params->gpus_pernode;
-    int nics_per_node = params->nics_pernode;
+    float nics_per_node = params->nics_pernode;
     float real_nics_per_node = params->real_nics_pernode;
     int node_count = params->node_count;
     int nranks = node_count * gpus_per_node;
     params->is_nvlink = false; //nvlink or nic
-    if (nvlink_bw <= 0 || nic_bw <= 0 || gpus_per_node < 1 || nics_per_node < 1 || node_count < 1) {
+    if (nvlink_bw <= 0 || nic_bw <= 0 || gpus_per_node < 1 || nics_per_node <= 0 || node_count < 1) {
         return -1;
     }
 
@@ -22,7 +22,11 @@
 #include "NcclTreeFlowModel.hh"
 #include "astra-sim/system/PacketBundle.hh"
 #include "astra-sim/system/RecvPacketEventHadndlerData.hh"
+#include "astra-sim/system/MemoryAccounting.hh"
 #include "astra-sim/system/MockNcclLog.h"
+#include "astra-sim/system/RailTraffic.hh"
+#include "astra-sim/system/TraceExporter.hh"
+#include "astra-sim/workload/Layer.hh"
 #ifdef PHY_RDMA
 #include "astra-sim/system/SimAiFlowModelRdma.hh"
 extern FlowPhyRdma flow_rdma; 
@@ -31,6 +35,13 @@ extern FlowPhyRdma flow_rdma;
 
 namespace AstraSim {
 std::atomic<bool> NcclTreeFlowModel::g_flow_inCriticalSection(false);
+static MemoryAccounting::Counter flow_model_state_bytes("flow_model_state");
+
+NcclTreeFlowModel::~NcclTreeFlowModel() {
+  flow_model_state_bytes.sub(accounted_bytes);
+  delete critical_path;
+}
+
 NcclTreeFlowModel::NcclTreeFlowModel(
     ComType type,
     int id,
@@ -91,6 +102,8 @@ NcclTreeFlowModel::NcclTreeFlowModel(
         cs.ExitSection();
         assert(this->_flow_models.count(f.first) == 0);
         this->_flow_models[f.first] = f.second;
+        this->_flow_models[f.first].child_flow_handle =
+            FlowTagSlab::intern(f.second.child_flow_id);
         send_packets++;
       }
     }
@@ -117,6 +130,14 @@ NcclTreeFlowModel::NcclTreeFlowModel(
       break;
     default:;
   }
+  if (MemoryAccounting::enabled()) {
+    accounted_bytes = MockNccl::FlowModelsBytes(_flow_models) +
+        MemoryAccounting::node_bytes<std::pair<const std::pair<int, int>, int>>() *
+            (free_packets.size() + pQps->peer_qps.size()) +
+        MemoryAccounting::node_bytes<std::pair<const int, int>>() *
+            (indegree_mapping.size() + 2 * m_channels);
+    flow_model_state_bytes.add(accounted_bytes);
+  }
 }
 
 void NcclTreeFlowModel::init_indegree_mapping(){
@@ -127,6 +148,29 @@ void NcclTreeFlowModel::init_indegree_mapping(){
   }
 }
 
+void NcclTreeFlowModel::init_critical_path() {
+  std::vector<std::pair<int, int>> send_flows;
+  for (auto& f : _flow_models) {
+    if (f.second.src == id) {
+      send_flows.push_back(f.first);
+    }
+  }
+  Workload* workload = stream->owner->workload;
+  std::string layer_name = std::to_string(layer_num);
+  if (layer_num >= 0 && layer_num < workload->SIZE) {
+    layer_name = workload->layers[layer_num]->id;
+  }
+  critical_path = new CriticalPathRecorder(
+      stream->owner->id,
+      stream->stream_num,
+      layer_num,
+      layer_name,
+      comType,
+      workload->path,
+      send_flows);
+  critical_path->start(Sys::boostedTick());
+}
+
 int NcclTreeFlowModel::get_non_zero_latency_packets() {
   return (nodes_in_ring - 1) * parallel_reduce * 1;
 }
@@ -148,7 +192,17 @@ void NcclTreeFlowModel::run(EventType event, CallData* data) {
     AstraSim::ncclFlowTag flowTag = rcehd->flowTag;
     int received_flow_id = flowTag.current_flow_id;
     int channel_id = flowTag.channel_id;
-    std::vector<int> next_flow_list = flowTag.tree_flow_list;    
+    #ifdef PHY_MTP
+    // a tag received over RDMA has no handle into this process's slab
+    auto received = _flow_models.find(std::make_pair(channel_id, received_flow_id));
+    if (received != _flow_models.end()) {
+      flowTag.tree_flow_handle = received->second.child_flow_handle;
+    }
+    #endif
+    const std::vector<int>& next_flow_list = flowTag.tree_flow_list();    
+    if (critical_path != nullptr) {
+      critical_path->received(flowTag, Sys::boostedTick());
+    }
     #ifdef PHY_MTP
     recv_packets--;
     if(!phy_iteratable(channel_id)){
@@ -209,6 +263,10 @@ void NcclTreeFlowModel::run(EventType event, CallData* data) {
       if (--indegree_mapping[next_flow_id] == 0) {
         MockNccl::SingleFlow cur_flow = _flow_models[std::make_pair(channel_id, next_flow_id)];
           cs.ExitSection();
+          if (critical_path != nullptr) {
+            critical_path->ready_after_recv(
+                channel_id, next_flow_id, Sys::boostedTick(), flowTag);
+          }
           insert_packets(channel_id, next_flow_id);
       }else{
         cs.ExitSection();
@@ -231,6 +289,10 @@ void NcclTreeFlowModel::run(EventType event, CallData* data) {
     auto now_us = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
     NcclLog->writeLog(NcclLogLevel::DEBUG,"streamInit time %lld",now_us);
     start_time = std::chrono::high_resolution_clock::now();
+    #else
+    if (CriticalPathRecorder::enabled()) {
+      init_critical_path();
+    }
     #endif
     for (int i = 0; i < parallel_reduce; i++) {
       #ifndef PHY_MTP
@@ -251,6 +313,10 @@ void NcclTreeFlowModel::run(EventType event, CallData* data) {
                   flow_model.second.channel_id,
                   std::make_pair(
                       flow_model.second.src, flow_model.second.dest))] = 0;
+              if (critical_path != nullptr) {
+                critical_path->ready(
+                    j, flow_model.second.flow_id, Sys::boostedTick());
+              }
               insert_packets(j,flow_model.second.flow_id);
             } else {
               pQps->peer_wating_tasks[std::make_pair(
@@ -273,9 +339,23 @@ void NcclTreeFlowModel::run(EventType event, CallData* data) {
     AstraSim::ncclFlowTag flowTag = rcehd->flowTag;
     int sent_flow_id = flowTag.current_flow_id;
     int channel_id = flowTag.channel_id;
-    std::vector<int> next_flow_list = flowTag.tree_flow_list;   
+    const std::vector<int>& next_flow_list = flowTag.tree_flow_list();   
     NcclLog->writeLog(NcclLogLevel::DEBUG,"PacketSentFinshed src %d dst %d channel_id %d flow_id %d",flowTag.sender_node,flowTag.receiver_node,flowTag.channel_id,flowTag.current_flow_id);
     reduce(channel_id,sent_flow_id);
+    if (critical_path != nullptr) {
+      critical_path->finished(channel_id, sent_flow_id, Sys::boostedTick());
+    }
+    TraceExporter* trace = TraceExporter::get();
+    if (trace != nullptr && flowTag.issue_tick != 0 && trace->traced(id) &&
+        trace->sample_flow()) {
+      trace->flow(
+          id,
+          channel_id,
+          flowTag.receiver_node,
+          flowTag.issue_tick,
+          Sys::boostedTick(),
+          flowTag.flow_size);
+    }
     bool flow_exist = next_flow_list.size() == 0 ? true : false;
     #ifndef PHY_MTP
     NcclTreeFlowModel::FlowCriticalSection cs;
@@ -285,6 +365,10 @@ void NcclTreeFlowModel::run(EventType event, CallData* data) {
       int cur_flow_id = pQps->peer_wating_tasks[std::make_pair(flowTag.channel_id,std::make_pair(flowTag.sender_node,flowTag.receiver_node))].front();
       pQps->peer_wating_tasks[std::make_pair(flowTag.channel_id,std::make_pair(flowTag.sender_node,flowTag.receiver_node))].pop();
       pQps->peer_qps[std::make_pair(flowTag.channel_id,std::make_pair(flowTag.sender_node,flowTag.receiver_node))]=0;
+      if (critical_path != nullptr) {
+        critical_path->ready_after_send(
+            channel_id, cur_flow_id, Sys::boostedTick(), sent_flow_id);
+      }
       insert_packets(channel_id,cur_flow_id);
     }
     iteratable(channel_id); 
@@ -568,7 +652,7 @@ bool NcclTreeFlowModel::ready(int channel_id, int flow_id) {
   snd_req.vnet = this->stream->current_queue_id;
   snd_req.layerNum = layer_num;
   snd_req.reqCount = packet.msg_size;
-  MockNccl::SingleFlow flow_model =
+  const MockNccl::SingleFlow& flow_model =
       this->_flow_models[std::make_pair(channel_id, flow_id)];
   snd_req.flowTag.tag_id = layer_num * flow_model.chunk_count * m_channels +
       flow_model.channel_id * flow_model.chunk_count + flow_model.chunk_id;
@@ -577,8 +661,7 @@ bool NcclTreeFlowModel::ready(int channel_id, int flow_id) {
   snd_req.flowTag.current_flow_id = flow_id;
   snd_req.flowTag.chunk_id = flow_model.chunk_id;
   snd_req.flowTag.child_flow_id = -1;
-  snd_req.flowTag.tree_flow_list =
-      this->_flow_models[std::make_pair(channel_id, flow_id)].child_flow_id;
+  snd_req.flowTag.tree_flow_handle = flow_model.child_flow_handle;
   snd_req.flowTag.sender_node = id;
   snd_req.flowTag.receiver_node = packet.preferred_dest;
   snd_req.flowTag.pQps = this->pQps;
@@ -586,6 +669,24 @@ bool NcclTreeFlowModel::ready(int channel_id, int flow_id) {
     snd_req.flowTag.nvls_on = true;
   else
     snd_req.flowTag.nvls_on = false;
+  snd_req.flowTag.issue_tick = Sys::boostedTick();
+  if (critical_path != nullptr) {
+    critical_path->issued(
+        channel_id, flow_id, Sys::boostedTick(), snd_req.flowTag);
+  }
+  if (RailTraffic::enabled() && !snd_req.flowTag.nvls_on) {
+    const std::vector<int>& nvswitchs = stream->owner->NVSwitchs;
+    if (std::find(nvswitchs.begin(), nvswitchs.end(), packet.preferred_dest) ==
+        nvswitchs.end()) {
+      RailTraffic::sent(
+          id,
+          packet.preferred_dest,
+          channel_id,
+          snd_req.reqCount,
+          stream->owner->ngpus_per_node,
+          stream->owner->workload->path);
+    }
+  }
   SendPacketEventHandlerData* send_ehd = new SendPacketEventHandlerData(
       stream,
       id,
@@ -627,6 +728,9 @@ void NcclTreeFlowModel::exit() {
   if(packet.second.size() != 0)
     packet.second.clear();
   }
+  if (critical_path != nullptr) {
+    critical_path->finish(Sys::boostedTick(), stream->owner->NI);
+  }
   #endif
   stream->owner->proceed_to_next_vnet_baseline((StreamBaseline*)stream);
   NcclLog->writeLog(NcclLogLevel::DEBUG,"NcclTreeFlowModel exit");
@@ -700,7 +804,7 @@ bool NcclTreeFlowModel::phy_ready(int channel_id,int flow_id) {
   snd_req.vnet = this->stream->current_queue_id;
   snd_req.layerNum = layer_num;
   snd_req.reqCount = flow.flow_size;
-  MockNccl::SingleFlow flow_model =
+  const MockNccl::SingleFlow& flow_model =
       this->_flow_models[std::make_pair(channel_id, flow_id)];
   snd_req.flowTag.tag_id = layer_num * flow_model.chunk_count * m_channels +
       flow_model.channel_id * flow_model.chunk_count + flow_model.chunk_id;
@@ -709,8 +813,7 @@ bool NcclTreeFlowModel::phy_ready(int channel_id,int flow_id) {
   snd_req.flowTag.current_flow_id = flow_id;
   snd_req.flowTag.chunk_id = flow_model.chunk_id;
   snd_req.flowTag.child_flow_id = -1;
-  snd_req.flowTag.tree_flow_list =
-      this->_flow_models[std::make_pair(channel_id, flow_id)].child_flow_id;
+  snd_req.flowTag.tree_flow_handle = flow_model.child_flow_handle;
   snd_req.flowTag.sender_node = id;
   snd_req.flowTag.receiver_node = flow.dest;
   snd_req.flowTag.pQps = this->pQps;
@@ -36,6 +36,7 @@
 #include "astra-sim/system/MyPacket.hh"
 #include "astra-sim/system/topology/RingTopology.hh"
 #include  "astra-sim/system/MockNcclQps.h"
+#include "astra-sim/system/CriticalPath.hh"
 
 namespace AstraSim {
 class NcclTreeFlowModel : public Algorithm {
@@ -68,8 +69,11 @@ class NcclTreeFlowModel : public Algorithm {
   std::mutex judge_exit_mutex;
   std::mutex judge_mutex;
   std::atomic<bool> judge_exit_flag;
+  CriticalPathRecorder* critical_path = nullptr;
+  // bytes of this phase's flow state reported to MemoryAccounting
+  int64_t accounted_bytes = 0;
   NcclTreeFlowModel(){};
-  ~NcclTreeFlowModel(){};
+  ~NcclTreeFlowModel();
 
   NcclTreeFlowModel(
       ComType type,
@@ -90,6 +94,7 @@ class NcclTreeFlowModel : public Algorithm {
   virtual int get_non_zero_latency_packets();
   void insert_packets(int channel_id, int flow_id);
   void init_indegree_mapping();
+  void init_critical_path();
   bool ready(int channel_id, int flow_id);
   bool recv_ready(int channel_id, int flow_id);
   bool init_recv_ready();
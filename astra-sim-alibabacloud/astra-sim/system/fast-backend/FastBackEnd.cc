@@ -14,6 +14,7 @@
 */
 
 #include "FastBackEnd.hh"
+#include "astra-sim/system/Determinism.hh"
 namespace AstraSim {
 WrapperData::WrapperData(
     WrapperData::Type type,
@@ -235,8 +236,13 @@ void FastBackEnd::handleEvent(void* arg) {
   }
 }
 
+bool FastBackEnd::relay_predictable() {
+  uint64_t sample = Determinism::enabled() ? relay_sampler() : rand();
+  return (sample % 100) < 10;
+}
+
 FastBackEnd::FastBackEnd(int rank, AstraNetworkAPI* wrapped_backend)
-    : AstraNetworkAPI(rank) {
+    : AstraNetworkAPI(rank), relay_sampler(Determinism::stream(rank)) {
   this->wrapped_backend = wrapped_backend;
 }
 
@@ -433,7 +439,7 @@ int FastBackEnd::sim_send(
   if (dynamicLatencyTable.canPredictLatency(srcDestPair)) {
     // prediction available
     // for 10%, don't use prediction and relay the request.
-    if ((rand() % 100) < 10) {
+    if (relay_predictable()) {
       inflightPairsMap.insert(
           src, dst, tag, count, WrapperData::Type::DetailedSend);
       return relay_send_request(
@@ -516,7 +522,7 @@ int FastBackEnd::sim_recv(
   if (dynamicLatencyTable.canPredictLatency(srcDestPair)) {
     // prediction available
     // for 10%, don't use prediction and relay the request.
-    if ((rand() % 100) < 10) {
+    if (relay_predictable()) {
       inflightPairsMap.insert(
           src, dst, tag, count, WrapperData::Type::DetailedRecv);
       return relay_recv_request(
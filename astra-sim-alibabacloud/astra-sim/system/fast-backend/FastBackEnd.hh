@@ -19,6 +19,7 @@
 #include <cassert>
 #include <iostream>
 #include <map>
+#include <random>
 #include <tuple>
 
 #include "astra-sim/system/AstraNetworkAPI.hh"
@@ -157,6 +158,10 @@ class DynamicLatencyTable {
 class FastBackEnd : public AstraNetworkAPI {
  public:
   AstraNetworkAPI* wrapped_backend;
+  // decides which predictable requests are still relayed under
+  // AS_DETERMINISTIC, seeded per rank; rand() otherwise
+  std::mt19937_64 relay_sampler;
+  bool relay_predictable();
   static void handleEvent(void* arg);
   int sim_comm_size(sim_comm comm, int* size);
   // int sim_comm_get_rank();
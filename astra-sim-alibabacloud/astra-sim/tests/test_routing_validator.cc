@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+#include "routing-validator.h"
+
+#include <vector>
+
+// Hand-built tables in the compact form produced by CalculateRoutes:
+// route_entries[dst] holds (node, ecmp group) pairs and node type 0 is a host.
+class RoutingValidatorTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        node_type.clear();
+        route_entries.clear();
+        groups.clear();
+    }
+
+    uint32_t AddGroup(std::vector<uint32_t> nexts)
+    {
+        EcmpGroup group;
+        group.node = 0;
+        group.nexts = nexts;
+        group.ifaces.assign(nexts.size(), 0);
+        groups.push_back(group);
+        return groups.size() - 1;
+    }
+
+    void AddEntry(uint32_t dst, uint32_t node, std::vector<uint32_t> nexts)
+    {
+        if (route_entries.size() <= dst)
+            route_entries.resize(dst + 1);
+        route_entries[dst].push_back(std::make_pair(node, AddGroup(nexts)));
+    }
+
+    // hosts 0..3, leaves 4 and 5, spines 6 and 7; hosts 0,1 on leaf 4 and 2,3 on leaf 5
+    void BuildLeafSpine()
+    {
+        node_type = {0, 0, 0, 0, 1, 1, 1, 1};
+        for (uint32_t dst = 0; dst < 4; dst++)
+        {
+            uint32_t dst_leaf = dst < 2 ? 4 : 5;
+            uint32_t other_leaf = dst < 2 ? 5 : 4;
+            for (uint32_t src = 0; src < 4; src++)
+            {
+                if (src != dst)
+                    AddEntry(dst, src, {src < 2 ? 4u : 5u});
+            }
+            AddEntry(dst, dst_leaf, {dst});
+            AddEntry(dst, other_leaf, {6, 7});
+            AddEntry(dst, 6, {dst_leaf});
+            AddEntry(dst, 7, {dst_leaf});
+        }
+    }
+
+    std::vector<uint32_t> node_type;
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> route_entries;
+    std::vector<EcmpGroup> groups;
+};
+
+TEST_F(RoutingValidatorTest, AcceptsLeafSpine)
+{
+    BuildLeafSpine();
+    RoutingReport report = ValidateRoutingTables(node_type, route_entries, groups);
+    EXPECT_TRUE(report.ok());
+    EXPECT_EQ(report.pairs, 12u);
+    EXPECT_EQ(report.reachable, 12u);
+    EXPECT_EQ(report.unequal_cost, 0u);
+    EXPECT_TRUE(report.asymmetry_checked);
+    EXPECT_EQ(report.asymmetric, 0u);
+    // 4 same-leaf pairs at 2 hops, 8 cross-leaf pairs at 4 hops
+    ASSERT_EQ(report.path_len_hist.size(), 5u);
+    EXPECT_EQ(report.path_len_hist[2], 4u);
+    EXPECT_EQ(report.path_len_hist[4], 8u);
+    // per destination: two width-1 spine entries, one width-1 leaf entry, one width-2 leaf entry
+    ASSERT_EQ(report.ecmp_width_hist.size(), 3u);
+    EXPECT_EQ(report.ecmp_width_hist[1], 12u);
+    EXPECT_EQ(report.ecmp_width_hist[2], 4u);
+}
+
+TEST_F(RoutingValidatorTest, DetectsMissingSourceRoute)
+{
+    node_type = {0, 0, 1};
+    AddEntry(1, 0, {2});
+    AddEntry(1, 2, {1});
+    RoutingReport report = ValidateRoutingTables(node_type, route_entries, groups);
+    EXPECT_FALSE(report.ok());
+    EXPECT_EQ(report.reachable, 1u);
+    EXPECT_EQ(report.unreachable, 1u);
+    ASSERT_EQ(report.failed_pairs.size(), 1u);
+    EXPECT_EQ(report.failed_pairs[0], std::make_pair(1u, 0u));
+}
+
+TEST_F(RoutingValidatorTest, DetectsBlackHole)
+{
+    BuildLeafSpine();
+    // spine 7 loses its entry toward host 0; cross-leaf sources still reach it over ECMP
+    auto &entries = route_entries[0];
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (entries[i].first == 7)
+        {
+            entries.erase(entries.begin() + i);
+            break;
+        }
+    }
+    RoutingReport report = ValidateRoutingTables(node_type, route_entries, groups);
+    EXPECT_FALSE(report.ok());
+    EXPECT_EQ(report.black_holes, 2u);
+    EXPECT_EQ(report.loops, 0u);
+}
+
+TEST_F(RoutingValidatorTest, DetectsLoop)
+{
+    node_type = {0, 0, 1, 1};
+    // toward host 1, switches 2 and 3 point at each other
+    AddEntry(1, 0, {2});
+    AddEntry(1, 2, {3});
+    AddEntry(1, 3, {2});
+    AddEntry(0, 1, {3});
+    AddEntry(0, 3, {2});
+    AddEntry(0, 2, {0});
+    RoutingReport report = ValidateRoutingTables(node_type, route_entries, groups);
+    EXPECT_FALSE(report.ok());
+    EXPECT_EQ(report.loops, 1u);
+    EXPECT_EQ(report.reachable, 1u);
+}
+
+TEST_F(RoutingValidatorTest, ReportsUnequalCostPaths)
+{
+    node_type = {0, 0, 1, 1};
+    // 0 -> 1 either direct via switch 2 or detouring through switch 3
+    AddEntry(1, 0, {2});
+    AddEntry(1, 2, {1, 3});
+    AddEntry(1, 3, {1});
+    AddEntry(0, 1, {3});
+    AddEntry(0, 3, {0});
+    RoutingReport report = ValidateRoutingTables(node_type, route_entries, groups);
+    EXPECT_TRUE(report.ok());
+    EXPECT_EQ(report.unequal_cost, 1u);
+}
+
+TEST_F(RoutingValidatorTest, ReportsAsymmetricPaths)
+{
+    node_type = {0, 0, 1, 1};
+    // 0 -> 2 -> 3 -> 1 is three hops, 1 -> 3 -> 0 is two
+    AddEntry(1, 0, {2});
+    AddEntry(1, 2, {3});
+    AddEntry(1, 3, {1});
+    AddEntry(0, 1, {3});
+    AddEntry(0, 3, {0});
+    RoutingReport report = ValidateRoutingTables(node_type, route_entries, groups);
+    EXPECT_TRUE(report.ok());
+    EXPECT_EQ(report.unequal_cost, 0u);
+    EXPECT_EQ(report.asymmetric, 1u);
+}
@@ -0,0 +1,323 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "CollectiveBench.hh"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "Layer.hh"
+#include "Workload.hh"
+#include "astra-sim/system/AstraParamParse.hh"
+#include "astra-sim/system/RankLayout.hh"
+
+namespace AstraSim {
+const std::string CollectiveBench::prefix = "bench:";
+
+static bool parse_bytes(const std::string& s, uint64_t& bytes) {
+  if (s.empty()) {
+    return false;
+  }
+  size_t pos = 0;
+  double value;
+  try {
+    value = std::stod(s, &pos);
+  } catch (const std::exception&) {
+    return false;
+  }
+  uint64_t scale = 1;
+  std::string unit = s.substr(pos);
+  if (unit == "K" || unit == "k") {
+    scale = 1ULL << 10;
+  } else if (unit == "M" || unit == "m") {
+    scale = 1ULL << 20;
+  } else if (unit == "G" || unit == "g") {
+    scale = 1ULL << 30;
+  } else if (!unit.empty() && unit != "B" && unit != "b") {
+    return false;
+  }
+  if (value <= 0) {
+    return false;
+  }
+  bytes = (uint64_t)(value * scale);
+  return true;
+}
+
+// workload comm type and the nccl-tests bus bandwidth correction factor
+static bool op_info(const std::string& op, std::string& type) {
+  if (op == "allreduce") {
+    type = "ALLREDUCE";
+  } else if (op == "allgather") {
+    type = "ALLGATHER";
+  } else if (op == "reducescatter") {
+    type = "REDUCESCATTER";
+  } else if (op == "alltoall" || op == "sendrecv") {
+    type = "ALLTOALL";
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static double busbw_factor(const std::string& op, int nranks) {
+  if (op == "sendrecv" || nranks <= 1) {
+    return 1.0;
+  }
+  double n = nranks;
+  if (op == "allreduce") {
+    return 2.0 * (n - 1) / n;
+  }
+  return (n - 1) / n;
+}
+
+// Without the hardware flags the analytical busbw lookup fails and the comm
+// times come out negative, wrapped around to huge ticks.
+static void check_row(
+    const std::string& op,
+    uint64_t size,
+    int nranks,
+    bool valid) {
+  if (valid) {
+    return;
+  }
+  std::cerr << "bench " << op << " of " << size << " B over " << nranks
+            << " ranks has no valid time; pass the hardware with -g_type, "
+            << "-nv and -nic" << std::endl;
+  exit(1);
+}
+
+bool CollectiveBench::is_bench(const std::string& workload) {
+  return workload.compare(0, prefix.size(), prefix) == 0;
+}
+
+bool CollectiveBench::parse(
+    const std::string& workload,
+    BenchSpec& spec,
+    std::string& err) {
+  std::string body =
+      is_bench(workload) ? workload.substr(prefix.size()) : workload;
+  std::stringstream ss(body);
+  std::string item;
+  bool first = true;
+  while (std::getline(ss, item, ',')) {
+    if (first) {
+      spec.op = item;
+      first = false;
+      continue;
+    }
+    size_t eq = item.find('=');
+    if (eq == std::string::npos) {
+      err = "expected key=value, got: " + item;
+      return false;
+    }
+    std::string key = item.substr(0, eq);
+    std::string value = item.substr(eq + 1);
+    bool ok = true;
+    try {
+      if (key == "min") {
+        ok = parse_bytes(value, spec.min_bytes);
+      } else if (key == "max") {
+        ok = parse_bytes(value, spec.max_bytes);
+      } else if (key == "factor") {
+        spec.factor = std::stoull(value);
+      } else if (key == "group") {
+        spec.group = value;
+      } else if (key == "ranks") {
+        spec.ranks = std::stoi(value);
+      } else if (key == "iters") {
+        spec.iters = std::stoi(value);
+      } else {
+        err = "unknown bench option: " + key;
+        return false;
+      }
+    } catch (const std::exception&) {
+      ok = false;
+    }
+    if (!ok) {
+      err = "bad value for " + key + ": " + value;
+      return false;
+    }
+  }
+  std::string type;
+  if (!op_info(spec.op, type)) {
+    err = "unknown bench op: " + spec.op +
+        " (allreduce, allgather, reducescatter, alltoall, sendrecv)";
+    return false;
+  }
+  if (spec.group != "tp" && spec.group != "dp" && spec.group != "ep") {
+    err = "unknown bench group: " + spec.group + " (tp, dp, ep)";
+    return false;
+  }
+  if (spec.min_bytes > spec.max_bytes) {
+    err = "bench min size is larger than max size";
+    return false;
+  }
+  if (spec.factor < 2 || spec.iters < 1 || spec.ranks < 0) {
+    err = "bench factor must be >= 2, iters >= 1 and ranks >= 0";
+    return false;
+  }
+  if (spec.op == "sendrecv" && spec.ranks != 0 && spec.ranks != 2) {
+    err = "sendrecv runs between 2 ranks";
+    return false;
+  }
+  return true;
+}
+
+bool CollectiveBench::synthesize(
+    const std::string& workload,
+    int all_gpus,
+    std::string& text,
+    std::string& err) {
+  BenchSpec spec;
+  if (!parse(workload, spec, err)) {
+    return false;
+  }
+  std::string type;
+  op_info(spec.op, type);
+  int ranks = spec.ranks;
+  if (ranks == 0) {
+    ranks = spec.op == "sendrecv" ? 2 : all_gpus;
+  }
+  if (all_gpus <= 0 || ranks > all_gpus || all_gpus % ranks != 0) {
+    err = "bench group of " + std::to_string(ranks) +
+        " ranks does not divide " + std::to_string(all_gpus) + " GPUs";
+    return false;
+  }
+  // The group type follows the workload comm type suffix: plain types in the
+  // forward slot are TP, _EP is EP, and _DP_EP with ep 1 spans the DP group.
+  int tp = 1, ep = 1;
+  if (spec.group == "tp") {
+    tp = ranks;
+  } else if (spec.group == "dp") {
+    tp = all_gpus / ranks;
+    type += "_DP_EP";
+    // without a rank layout the analytical model takes every rank of a DP
+    // group for a server of its own
+    UserParam* param = UserParam::getInstance();
+    uint32_t gpus_per_server = param->net_work_param.gpus_per_server;
+    if (param->mode == ModeType::ANALYTICAL && !RankLayout::configured() &&
+        ranks > 1 && tp < (int)gpus_per_server) {
+      err = "group=dp puts " + std::to_string(gpus_per_server / tp) +
+          " of its " + std::to_string(ranks) +
+          " ranks on a server, which is priced only with AS_RANK_ORDER set";
+      return false;
+    }
+  } else {
+    ep = ranks;
+    type += "_EP";
+  }
+  // sendrecv is modelled as an alltoall between two ranks, where each rank
+  // sends half of the buffer to its peer.
+  uint64_t scale = spec.op == "sendrecv" ? 2 : 1;
+
+  std::vector<uint64_t> sizes;
+  for (uint64_t s = spec.min_bytes; s <= spec.max_bytes; s *= spec.factor) {
+    sizes.push_back(s);
+    if (s > spec.max_bytes / spec.factor) {
+      break;
+    }
+  }
+  std::ostringstream out;
+  out << "HYBRID_TRANSFORMER_FWD_IN_BCKWD model_parallel_NPU_group: " << tp
+      << " ep: " << ep << " pp: 1 vpp: 1 ga: 1 all_gpus: " << all_gpus
+      << " checkpoints: 0 checkpoint_initiates: 0\n";
+  out << sizes.size() * spec.iters << "\n";
+  for (uint64_t s : sizes) {
+    for (int it = 0; it < spec.iters; it++) {
+      out << "bench_" << s << "_" << it << "\t-1\t0\t" << type << "\t"
+          << s * scale << "\t0\tNONE\t0\t0\tNONE\t0\t0\n";
+    }
+  }
+  text = out.str();
+  return true;
+}
+
+void CollectiveBench::report(Workload* workload) {
+  BenchSpec spec;
+  std::string err;
+  if (!parse(workload->bench_spec, spec, err)) {
+    return;
+  }
+  UserParam* param = UserParam::getInstance();
+  int TP_size = workload->model_parallel_npu_group;
+  int EP_size = workload->expert_parallel_npu_group;
+  int DP_size = workload->all_gpus / (TP_size * workload->context_parallel_npu_group * workload->pipeline_model_parallelism);
+  int passes = param->mode == ModeType::ANALYTICAL ? 1 : workload->TOTAL_PASS;
+  uint64_t scale = spec.op == "sendrecv" ? 2 : 1;
+
+  struct Row {
+    uint64_t size;
+    double time_us;
+    int nranks;
+  };
+  std::vector<Row> rows;
+  for (int i = 0; i < workload->SIZE; i++) {
+    Layer* layer = workload->layers[i];
+    uint64_t size = layer->fwd_pass_comm_size / scale;
+    int nranks =
+        layer->fwd_pass_group_type == MockNccl::GroupType::EP ? EP_size
+        : layer->fwd_pass_group_type == MockNccl::GroupType::CP
+        ? workload->context_parallel_npu_group
+        : layer->fwd_pass_group_type == MockNccl::GroupType::DP_EP
+        ? DP_size / EP_size
+        : TP_size;
+    check_row(
+        spec.op,
+        size,
+        nranks,
+        layer->total_fwd_comm > 0 && layer->total_fwd_comm <= (Tick)INT64_MAX);
+    double time_us = (double)layer->total_fwd_comm / FREQ / passes;
+    if (!rows.empty() && rows.back().size == size) {
+      rows.back().time_us += time_us;
+    } else {
+      rows.push_back({size, time_us, nranks});
+    }
+  }
+
+  std::ofstream csv(workload->path + "busbw.csv", std::ios::out | std::ios::trunc);
+  csv << "size(B),count,ranks,time(us),algbw(GB/s),busbw(GB/s)" << std::endl;
+  char line[160];
+  std::cout << "# SimAI collective bench: " << spec.op << " group " << spec.group
+            << ", " << workload->all_gpus << " GPUs" << std::endl;
+  std::cout << "#" << std::endl;
+  std::snprintf(line, sizeof(line), "# %12s %12s %6s %12s %9s %9s", "size",
+                "count", "ranks", "time", "algbw", "busbw");
+  std::cout << line << std::endl;
+  std::snprintf(line, sizeof(line), "# %12s %12s %6s %12s %9s %9s", "(B)",
+                "(elements)", "", "(us)", "(GB/s)", "(GB/s)");
+  std::cout << line << std::endl;
+  double busbw_sum = 0;
+  for (auto& row : rows) {
+    double time_us = row.time_us / spec.iters;
+    // GB/s as nccl-tests reports it: bytes / 1e9 / seconds
+    double algbw = time_us > 0 ? row.size / time_us / 1e3 : 0;
+    double busbw = algbw * busbw_factor(spec.op, row.nranks);
+    check_row(spec.op, row.size, row.nranks, time_us > 0 && busbw > 0);
+    busbw_sum += busbw;
+    uint64_t count = row.size / 4; // float elements, as nccl-tests defaults
+    std::snprintf(line, sizeof(line), "  %12llu %12llu %6d %12.2f %9.2f %9.2f",
+                  (unsigned long long)row.size, (unsigned long long)count,
+                  row.nranks, time_us, algbw, busbw);
+    std::cout << line << std::endl;
+    csv << row.size << "," << count << "," << row.nranks << "," << time_us
+        << "," << algbw << "," << busbw << std::endl;
+  }
+  std::cout << "# Avg bus bandwidth    : "
+            << (rows.empty() ? 0 : busbw_sum / rows.size()) << std::endl;
+}
+} // namespace AstraSim
@@ -0,0 +1,55 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __COLLECTIVEBENCH_HH__
+#define __COLLECTIVEBENCH_HH__
+
+#include <cstdint>
+#include <string>
+
+namespace AstraSim {
+class Workload;
+
+// nccl-tests style sweep of one collective, given on the command line as
+//   <op>[,min=1M][,max=1G][,factor=2][,group=tp|dp|ep][,ranks=N][,iters=1]
+// and carried to the workload as "bench:<spec>". The sweep is turned into an
+// ordinary HYBRID_TRANSFORMER_FWD_IN_BCKWD workload (one layer per size and
+// iteration, collective in the blocking forward slot) so every backend runs
+// it unchanged.
+struct BenchSpec {
+  std::string op = "allreduce";
+  uint64_t min_bytes = 1ULL << 20;
+  uint64_t max_bytes = 1ULL << 30;
+  uint64_t factor = 2;
+  std::string group = "tp";
+  int ranks = 0; // 0 = whole cluster for tp/dp, 2 for sendrecv
+  int iters = 1;
+};
+
+class CollectiveBench {
+ public:
+  static const std::string prefix;
+  static bool is_bench(const std::string& workload);
+  static bool parse(const std::string& workload, BenchSpec& spec, std::string& err);
+  static bool synthesize(
+      const std::string& workload,
+      int all_gpus,
+      std::string& text,
+      std::string& err);
+  // Prints the busbw-vs-size table and writes it to <path>busbw.csv.
+  static void report(Workload* workload);
+};
+} // namespace AstraSim
+#endif
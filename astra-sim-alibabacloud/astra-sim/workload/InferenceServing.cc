@@ -0,0 +1,612 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "InferenceServing.hh"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include "Layer.hh"
+#include "Workload.hh"
+#include "astra-sim/system/AstraNetworkAPI.hh"
+#include "astra-sim/system/AstraParamParse.hh"
+#include "astra-sim/system/OverlapTimeline.hh"
+#include "astra-sim/system/TraceExporter.hh"
+
+namespace AstraSim {
+// decode ranks with nothing to run look for finished prefills this often
+static const Tick decode_poll = 10 * FREQ;
+
+static bool parse_range(const std::string& s, int& lo, int& hi) {
+  size_t dash = s.find('-');
+  try {
+    lo = std::stoi(s.substr(0, dash));
+    hi = dash == std::string::npos ? lo : std::stoi(s.substr(dash + 1));
+  } catch (const std::exception&) {
+    return false;
+  }
+  return lo >= 1 && lo <= hi;
+}
+
+bool InferenceServing::parse_header(
+    const std::vector<std::string>& tokens,
+    ServingSpec& spec,
+    std::string& err) {
+  for (size_t i = 1; i + 1 < tokens.size(); i++) {
+    const std::string& key = tokens[i];
+    const std::string& value = tokens[i + 1];
+    try {
+      if (key == "tokens:") {
+        spec.ref_tokens = std::stoi(value);
+      } else if (key == "requests:") {
+        spec.requests = std::stoi(value);
+      } else if (key == "rate:") {
+        spec.rate = std::stod(value);
+      } else if (key == "trace:") {
+        spec.trace = value;
+      } else if (key == "prompt:") {
+        if (!parse_range(value, spec.prompt_min, spec.prompt_max)) {
+          err = "bad prompt range " + value;
+          return false;
+        }
+      } else if (key == "output:") {
+        if (!parse_range(value, spec.output_min, spec.output_max)) {
+          err = "bad output range " + value;
+          return false;
+        }
+      } else if (key == "max_batch:") {
+        spec.max_batch = std::stoi(value);
+      } else if (key == "max_prefill_tokens:") {
+        spec.max_prefill_tokens = std::stoi(value);
+      } else if (key == "weight_bound_tokens:") {
+        spec.weight_bound_tokens = std::stoi(value);
+      } else if (key == "seed:") {
+        spec.seed = std::stoull(value);
+      } else if (key == "prefill_ranks:") {
+        spec.prefill_ranks = std::stoi(value);
+      } else if (key == "kv_bytes_per_token:") {
+        spec.kv_bytes_per_token = std::stoull(value);
+      } else if (key == "ttft_slo_ms:") {
+        spec.ttft_slo_ms = std::stod(value);
+      } else if (key == "tpot_slo_ms:") {
+        spec.tpot_slo_ms = std::stod(value);
+      }
+    } catch (const std::exception&) {
+      err = "bad value for " + key + " " + value;
+      return false;
+    }
+  }
+  if (spec.ref_tokens <= 0) {
+    err = "tokens: must give the token count of the layer table";
+    return false;
+  }
+  if (spec.trace.empty() && (spec.requests <= 0 || spec.rate <= 0)) {
+    err = "requests: and rate: must be positive";
+    return false;
+  }
+  if (spec.max_batch <= 0 || spec.max_prefill_tokens <= 0 ||
+      spec.weight_bound_tokens < 0 || spec.prefill_ranks < 0) {
+    err = "batch limits must be positive";
+    return false;
+  }
+  return true;
+}
+
+InferenceServing* InferenceServing::join(
+    Workload* workload,
+    const ServingSpec& spec) {
+  static std::mutex registry_lock;
+  static std::map<int, InferenceServing*> registry;
+  std::lock_guard<std::mutex> guard(registry_lock);
+  // one instance per job; the jobs of a cluster manifest share npu_offset 0
+  // on ns-3, so key them by their leader
+  const ClusterJob* job = workload->generator->job;
+  InferenceServing*& serving =
+      registry[job != nullptr ? job->leader : workload->generator->npu_offset];
+  if (serving != nullptr) {
+    return serving;
+  }
+  int all_gpus = workload->generator->all_gpus[0];
+  int group = workload->model_parallel_npu_group *
+      std::max(1, workload->expert_parallel_npu_group);
+  std::string err;
+  if (workload->pipeline_model_parallelism > 1) {
+    err = "pipeline parallel serving is not supported, use pp: 1";
+  } else if (
+      spec.prefill_ranks > 0 &&
+      (spec.prefill_ranks >= all_gpus || group <= 0 ||
+       spec.prefill_ranks % group != 0 ||
+       (all_gpus - spec.prefill_ranks) % group != 0)) {
+    err = "prefill_ranks: must split all GPUs into whole TP*EP groups";
+  }
+  if (!err.empty()) {
+    std::cerr << "Invalid inference serving spec: " << err << std::endl;
+    exit(1);
+  }
+  serving = new InferenceServing(spec, all_gpus);
+  return serving;
+}
+
+InferenceServing::InferenceServing(const ServingSpec& spec, int all_gpus)
+    : spec(spec), all_gpus(all_gpus) {
+  load_requests();
+}
+
+void InferenceServing::load_requests() {
+  if (!spec.trace.empty()) {
+    std::ifstream in(spec.trace);
+    if (!in) {
+      std::cerr << "Unable to open serving trace: " << spec.trace << std::endl;
+      exit(1);
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+      std::replace(line.begin(), line.end(), ',', ' ');
+      std::istringstream fields(line);
+      double arrival_s;
+      ServingRequest request;
+      if (!(fields >> arrival_s >> request.prompt >> request.output) ||
+          request.prompt < 1 || request.output < 1) {
+        continue; // header, comment or blank line
+      }
+      request.arrival = (Tick)(arrival_s * 1e9);
+      requests.push_back(request);
+    }
+    std::stable_sort(
+        requests.begin(),
+        requests.end(),
+        [](const ServingRequest& a, const ServingRequest& b) {
+          return a.arrival < b.arrival;
+        });
+  } else {
+    std::mt19937_64 rng(spec.seed);
+    std::exponential_distribution<double> gap(spec.rate);
+    std::uniform_int_distribution<int> prompt(spec.prompt_min, spec.prompt_max);
+    std::uniform_int_distribution<int> output(spec.output_min, spec.output_max);
+    double arrival_s = 0;
+    for (int i = 0; i < spec.requests; i++) {
+      arrival_s += gap(rng);
+      ServingRequest request;
+      request.arrival = (Tick)(arrival_s * 1e9);
+      request.prompt = prompt(rng);
+      request.output = output(rng);
+      requests.push_back(request);
+    }
+  }
+  if (requests.empty()) {
+    std::cerr << "Inference serving has no requests" << std::endl;
+    exit(1);
+  }
+}
+
+InferenceServing::Role InferenceServing::role_of(int rank) const {
+  if (spec.prefill_ranks == 0) {
+    return Role::Colocated;
+  }
+  return rank < spec.prefill_ranks ? Role::Prefill : Role::Decode;
+}
+
+Tick InferenceServing::scale(Tick cost, int tokens) const {
+  tokens = std::max(tokens, spec.weight_bound_tokens);
+  return (Tick)((double)cost * tokens / spec.ref_tokens);
+}
+
+const InferenceServing::Step* InferenceServing::step(
+    Role role,
+    int k,
+    Tick now,
+    Tick& wake) {
+  std::lock_guard<std::mutex> guard(lock);
+  wake = 0;
+  std::deque<Step>& decided = steps[(int)role];
+  if (k < (int)decided.size()) {
+    return &decided[k];
+  }
+  return decide(role, now, wake);
+}
+
+InferenceServing::Step* InferenceServing::decide(
+    Role role,
+    Tick now,
+    Tick& wake) {
+  std::vector<int>& run = running[(int)role];
+  Step step;
+  if (role != Role::Decode) {
+    while (next_arrival < requests.size() &&
+           requests[next_arrival].arrival <= now) {
+      waiting.push_back(next_arrival++);
+    }
+    int slots = role == Role::Colocated ? spec.max_batch - (int)run.size()
+                                        : spec.max_batch;
+    step.prefill = true;
+    step.tokens = 0;
+    while (!waiting.empty() && (int)step.requests.size() < slots) {
+      int r = waiting.front();
+      if (!step.requests.empty() &&
+          step.tokens + requests[r].prompt > spec.max_prefill_tokens) {
+        break;
+      }
+      step.requests.push_back(r);
+      step.tokens += requests[r].prompt;
+      waiting.pop_front();
+    }
+    if (!step.requests.empty()) {
+      for (int r : step.requests) {
+        requests[r].generated = 1;
+        if (requests[r].output <= 1) {
+          step.finishing.push_back(r);
+        } else if (role == Role::Colocated) {
+          run.push_back(r);
+        } else {
+          prefilled.push_back(r);
+        }
+      }
+      finished += step.finishing.size();
+      prefill_steps++;
+      steps[(int)role].push_back(step);
+      return &steps[(int)role].back();
+    }
+  } else {
+    for (auto it = prefilled.begin();
+         it != prefilled.end() && (int)run.size() < spec.max_batch;) {
+      const ServingRequest& request = requests[*it];
+      if (request.first_token > 0 && request.kv_ready <= now) {
+        run.push_back(*it);
+        it = prefilled.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  if (role != Role::Prefill && !run.empty()) {
+    step.prefill = false;
+    step.tokens = run.size();
+    step.requests = run;
+    std::vector<int> still_running;
+    for (int r : run) {
+      if (++requests[r].generated >= requests[r].output) {
+        step.finishing.push_back(r);
+      } else {
+        still_running.push_back(r);
+      }
+    }
+    run.swap(still_running);
+    finished += step.finishing.size();
+    decode_steps++;
+    steps[(int)role].push_back(step);
+    return &steps[(int)role].back();
+  }
+  if (role == Role::Decode) {
+    if (finished == (int)requests.size()) {
+      return nullptr;
+    }
+    Tick ready = 0;
+    for (int r : prefilled) {
+      if (requests[r].first_token > 0 &&
+          (ready == 0 || requests[r].kv_ready < ready)) {
+        ready = requests[r].kv_ready;
+      }
+    }
+    if (ready > now) {
+      wake = ready - now;
+    } else if (next_arrival < requests.size() &&
+               requests[next_arrival].arrival > now + decode_poll) {
+      wake = requests[next_arrival].arrival - now;
+    } else {
+      wake = decode_poll;
+    }
+  } else if (next_arrival < requests.size()) {
+    wake = requests[next_arrival].arrival - now;
+  }
+  return nullptr;
+}
+
+Tick InferenceServing::kv_transfer_time(
+    int request,
+    int rank,
+    AstraNetworkAPI* NI,
+    int tp_size) {
+  uint64_t bytes =
+      spec.kv_bytes_per_token * requests[request].prompt / std::max(1, tp_size);
+  if (bytes == 0) {
+    return 0;
+  }
+  // prefill rank r hands its shard to decode rank P + r % (N - P)
+  int peer = spec.prefill_ranks + rank % (all_gpus - spec.prefill_ranks);
+  double bw = NI != nullptr ? NI->get_BW_between(rank, peer) : -1;
+  if (bw <= 0) {
+    bw = UserParam::getInstance()->net_work_param.bw_per_nic; // GB/s = B/ns
+  }
+  if (bw <= 0) {
+    return 0;
+  }
+  double latency = NI != nullptr ? NI->get_latency_between(rank, peer) : -1;
+  return (Tick)(bytes / bw + std::max(0.0, latency));
+}
+
+void InferenceServing::step_finished(
+    Role role,
+    int k,
+    int rank,
+    Tick now,
+    AstraNetworkAPI* NI,
+    int tp_size) {
+  std::lock_guard<std::mutex> guard(lock);
+  Step& step = steps[(int)role][k];
+  if (step.stamped) {
+    return;
+  }
+  step.stamped = true;
+  if (step.prefill) {
+    for (int r : step.requests) {
+      requests[r].first_token = now;
+      if (role == Role::Prefill) {
+        requests[r].kv_ready = now + kv_transfer_time(r, rank, NI, tp_size);
+      }
+    }
+  }
+  for (int r : step.finishing) {
+    requests[r].finish = now;
+  }
+}
+
+void InferenceServing::engine_started() {
+  std::lock_guard<std::mutex> guard(lock);
+  engines++;
+}
+
+void InferenceServing::engine_finished(const std::string& path) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (++engines_finished == engines) {
+    report(path);
+  }
+}
+
+static double percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  double pos = p / 100 * (values.size() - 1);
+  size_t lo = (size_t)pos;
+  size_t hi = std::min(lo + 1, values.size() - 1);
+  return values[lo] + (values[hi] - values[lo]) * (pos - lo);
+}
+
+static double mean(const std::vector<double>& values) {
+  double sum = 0;
+  for (double v : values) {
+    sum += v;
+  }
+  return values.empty() ? 0 : sum / values.size();
+}
+
+void InferenceServing::report(const std::string& path) {
+  const double ms = FREQ * 1000.0;
+  std::vector<double> ttft, tpot, e2e;
+  Tick makespan = 0;
+  uint64_t output_tokens = 0;
+  int ttft_met = 0, tpot_met = 0, both_met = 0;
+  std::ofstream csv(path + "serving.csv", std::ios::out | std::ios::trunc);
+  csv << "id,arrival(ms),prompt,output,ttft(ms),tpot(ms),e2e(ms)" << std::endl;
+  for (size_t i = 0; i < requests.size(); i++) {
+    const ServingRequest& request = requests[i];
+    double request_ttft = (request.first_token - request.arrival) / ms;
+    double request_e2e = (request.finish - request.arrival) / ms;
+    double request_tpot = request.output > 1
+        ? (request.finish - request.first_token) / ms / (request.output - 1)
+        : 0;
+    ttft.push_back(request_ttft);
+    e2e.push_back(request_e2e);
+    if (request.output > 1) {
+      tpot.push_back(request_tpot);
+    }
+    makespan = std::max(makespan, request.finish);
+    output_tokens += request.output;
+    bool ttft_ok = spec.ttft_slo_ms <= 0 || request_ttft <= spec.ttft_slo_ms;
+    bool tpot_ok = spec.tpot_slo_ms <= 0 || request_tpot <= spec.tpot_slo_ms;
+    ttft_met += ttft_ok;
+    tpot_met += tpot_ok;
+    both_met += ttft_ok && tpot_ok;
+    csv << i << "," << request.arrival / ms << "," << request.prompt << ","
+        << request.output << "," << request_ttft << "," << request_tpot << ","
+        << request_e2e << std::endl;
+  }
+
+  char line[160];
+  std::cout << "# SimAI inference serving: " << requests.size() << " requests, "
+            << (spec.prefill_ranks > 0 ? "disaggregated" : "colocated")
+            << ", " << all_gpus << " GPUs" << std::endl;
+  if (spec.prefill_ranks > 0) {
+    std::cout << "# prefill ranks " << spec.prefill_ranks << ", decode ranks "
+              << all_gpus - spec.prefill_ranks << std::endl;
+  }
+  double seconds = makespan / ms / 1000;
+  std::snprintf(line, sizeof(line),
+                "# makespan %.3f s, %llu output tokens, %.1f tokens/s",
+                seconds, (unsigned long long)output_tokens,
+                seconds > 0 ? output_tokens / seconds : 0);
+  std::cout << line << std::endl;
+  std::cout << "# prefill steps " << prefill_steps << ", decode steps "
+            << decode_steps << std::endl;
+  std::cout << "#" << std::endl;
+  std::snprintf(line, sizeof(line), "# %-8s %10s %10s %10s %10s", "(ms)",
+                "p50", "p90", "p99", "mean");
+  std::cout << line << std::endl;
+  const std::pair<const char*, std::vector<double>*> metrics[] = {
+      {"TTFT", &ttft}, {"TPOT", &tpot}, {"E2E", &e2e}};
+  for (auto& metric : metrics) {
+    std::snprintf(line, sizeof(line), "  %-8s %10.2f %10.2f %10.2f %10.2f",
+                  metric.first, percentile(*metric.second, 50),
+                  percentile(*metric.second, 90),
+                  percentile(*metric.second, 99), mean(*metric.second));
+    std::cout << line << std::endl;
+  }
+  if (spec.ttft_slo_ms > 0 || spec.tpot_slo_ms > 0) {
+    double n = requests.size() / 100.0;
+    std::snprintf(line, sizeof(line),
+                  "# SLO attainment: TTFT %.1f%%, TPOT %.1f%%, both %.1f%%",
+                  ttft_met / n, tpot_met / n, both_met / n);
+    std::cout << line << std::endl;
+  }
+}
+
+ServingEngine::ServingEngine(
+    Workload* workload,
+    InferenceServing* serving,
+    InferenceServing::Role role)
+    : role(role),
+      finished(false),
+      waiting_collective(false),
+      workload(workload),
+      serving(serving),
+      step_index(0),
+      current(nullptr),
+      step_start(0),
+      layer(0),
+      compute_done(false),
+      comm_issued(false) {
+#ifdef ANALYTI
+  int TP_size = workload->model_parallel_npu_group;
+  int EP_size = workload->expert_parallel_npu_group;
+  int all_gpus = workload->generator->all_gpus[0];
+  int DP_size = all_gpus / (TP_size * workload->context_parallel_npu_group * workload->pipeline_model_parallelism);
+  for (int i = 0; i < workload->SIZE; i++) {
+    Layer* layer = workload->layers[i];
+    int nranks = layer->fwd_pass_group_type == MockNccl::GroupType::EP ? EP_size
+        : layer->fwd_pass_group_type == MockNccl::GroupType::CP
+        ? workload->context_parallel_npu_group
+        : layer->fwd_pass_group_type == MockNccl::GroupType::DP_EP
+        ? DP_size / EP_size
+        : TP_size;
+    Tick estimate = layer->compute_time(
+        layer->fwd_pass_comm_type,
+        TP_size,
+        nranks,
+        layer->fwd_pass_comm_size,
+        layer->fwd_pass_group_type,
+        all_gpus,
+        EP_size);
+    // a non-positive bus bandwidth for unknown hardware wraps the Tick
+    if (estimate > (Tick)INT64_MAX) {
+      std::cerr << "serving layer " << layer->id << " has no valid "
+                << "communication time; pass the hardware with -g_type, "
+                << "-nv, -nic and -n_p_s" << std::endl;
+      exit(1);
+    }
+    comm_estimate.push_back(estimate);
+  }
+#endif
+  serving->engine_started();
+}
+
+void ServingEngine::wait(Tick cycles) {
+  workload->generator->try_register_event(
+      this, EventType::General, NULL, cycles);
+}
+
+void ServingEngine::call(EventType, CallData*) {
+  waiting_collective = false;
+  while (!finished) {
+    if (current == nullptr) {
+      Tick wake = 0;
+      current = serving->step(role, step_index, Sys::boostedTick(), wake);
+      if (current == nullptr) {
+        if (wake > 0) {
+          wait(wake);
+          return;
+        }
+        finished = true;
+        serving->engine_finished(workload->path);
+        workload->call(EventType::General, NULL);
+        return;
+      }
+      step_start = Sys::boostedTick();
+      layer = 0;
+      compute_done = false;
+      comm_issued = false;
+#ifdef ANALYTI
+      Tick cycles = 0;
+      for (int i = 0; i < workload->SIZE; i++) {
+        cycles += serving->scale(
+            workload->layers[i]->fwd_pass_compute_time, current->tokens);
+        cycles += serving->scale(comm_estimate[i], current->tokens);
+      }
+      layer = workload->SIZE;
+      if (cycles > 0) {
+        wait(cycles);
+        return;
+      }
+#endif
+    }
+    if (layer < workload->SIZE) {
+      Layer* l = workload->layers[layer];
+      if (!compute_done) {
+        compute_done = true;
+        Tick cycles = serving->scale(l->fwd_pass_compute_time, current->tokens);
+        if (cycles > 0) {
+          wait(cycles);
+          return;
+        }
+      }
+      if (!comm_issued && l->fwd_pass_comm_type != ComType::None &&
+          l->fwd_pass_comm_size > 0) {
+        comm_issued = true;
+        waiting_collective = true;
+        uint64_t size = l->fwd_pass_comm_size;
+        // Sys takes the communication group from the layer at index
+        workload->index = layer;
+        l->fwd_pass_comm_size =
+            std::max<uint64_t>(1, serving->scale(size, current->tokens));
+        l->issue_forward_pass_comm(
+            SchedulingPolicy::None, CollectiveBarrier::Blocking);
+        l->fwd_pass_comm_size = size;
+        return;
+      }
+      layer++;
+      compute_done = false;
+      comm_issued = false;
+      continue;
+    }
+    finish_step();
+  }
+}
+
+void ServingEngine::finish_step() {
+  Sys* sys = workload->generator;
+  Tick now = Sys::boostedTick();
+  serving->step_finished(
+      role,
+      step_index,
+      sys->id,
+      now,
+      sys->NI,
+      workload->model_parallel_npu_group);
+  TraceExporter* trace = TraceExporter::get();
+  if (trace != nullptr && trace->traced(sys->id)) {
+    trace->compute(
+        sys->id, current->prefill ? "prefill" : "decode", step_start, now);
+  }
+  if (OverlapTimeline::enabled() && OverlapTimeline::recorded(sys->id)) {
+    OverlapTimeline::compute(sys->id, step_start, now);
+  }
+  step_index++;
+  current = nullptr;
+}
+} // namespace AstraSim
@@ -0,0 +1,165 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __INFERENCESERVING_HH__
+#define __INFERENCESERVING_HH__
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "astra-sim/system/Callable.hh"
+#include "astra-sim/system/Common.hh"
+
+namespace AstraSim {
+class Workload;
+class AstraNetworkAPI;
+
+// Options of an INFERENCE_SERVING workload, given as "key: value" pairs on
+// the workload header line next to model_parallel_NPU_group:, ep: etc.:
+//   tokens: 4096            tokens the layer table was generated for
+//   requests: 200 rate: 8   seeded Poisson arrivals (requests per second)
+//   trace: <file>           or arrivals from "arrival_s,prompt,output" lines
+//   prompt: 256-2048 output: 64-512   token counts, fixed or uniform range
+//   max_batch: 64 max_prefill_tokens: 8192 weight_bound_tokens: 0 seed: 1
+//   prefill_ranks: 0 kv_bytes_per_token: 0 ttft_slo_ms: 0 tpot_slo_ms: 0
+struct ServingSpec {
+  int ref_tokens = 0;
+  int requests = 100;
+  double rate = 1;
+  std::string trace;
+  int prompt_min = 512, prompt_max = 512;
+  int output_min = 128, output_max = 128;
+  int max_batch = 64;
+  int max_prefill_tokens = 8192;
+  // a step never costs less than this many tokens (weight reads bound decode)
+  int weight_bound_tokens = 0;
+  uint64_t seed = 1;
+  // > 0: ranks [0, prefill_ranks) only prefill, the others only decode
+  int prefill_ranks = 0;
+  uint64_t kv_bytes_per_token = 0;
+  double ttft_slo_ms = 0;
+  double tpot_slo_ms = 0;
+};
+
+struct ServingRequest {
+  Tick arrival;
+  int prompt;
+  int output;
+  int generated = 0;
+  Tick first_token = 0;
+  Tick kv_ready = 0;
+  Tick finish = 0;
+};
+
+// Request scheduling shared by all ranks of a serving job. Every rank runs a
+// ServingEngine that asks for its k-th step; the first rank to ask decides
+// it from the requests that have arrived by then (continuous batching,
+// prefill first) and later ranks replay the decision, so all ranks issue the
+// same collectives in the same order. The first rank to finish a step
+// stamps the request timings used for the TTFT/TPOT report.
+class InferenceServing {
+ public:
+  enum class Role { Colocated, Prefill, Decode };
+  struct Step {
+    bool prefill;
+    int tokens;
+    std::vector<int> requests;
+    std::vector<int> finishing; // requests that emit their last token
+    bool stamped = false;
+  };
+
+  static bool parse_header(
+      const std::vector<std::string>& tokens,
+      ServingSpec& spec,
+      std::string& err);
+  // Serving state of the job `workload` belongs to, created by its first rank.
+  static InferenceServing* join(Workload* workload, const ServingSpec& spec);
+
+  const ServingSpec spec;
+  Role role_of(int rank) const;
+  // Scales a per-layer cost of the layer table to a step of `tokens`.
+  Tick scale(Tick cost, int tokens) const;
+  // The k-th step of `role`, or nullptr when idle (`wake` ticks from now,
+  // 0 once the role has no work left).
+  const Step* step(Role role, int k, Tick now, Tick& wake);
+  void step_finished(
+      Role role,
+      int k,
+      int rank,
+      Tick now,
+      AstraNetworkAPI* NI,
+      int tp_size);
+  void engine_started();
+  // The last engine of the job to finish prints the report.
+  void engine_finished(const std::string& path);
+
+ private:
+  InferenceServing(const ServingSpec& spec, int all_gpus);
+  void load_requests();
+  Step* decide(Role role, Tick now, Tick& wake);
+  Tick kv_transfer_time(int request, int rank, AstraNetworkAPI* NI, int tp_size);
+  void report(const std::string& path);
+
+  std::mutex lock;
+  int all_gpus;
+  std::vector<ServingRequest> requests;
+  // steps decided so far, per role; deque keeps handed-out steps in place
+  std::deque<Step> steps[3];
+  size_t next_arrival = 0;
+  std::deque<int> waiting;
+  std::vector<int> running[3];
+  std::deque<int> prefilled; // waiting for their KV cache on the decode side
+  int finished = 0;
+  int engines = 0;
+  int engines_finished = 0;
+  int prefill_steps = 0;
+  int decode_steps = 0;
+};
+
+// Runs the steps of one role on one rank: every step walks the layers in
+// forward order, waiting the layer compute scaled to the step tokens and
+// issuing its forward collective as a blocking collective of scaled size.
+// The analytical backend does not simulate collectives, so it waits the
+// estimated collective time instead and charges a whole step at once.
+class ServingEngine : public Callable {
+ public:
+  ServingEngine(
+      Workload* workload,
+      InferenceServing* serving,
+      InferenceServing::Role role);
+  void call(EventType event, CallData* data);
+  InferenceServing::Role role;
+  bool finished;
+  // a blocking collective is in flight; its completion resumes this engine
+  bool waiting_collective;
+
+ private:
+  void wait(Tick cycles);
+  void finish_step();
+  Workload* workload;
+  InferenceServing* serving;
+  int step_index;
+  const InferenceServing::Step* current;
+  Tick step_start;
+  int layer;
+  bool compute_done;
+  bool comm_issued;
+  // estimated forward collective time of each layer, analytical backend only
+  std::vector<Tick> comm_estimate;
+};
+} // namespace AstraSim
+#endif
@@ -4,9 +4,16 @@ LICENSE file in the root directory of this source tree.
 *******************************************************************************/
 
 #include "Layer.hh"
+#include "ShardedDataParallel.hh"
+#include "WorkloadDag.hh"
 #include "astra-sim/system/DataSet.hh"
 #include "astra-sim/system/IntData.hh"
+#include "astra-sim/system/JobManifest.hh"
 #include "astra-sim/system/MockNcclLog.h"
+#include "astra-sim/system/NodeHardware.hh"
+#include "astra-sim/system/OverlapTimeline.hh"
+#include "astra-sim/system/RankLayout.hh"
+#include "astra-sim/system/TraceExporter.hh"
 #include "astra-sim/system/AstraParamParse.hh"
 // #ifdef ANALYTI
 #include "astra-sim/system/calbusbw.h"
@@ -77,6 +84,8 @@ Layer::Layer(
   this->total_weight_grad_comm = 0;
   this->total_input_grad_comm = 0;
   this->total_fwd_comm = 0;
+  this->total_recompute_compute = 0;
+  this->total_recompute_comm = 0;
   this->total_waiting_for_wg_comm = 0;
   this->total_waiting_for_ig_comm = 0;
   this->total_waiting_for_fwd_comm = 0;
@@ -85,12 +94,58 @@ Layer::Layer(
   this->last_wg_finished = 0;
   this->needs_fwd_in_bckwd_initiation = false;
   this->is_checkpoint = false;
+  this->recompute_fwd_comm = true;
+  this->recompute_count = 0;
   this->specific_parallellism = specific_policy;
   assert(generator != NULL);
 }
 
+void Layer::trace_collective(
+    const char* phase,
+    std::map<int, DataSet*>& datasets,
+    CallData* mdata,
+    uint64_t bytes,
+    MockNccl::GroupType group) {
+  #ifndef PHY_MTP
+  TraceExporter* trace = TraceExporter::get();
+  bool traced = trace != nullptr && trace->traced(generator->id);
+  bool overlap =
+      OverlapTimeline::enabled() && OverlapTimeline::recorded(generator->id);
+  if (!traced && !overlap) {
+    return;
+  }
+  auto it = datasets.find(((IntData*)mdata)->data);
+  if (it == datasets.end()) {
+    return;
+  }
+  if (traced) {
+    trace->collective(
+        generator->id,
+        id + phase,
+        it->second->creation_tick,
+        Sys::boostedTick(),
+        bytes);
+  }
+  if (overlap) {
+    OverlapTimeline::collective(
+        generator->id,
+        OverlapTimeline::stream_of(group),
+        id + phase,
+        it->second->creation_tick,
+        Sys::boostedTick(),
+        workload->path);
+  }
+  #endif
+}
+
 void Layer::call(EventType event, CallData* mdata) {
   if (event == EventType::Wight_Grad_Comm_Finished) {
+    trace_collective(
+        " wg comm",
+        weight_grad_datasets,
+        mdata,
+        weight_grad_comm_size,
+        weight_grad_group_type);
     last_wg_finished = Sys::boostedTick();
     generator->register_event(
         this,
@@ -99,6 +154,12 @@ void Layer::call(EventType event, CallData* mdata) {
         weight_grad_update_time);
     return;
   } else if (event == EventType::Input_Grad_Comm_Finished) {
+    trace_collective(
+        " ig comm",
+        input_grad_datasets,
+        mdata,
+        input_grad_comm_size,
+        input_grad_group_type);
     last_ig_finished = Sys::boostedTick();
     generator->register_event(
         this,
@@ -107,6 +168,12 @@ void Layer::call(EventType event, CallData* mdata) {
         input_grad_update_time);
     return;
   } else if (event == EventType::Fwd_Comm_Finished) {
+    trace_collective(
+        " fwd comm",
+        fwd_pass_datasets,
+        mdata,
+        fwd_pass_comm_size,
+        fwd_pass_group_type);
     last_fwd_finished = Sys::boostedTick();
     generator->register_event(
         this, EventType::Fwd_Comm_Finished_After_Delay, mdata, fwd_update_time);
@@ -153,6 +220,9 @@ void Layer::call(EventType event, CallData* mdata) {
     int dataset_streams = weight_grad_datasets[data]->total_streams;
     delete weight_grad_datasets[data];
     weight_grad_datasets.erase(data);
+    if (workload->dag != nullptr) {
+      workload->dag->comm_finished(layer_num, event);
+    }
     generator->increase_finished_streams(dataset_streams);
     delete intData;
     #else
@@ -198,6 +268,9 @@ void Layer::call(EventType event, CallData* mdata) {
     int dataset_streams = input_grad_datasets[data]->total_streams;
     delete input_grad_datasets[data];
     input_grad_datasets.erase(data);
+    if (workload->dag != nullptr) {
+      workload->dag->comm_finished(layer_num, event);
+    }
     generator->increase_finished_streams(dataset_streams);
     delete intData;
     #else
@@ -243,6 +316,9 @@ void Layer::call(EventType event, CallData* mdata) {
     int dataset_streams = fwd_pass_datasets[data]->total_streams;
     delete fwd_pass_datasets[data];
     fwd_pass_datasets.erase(data);
+    if (workload->dag != nullptr) {
+      workload->dag->comm_finished(layer_num, event);
+    }
     generator->increase_finished_streams(dataset_streams);
     delete intData;
     #else
@@ -257,6 +333,11 @@ Tick Layer::get_fwd_pass_compute() {
   total_forward_pass_compute += fwd_pass_compute_time;
   return fwd_pass_compute_time;
 }
+Tick Layer::get_recompute_compute() {
+  recompute_count++;
+  total_recompute_compute += fwd_pass_compute_time;
+  return get_fwd_pass_compute();
+}
 Tick Layer::get_input_grad_compute() {
   total_input_grad_compute += input_grad_compute_time;
   return input_grad_compute_time;
@@ -355,19 +436,27 @@ LayerData Layer::report(
   LayerData layerData;
   take_stream_stats_average();
   int TP_size = workload->model_parallel_npu_group;
+  int CP_size = workload->context_parallel_npu_group;
   int PP_size = workload->pipeline_model_parallelism;
-  int DP_size = workload->all_gpus / (TP_size * PP_size);
+  int DP_size = workload->all_gpus / (TP_size * CP_size * PP_size);
   int EP_size = workload->expert_parallel_npu_group;
   int vpp = workload->vpp;
   uint32_t pp_commsize = workload->pp_commsize;
   int GA = workload->GA;
   UserParam* param = UserParam::getInstance();
   int input_grad_group_size =
-      input_grad_group_type == MockNccl::GroupType::EP ? EP_size : TP_size;
+      input_grad_group_type == MockNccl::GroupType::EP      ? EP_size
+      : input_grad_group_type == MockNccl::GroupType::CP    ? CP_size
+      : input_grad_group_type == MockNccl::GroupType::DP_EP ? DP_size / EP_size
+                                                            : TP_size;
   int fwd_pass_group_size =
-      fwd_pass_group_type == MockNccl::GroupType::EP ? EP_size : TP_size;
+      fwd_pass_group_type == MockNccl::GroupType::EP      ? EP_size
+      : fwd_pass_group_type == MockNccl::GroupType::CP    ? CP_size
+      : fwd_pass_group_type == MockNccl::GroupType::DP_EP ? DP_size / EP_size
+                                                          : TP_size;
   int weight_grad_group_size =
       weight_grad_group_type == MockNccl::GroupType::DP_EP ? DP_size / EP_size
+      : weight_grad_group_type == MockNccl::GroupType::CP    ? CP_size
                                                            : DP_size;
   if (id != "embedding_layer"){
       pre_bubble_time += ((total_waiting_for_fwd_comm + total_forward_pass_compute + total_weight_grad_compute + total_input_grad_compute + total_waiting_for_ig_comm) / FREQ);
@@ -563,10 +652,11 @@ LayerData Layer::report(
   LayerData layerData;
   take_stream_stats_average();
   int TP_size = workload->model_parallel_npu_group;
+  int CP_size = workload->context_parallel_npu_group;
   int PP_size = workload->pipeline_model_parallelism;
   int vpp = workload->vpp;
   uint32_t pp_commsize = workload->pp_commsize;
-  int DP_size = generator->all_gpus[0] / (TP_size * PP_size);
+  int DP_size = generator->all_gpus[0] / (TP_size * CP_size * PP_size);
   int GA = workload->GA;
   int EP_size = workload->expert_parallel_npu_group;
   int fwd_pass_group_size ;
@@ -574,18 +664,36 @@ LayerData Layer::report(
   int input_grad_group_size ;
   UserParam* param = UserParam::getInstance();
   input_grad_group_size =
-        input_grad_group_type == MockNccl::GroupType::EP ? EP_size : TP_size;
+        input_grad_group_type == MockNccl::GroupType::EP      ? EP_size
+        : input_grad_group_type == MockNccl::GroupType::CP    ? CP_size
+        : input_grad_group_type == MockNccl::GroupType::DP_EP ? DP_size / EP_size
+                                                              : TP_size;
     fwd_pass_group_size =
-        fwd_pass_group_type == MockNccl::GroupType::EP ? EP_size : TP_size;
+        fwd_pass_group_type == MockNccl::GroupType::EP      ? EP_size
+        : fwd_pass_group_type == MockNccl::GroupType::CP    ? CP_size
+        : fwd_pass_group_type == MockNccl::GroupType::DP_EP ? DP_size / EP_size
+                                                            : TP_size;
     weight_grad_group_size =
         weight_grad_group_type == MockNccl::GroupType::DP_EP ? DP_size / EP_size
+        : weight_grad_group_type == MockNccl::GroupType::CP    ? CP_size
                                                              : DP_size;
   if(param->mode == ModeType::ANALYTICAL){
     
     total_fwd_comm = compute_time(fwd_pass_comm_type,TP_size,fwd_pass_group_size,fwd_pass_comm_size,fwd_pass_group_type,generator->all_gpus[0],EP_size);
     total_weight_grad_comm = compute_time(weight_grad_comm_type,TP_size,weight_grad_group_size,weight_grad_comm_size,weight_grad_group_type,generator->all_gpus[0],EP_size);
     total_input_grad_comm = compute_time(input_grad_comm_type,TP_size,input_grad_group_size,input_grad_comm_size,input_grad_group_type,generator->all_gpus[0],EP_size);
-    total_waiting_for_fwd_comm = total_fwd_comm; //tp forward
+    // forward replays in the backward pass reissue the forward collective;
+    // a non-positive bus bandwidth for unknown hardware wraps the Tick
+    if (recompute_fwd_comm && recompute_count > 0 &&
+        total_fwd_comm > (Tick)INT64_MAX) {
+      std::cerr << "AS_RECOMPUTE replay of layer " << id
+                << " has no valid communication time; pass the hardware "
+                << "with -g_type, -nv, -nic and -n_p_s" << std::endl;
+      exit(1);
+    }
+    total_recompute_comm =
+        recompute_fwd_comm ? total_fwd_comm * recompute_count : 0;
+    total_waiting_for_fwd_comm = total_fwd_comm + total_recompute_comm; //tp forward
     total_waiting_for_ig_comm = total_input_grad_comm;  //tp backward
     total_waiting_for_wg_comm = total_weight_grad_comm;
     
@@ -612,6 +720,18 @@ LayerData Layer::report(
     total_waiting_for_ig_comm *= (1-param->net_work_param.tp_overlap_ratio);
     Expose_TP_comm += ((total_waiting_for_fwd_comm + total_waiting_for_ig_comm) / FREQ);
   }
+  if (param->mode == ModeType::ANALYTICAL && workload->sharded != nullptr) {
+    // parameter gathers of the data-parallel group the prefetch left exposed
+    Tick fwd_gather = workload->sharded->exposed(layer_num, false);
+    Tick ig_gather = workload->sharded->exposed(layer_num, true);
+    total_waiting_for_fwd_comm += fwd_gather;
+    total_waiting_for_ig_comm += ig_gather;
+    (weight_grad_group_type == MockNccl::GroupType::DP_EP ? DP_EP_comm : DP_comm) +=
+        (fwd_gather + ig_gather) / FREQ;
+    if (id != "embedding_layer") {
+      pre_bubble_time += (fwd_gather + ig_gather) / FREQ;
+    }
+  }
 
   total_compute += (total_forward_pass_compute / FREQ);
   total_compute += (total_weight_grad_compute / FREQ);
@@ -941,6 +1061,12 @@ Tick Layer::compute_time(
     char* coll_type = comtype_to_coll(comtype);
     float bw_ratio = 1.0;
     BusBwResult result;
+    if (group_type == MockNccl::GroupType::CP && comtype == ComType::All_to_All) {
+      // ring attention passes the block nranks-1 times around the ring,
+      // which moves as much as a ring all-gather of nranks blocks
+      coll_type = comtype_to_coll(ComType::All_Gather);
+      data_size *= nranks;
+    }
 
     if (1 < data_size && data_size < 1048576){
       if(nranks == 2) comp_time = 10000;
@@ -952,7 +1078,50 @@ Tick Layer::compute_time(
       if(nranks == 128) comp_time = 320000;
       return comp_time;
     }
-  if (group_type == MockNccl::GroupType::TP ){
+  // CP ranks sit between TP and the EP/DP ranks
+  int cp_size = workload->context_parallel_npu_group;
+  int model_size = tp_size * cp_size;
+  int PP_size = workload->pipeline_model_parallelism;
+  if (PP_size <= 1 || all_gpus % (model_size * PP_size) != 0)
+    PP_size = 1;
+  int DP_size = all_gpus / (model_size * PP_size);
+  // a mixed cluster prices the group holding rank 0 on every kind of server
+  // it spans and keeps the slowest, since a collective runs at the pace of
+  // its slowest member
+  std::vector<NodeSpec> fleet = {{gpu_type, nvlink_bw, bw_per_nic, nics_per_server, 1}};
+  if (NodeHardware::configured()) {
+    const ClusterJob* job = workload->generator->job;
+    int first_node = (job == nullptr ? 0 : job->first_rank) / gpus_per_server;
+    std::vector<int> nodes;
+    if (ep_size > 0 && DP_size % ep_size == 0) {
+      nodes = RankLayout::get(all_gpus, gpus_per_server, tp_size, cp_size, DP_size, PP_size, ep_size)
+                  .servers(group_type);
+    } else {
+      for (int node = 0; node < std::max(1, all_gpus / (int)gpus_per_server); node++)
+        nodes.push_back(node);
+    }
+    for (int& node : nodes)
+      node += first_node;
+    fleet = NodeHardware::distinct(nodes, fleet[0]);
+  }
+  BusBwResult slowest;
+  for (size_t hw = 0; hw < fleet.size(); hw++) {
+    gpu_type = fleet[hw].gpu_type;
+    nvlink_bw = fleet[hw].nvlink_bw;
+    bw_per_nic = fleet[hw].bw_per_nic;
+    nics_per_server = fleet[hw].nics_per_server;
+    if (RankLayout::configured() && ep_size > 0 && DP_size % ep_size == 0 &&
+        (group_type == MockNccl::GroupType::TP ||
+         ((group_type == MockNccl::GroupType::EP || group_type == MockNccl::GroupType::DP ||
+           group_type == MockNccl::GroupType::DP_EP || group_type == MockNccl::GroupType::CP) && nranks > 1))) {
+      // the servers the group spans under the configured rank layout, with
+      // the NICs of a server shared by its ranks
+      int _node_count, _ranks_per_server;
+      RankLayout::get(all_gpus, gpus_per_server, tp_size, cp_size, DP_size, PP_size, ep_size)
+          .span(group_type, _node_count, _ranks_per_server);
+      float _temp_nics_per_server = nics_per_server * _ranks_per_server / (float)gpus_per_server;
+      result = cal_busbw(gpu_type,nvlink_bw,bw_per_nic,_temp_nics_per_server,_node_count,coll_type,_ranks_per_server,nic_type);
+    }else if (group_type == MockNccl::GroupType::TP ){
       //TP_comm_inside
       if(tp_size <= gpus_per_server){
       result = cal_busbw(gpu_type,nvlink_bw,bw_per_nic,nics_per_server,1,coll_type,tp_size,nic_type);
@@ -960,35 +1129,37 @@ Tick Layer::compute_time(
         int _node_count = tp_size / gpus_per_server;
         result = cal_busbw(gpu_type,nvlink_bw,bw_per_nic,nics_per_server,_node_count,coll_type,gpus_per_server,nic_type);
       }
-    }else if (group_type == MockNccl::GroupType::EP && nranks > 1)
+    }else if ((group_type == MockNccl::GroupType::EP || group_type == MockNccl::GroupType::CP) && nranks > 1)
     {
-     if(tp_size * nranks <= gpus_per_server){
-      uint32_t _temp_gpus_per_server = gpus_per_server / tp_size;
+     // ranks of the group are this far apart
+     int stride = group_type == MockNccl::GroupType::CP ? tp_size : model_size;
+     if(stride * nranks <= gpus_per_server){
+      uint32_t _temp_gpus_per_server = gpus_per_server / stride;
       result = cal_busbw(gpu_type,nvlink_bw,bw_per_nic,nics_per_server,1,coll_type,_temp_gpus_per_server,nic_type);
 
      }else{
-      int _node_count = (tp_size * nranks) / gpus_per_server;
-      uint32_t _temp_gpus_per_server = (gpus_per_server / tp_size > 1) ? (gpus_per_server / tp_size) : 1;
-      float _temp_nics_per_server = (tp_size > gpus_per_server) ? (nics_per_server / gpus_per_server) : (nics_per_server / tp_size);
+      int _node_count = (stride * nranks) / gpus_per_server;
+      uint32_t _temp_gpus_per_server = (gpus_per_server / stride > 1) ? (gpus_per_server / stride) : 1;
+      float _temp_nics_per_server = (stride > gpus_per_server) ? ((float)nics_per_server / gpus_per_server) : ((float)nics_per_server / stride);
       result = cal_busbw(gpu_type,nvlink_bw,bw_per_nic,_temp_nics_per_server,_node_count,coll_type,_temp_gpus_per_server,nic_type);
      }
     }else if(group_type == MockNccl::GroupType::DP && nranks > 1){
-      if(tp_size <= gpus_per_server){
-        uint32_t _temp_gpus_per_server = gpus_per_server / tp_size;
-        float _temp_nics_per_server = nics_per_server / tp_size;
+      if(model_size <= gpus_per_server){
+        uint32_t _temp_gpus_per_server = gpus_per_server / model_size;
+        float _temp_nics_per_server = (float)nics_per_server / model_size;
         result = cal_busbw(gpu_type,nvlink_bw,bw_per_nic,_temp_nics_per_server,nranks,coll_type,_temp_gpus_per_server,nic_type);
       }else{
-        float _temp_nics_per_server = nics_per_server / gpus_per_server;
+        float _temp_nics_per_server = (float)nics_per_server / gpus_per_server;
         result = cal_busbw(gpu_type,nvlink_bw,bw_per_nic,_temp_nics_per_server,nranks,coll_type,1,nic_type);
       }
     }else if(group_type == MockNccl::GroupType::DP_EP && nranks > 1){
-      if(tp_size * ep_size <= gpus_per_server){
-        float _temp_nics_per_server = nics_per_server / (tp_size * ep_size);
-        uint32_t _temp_gpus_per_server = gpus_per_server / (tp_size * ep_size);
+      if(model_size * ep_size <= gpus_per_server){
+        float _temp_nics_per_server = (float)nics_per_server / (model_size * ep_size);
+        uint32_t _temp_gpus_per_server = gpus_per_server / (model_size * ep_size);
         result = cal_busbw(gpu_type,nvlink_bw,bw_per_nic,_temp_nics_per_server,nranks,coll_type,_temp_gpus_per_server,nic_type);
        
       }else{
-        float _temp_nics_per_server = nics_per_server / gpus_per_server;
+        float _temp_nics_per_server = (float)nics_per_server / gpus_per_server;
         result = cal_busbw(gpu_type,nvlink_bw,bw_per_nic,_temp_nics_per_server,nranks,coll_type,1,nic_type);
       }
     }else{
@@ -996,8 +1167,13 @@ Tick Layer::compute_time(
       comp_time = 0;
       return comp_time;
     }
+    if (hw == 0 || result.busbw < slowest.busbw) {
+      slowest = result;
+    }
+  }
+  result = slowest;
     
-    bw_ratio = cal_ratio(data_size,nranks,tp_size,gpus_per_server,group_type,coll_type,result.is_nvlink);
+    bw_ratio = cal_ratio(data_size,nranks,group_type == MockNccl::GroupType::EP ? model_size : tp_size,gpus_per_server,group_type,coll_type,result.is_nvlink);
     cout<<"Communication Type: "<<coll_type<<"Communication Group: "<<group_type<<"Group Size: "<< nranks<<"Data Size: "<<data_size<<"Ratio: "<<bw_ratio<<"Bottleneck is nvlink: "<<result.is_nvlink<<endl;
     if(comtype == ComType::All_Reduce){
       comp_time = data_size * GBps / (bw_ratio * result.busbw) * 1e9 * 2 * 
@@ -55,6 +55,10 @@ class Layer : public Callable, public StreamStat {
 
   bool needs_fwd_in_bckwd_initiation;
   bool is_checkpoint;
+  // a forward replayed in the backward pass reissues its collective; false
+  // for layers AS_RECOMPUTE=selective replays
+  bool recompute_fwd_comm;
+  int recompute_count; // forward replays in the backward pass
   ParallelismPolicy specific_parallellism;
 
   int lookup_table_size;
@@ -73,6 +77,8 @@ class Layer : public Callable, public StreamStat {
   Tick total_weight_grad_comm;
   Tick total_input_grad_comm;
   Tick total_fwd_comm;
+  Tick total_recompute_compute;
+  Tick total_recompute_comm;
 
   Tick last_fwd_finished;
   Tick last_wg_finished;
@@ -109,7 +115,16 @@ class Layer : public Callable, public StreamStat {
       Tick weight_grad_update_time,
       ParallelismPolicy specific_policy);
   void call(EventType event, CallData* mdata);
+  void trace_collective(
+      const char* phase,
+      std::map<int, DataSet*>& datasets,
+      CallData* mdata,
+      uint64_t bytes,
+      MockNccl::GroupType group);
   Tick get_fwd_pass_compute();
+  // forward compute replayed in the backward pass; also counted as forward
+  // compute
+  Tick get_recompute_compute();
   Tick get_input_grad_compute();
   Tick get_weight_grad_compute();
   void increment_waiting_for_wg();
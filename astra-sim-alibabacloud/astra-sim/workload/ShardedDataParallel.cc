@@ -0,0 +1,331 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "ShardedDataParallel.hh"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "Layer.hh"
+#include "Workload.hh"
+#include "astra-sim/system/DataSet.hh"
+#include "astra-sim/system/IntData.hh"
+#include "astra-sim/system/MemoryAccounting.hh"
+#include "astra-sim/system/OverlapTimeline.hh"
+
+namespace AstraSim {
+ShardedDataParallel* ShardedDataParallel::configure(Workload* workload) {
+  const char* env = std::getenv("AS_ZERO_STAGE");
+  if (env == nullptr || *env == '\0') {
+    return nullptr;
+  }
+  std::string text(env);
+  if (text != "1" && text != "2" && text != "3") {
+    std::cerr << "Invalid AS_ZERO_STAGE " << text << ", expected 1, 2 or 3"
+              << std::endl;
+    exit(1);
+  }
+  int prefetch = 1;
+  env = std::getenv("AS_ZERO_PREFETCH");
+  if (env != nullptr && *env != '\0') {
+    char* end;
+    prefetch = strtol(env, &end, 10);
+    if (*end != '\0' || prefetch < 0) {
+      std::cerr << "Invalid AS_ZERO_PREFETCH " << env
+                << ", expected a number of buckets" << std::endl;
+      exit(1);
+    }
+  }
+  uint64_t bucket_bytes = 0;
+  env = std::getenv("AS_ZERO_BUCKET");
+  if (env != nullptr && !MemoryAccounting::parse_bytes(env, bucket_bytes)) {
+    std::cerr << "Invalid AS_ZERO_BUCKET " << env << ", expected e.g. 256M"
+              << std::endl;
+    exit(1);
+  }
+  bool transformer =
+      workload->parallelismPolicy == ParallelismPolicy::Transformer ||
+      workload->parallelismPolicy == ParallelismPolicy::TransformerFwdInBckwd;
+#ifdef PHY_MTP
+  transformer = false;
+#endif
+  if (!transformer) {
+    if (workload->generator->id == 0) {
+      std::cerr << "AS_ZERO_STAGE ignored: sharding needs a transformer workload"
+                << std::endl;
+    }
+    return nullptr;
+  }
+  ShardedDataParallel* sharded =
+      new ShardedDataParallel(workload, text[0] - '0', prefetch, bucket_bytes);
+  sharded->shard();
+  if (sharded->buckets.empty()) {
+    if (workload->generator->id == 0) {
+      std::cerr << "AS_ZERO_STAGE ignored: no data-parallel gradient all-reduce "
+                   "to shard"
+                << std::endl;
+    }
+    delete sharded;
+    return nullptr;
+  }
+  return sharded;
+}
+
+ShardedDataParallel::ShardedDataParallel(
+    Workload* workload,
+    int stage,
+    int prefetch,
+    uint64_t bucket_bytes)
+    : stage(stage),
+      prefetch(prefetch),
+      bucket_bytes(bucket_bytes),
+      workload(workload),
+      waiting_layer(-1),
+      waiting_backward(false),
+      wait_start(0),
+      swept(false),
+      total_gather(0),
+      total_exposed(0) {}
+
+void ShardedDataParallel::shard() {
+  Layer** layers = workload->layers;
+  bucket_of.assign(workload->SIZE, -1);
+  for (int i = 0; i < workload->SIZE; i++) {
+    Layer* layer = layers[i];
+    MockNccl::GroupType group = layer->weight_grad_group_type;
+    if (layer->weight_grad_comm_type != ComType::All_Reduce ||
+        layer->weight_grad_comm_size == 0 ||
+        (group != MockNccl::GroupType::DP &&
+         group != MockNccl::GroupType::DP_EP)) {
+      continue;
+    }
+    if (buckets.empty() || buckets.back().bytes >= bucket_bytes ||
+        buckets.back().group != group) {
+      buckets.push_back({i, i, 0, group});
+    }
+    Bucket& bucket = buckets.back();
+    bucket.last = i;
+    bucket.bytes += layer->weight_grad_comm_size;
+    bucket_of[i] = buckets.size() - 1;
+    layer->weight_grad_comm_type = ComType::None;
+    layer->weight_grad_comm_size = 0;
+  }
+  // the lowest layer of a bucket is the last to compute its gradients
+  for (Bucket& bucket : buckets) {
+    layers[bucket.first]->weight_grad_comm_type = ComType::Reduce_Scatter;
+    layers[bucket.first]->weight_grad_comm_size = bucket.bytes;
+  }
+  for (int backward = 0; backward < 2; backward++) {
+    issued[backward].assign(buckets.size(), -1);
+    gathered[backward].assign(buckets.size(), -1);
+  }
+}
+
+bool ShardedDataParallel::forward_ready(int layer) {
+  return ready(layer, false);
+}
+
+bool ShardedDataParallel::backward_ready(int layer) {
+  return stage < 3 || ready(layer, true);
+}
+
+bool ShardedDataParallel::ready(int layer, bool backward) {
+  int b = bucket_of[layer];
+  if (b < 0) {
+    return true;
+  }
+  int pass = workload->pass_counter;
+  for (int k = 0; k <= prefetch; k++) {
+    int next = backward ? b - k : b + k;
+    if (next < 0 || next >= (int)buckets.size()) {
+      break;
+    }
+    if (issued[backward][next] != pass) {
+      gather(next, backward);
+    }
+  }
+  if (gathered[backward][b] == pass) {
+    return true;
+  }
+  waiting_layer = layer;
+  waiting_backward = backward;
+  wait_start = Sys::boostedTick();
+  return false;
+}
+
+void ShardedDataParallel::gather(int b, bool backward) {
+  int pass = workload->pass_counter;
+  issued[backward][b] = pass;
+#ifdef ANALYTI
+  gathered[backward][b] = pass;
+#else
+  Bucket& bucket = buckets[b];
+  Layer* layer = workload->layers[bucket.first];
+  // Sys takes the communication group from the layer at index; the
+  // weight-gradient group of the layer is its data-parallel group
+  Workload::LoopState state = workload->current_state;
+  int index = workload->index;
+  workload->current_state = Workload::LoopState::Weight_Gradient;
+  workload->index = bucket.first;
+  DataSet* dataset = workload->generator->generate_all_gather(
+      bucket.bytes,
+      layer->weight_grad_comm_involved_dimensions,
+      SchedulingPolicy::None,
+      layer->layer_num);
+  workload->current_state = state;
+  workload->index = index;
+  if (!dataset->active) {
+    delete dataset;
+    gathered[backward][b] = pass;
+    return;
+  }
+  in_flight[dataset->my_id] = {dataset, b, backward, pass};
+  dataset->set_notifier(this, EventType::General);
+#endif
+}
+
+void ShardedDataParallel::call(EventType, CallData* data) {
+  IntData* id = (IntData*)data;
+  auto it = in_flight.find(id->data);
+  delete id;
+  if (it == in_flight.end()) {
+    return;
+  }
+  Gather done = it->second;
+  in_flight.erase(it);
+  total_gather += Sys::boostedTick() - done.dataset->creation_tick;
+  int rank = workload->generator->id;
+  if (OverlapTimeline::enabled() && OverlapTimeline::recorded(rank)) {
+    Bucket& bucket = buckets[done.bucket];
+    OverlapTimeline::collective(
+        rank,
+        OverlapTimeline::stream_of(bucket.group),
+        workload->layers[bucket.first]->id + " param gather",
+        done.dataset->creation_tick,
+        Sys::boostedTick(),
+        workload->path);
+  }
+  int streams = done.dataset->total_streams;
+  delete done.dataset;
+  gathered[done.backward][done.bucket] = done.pass;
+  bool resume = waiting_layer >= 0 && waiting_backward == done.backward &&
+      bucket_of[waiting_layer] == done.bucket;
+  if (resume) {
+    Tick waited = Sys::boostedTick() - wait_start;
+    Layer* layer = workload->layers[waiting_layer];
+    if (done.backward) {
+      layer->total_waiting_for_ig_comm += waited;
+    } else {
+      layer->total_waiting_for_fwd_comm += waited;
+    }
+    total_exposed += waited;
+    waiting_layer = -1;
+  }
+  workload->generator->increase_finished_streams(streams);
+  if (resume) {
+    workload->call(EventType::General, NULL);
+  }
+}
+
+// Walks the layers of a pass in each direction with the gathers on one
+// data-parallel stream: the gather of a bucket starts when the compute
+// reaches `prefetch` buckets before it and the stream is free, and the
+// compute of the bucket waits for it.
+void ShardedDataParallel::sweep() {
+  swept = true;
+  Layer** layers = workload->layers;
+  int N = workload->SIZE;
+  int TP_size = workload->model_parallel_npu_group;
+  int EP_size = workload->expert_parallel_npu_group;
+  int all_gpus = workload->generator->all_gpus[0];
+  int DP_size = all_gpus /
+      (TP_size * workload->context_parallel_npu_group *
+       workload->pipeline_model_parallelism);
+  std::vector<Tick> cost(buckets.size());
+  for (size_t b = 0; b < buckets.size(); b++) {
+    Bucket& bucket = buckets[b];
+    int nranks =
+        bucket.group == MockNccl::GroupType::DP_EP ? DP_size / EP_size : DP_size;
+    cost[b] = layers[bucket.first]->compute_time(
+        ComType::All_Gather,
+        TP_size,
+        nranks,
+        bucket.bytes,
+        bucket.group,
+        all_gpus,
+        EP_size);
+    // a non-positive bus bandwidth for unknown hardware wraps the Tick
+    if (cost[b] > (Tick)INT64_MAX) {
+      std::cerr << "AS_ZERO_STAGE gather of " << bucket.bytes
+                << " B has no valid time; pass the hardware with -g_type, "
+                << "-nv, -nic and -n_p_s" << std::endl;
+      exit(1);
+    }
+  }
+  for (int backward = 0; backward < (stage == 3 ? 2 : 1); backward++) {
+    exposed_time[backward].assign(N, 0);
+    std::vector<Tick> end(buckets.size(), 0);
+    std::vector<bool> started(buckets.size(), false);
+    Tick now = 0, stream = 0;
+    for (int step = 0; step < N; step++) {
+      int i = backward ? N - 1 - step : step;
+      Layer* layer = layers[i];
+      int b = bucket_of[i];
+      if (b >= 0) {
+        for (int k = 0; k <= prefetch; k++) {
+          int next = backward ? b - k : b + k;
+          if (next < 0 || next >= (int)buckets.size()) {
+            break;
+          }
+          if (!started[next]) {
+            started[next] = true;
+            end[next] = std::max(now, stream) + cost[next];
+            stream = end[next];
+            total_gather += cost[next];
+          }
+        }
+        if (end[b] > now) {
+          exposed_time[backward][i] = end[b] - now;
+          total_exposed += end[b] - now;
+          now = end[b];
+        }
+      }
+      if (backward) {
+        now += layer->input_grad_compute_time + layer->weight_grad_compute_time;
+      } else {
+        now += layer->fwd_pass_compute_time;
+      }
+    }
+  }
+  if (stage < 3) {
+    exposed_time[1].assign(N, 0);
+  }
+}
+
+Tick ShardedDataParallel::exposed(int layer, bool backward) {
+  if (!swept) {
+    sweep();
+  }
+  return exposed_time[backward][layer];
+}
+
+void ShardedDataParallel::report() {
+  std::cout << "ZeRO stage " << stage << ": " << buckets.size()
+            << " buckets, parameter gathers " << (Tick)(total_gather / FREQ)
+            << " us, " << (Tick)(total_exposed / FREQ) << " us exposed"
+            << std::endl;
+}
+} // namespace AstraSim
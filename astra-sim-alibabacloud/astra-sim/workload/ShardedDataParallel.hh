@@ -0,0 +1,96 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __SHARDEDDATAPARALLEL_HH__
+#define __SHARDEDDATAPARALLEL_HH__
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "astra-sim/system/Callable.hh"
+#include "astra-sim/system/Common.hh"
+#include "astra-sim/system/MockNcclGroup.h"
+
+namespace AstraSim {
+class DataSet;
+class Workload;
+
+// Sharded data parallelism (ZeRO, FSDP) for the transformer policies,
+// enabled by AS_ZERO_STAGE=1|2|3. The weight-gradient all-reduces of the
+// data-parallel groups are grouped into buckets of AS_ZERO_BUCKET bytes of
+// consecutive layers (default: one layer per bucket), and each bucket
+// reduce-scatters its gradients once its lowest layer has computed them.
+// The parameters of a bucket are all-gathered before its forward pass and,
+// at stage 3 (FSDP full sharding), again before its backward pass; the
+// gathers of the next AS_ZERO_PREFETCH buckets (default 1) are issued
+// ahead. Stages 1 and 2 differ in memory only.
+class ShardedDataParallel : public Callable {
+ public:
+  // nullptr unless AS_ZERO_STAGE is set; exits on a bad setting
+  static ShardedDataParallel* configure(Workload* workload);
+  // Issue the gathers the forward (backward) compute of `layer` prefetches
+  // and tell whether the parameters of the layer are gathered. If not, the
+  // workload is called once they are.
+  bool forward_ready(int layer);
+  bool backward_ready(int layer);
+  // Exposed time of the gathers before the forward or backward compute of
+  // `layer`, from a sweep over the layers (analytical backend).
+  Tick exposed(int layer, bool backward);
+  void call(EventType event, CallData* data);
+  void report();
+  int stage;
+  int prefetch;
+  uint64_t bucket_bytes;
+
+ private:
+  struct Bucket {
+    int first;
+    int last;
+    uint64_t bytes;
+    MockNccl::GroupType group;
+  };
+  struct Gather {
+    DataSet* dataset;
+    int bucket;
+    bool backward;
+    int pass;
+  };
+  ShardedDataParallel(
+      Workload* workload,
+      int stage,
+      int prefetch,
+      uint64_t bucket_bytes);
+  void shard();
+  bool ready(int layer, bool backward);
+  void gather(int bucket, bool backward);
+  void sweep();
+  Workload* workload;
+  std::vector<Bucket> buckets;
+  std::vector<int> bucket_of; // -1 for layers without data-parallel gradients
+  // pass for which the gather of each bucket was issued / has finished,
+  // forward [0] and backward [1]
+  std::vector<int> issued[2];
+  std::vector<int> gathered[2];
+  std::map<int, Gather> in_flight; // by dataset id
+  int waiting_layer;
+  bool waiting_backward;
+  Tick wait_start;
+  bool swept;
+  std::vector<Tick> exposed_time[2];
+  Tick total_gather;
+  Tick total_exposed;
+};
+} // namespace AstraSim
+#endif
@@ -5,13 +5,25 @@ LICENSE file in the root directory of this source tree.
 
 #include "Workload.hh"
 #include "CSVWriter.hh"
+#include "CollectiveBench.hh"
+#include "InferenceServing.hh"
 #include "Layer.hh"
+#include "ShardedDataParallel.hh"
+#include "WorkloadDag.hh"
+#include "astra-sim/system/AstraParamParse.hh"
+#include "astra-sim/system/JobManifest.hh"
+#include "astra-sim/system/MemoryAccounting.hh"
 #include "astra-sim/system/MockNcclLog.h"
+#include "astra-sim/system/OverlapTimeline.hh"
+#include "astra-sim/system/TraceExporter.hh"
 
 namespace AstraSim
 {
+  static MemoryAccounting::Counter workload_bytes("workload");
+
   Workload::~Workload()
   {
+    workload_bytes.sub(accounted_bytes);
     if (end_to_end != nullptr)
     {
       delete end_to_end;
@@ -28,6 +40,18 @@ namespace AstraSim
     {
       delete layers[i];
     }
+    for (ServingEngine *engine : serving_engines)
+    {
+      delete engine;
+    }
+    if (dag != nullptr)
+    {
+      delete dag;
+    }
+    if (sharded != nullptr)
+    {
+      delete sharded;
+    }
     if (layers != nullptr)
     {
       delete[] layers;
@@ -56,6 +80,7 @@ namespace AstraSim
     this->pass_counter = 0;
     this->index = 0;
     this->waiting_for_comm = 0;
+    this->context_parallel_npu_group = 1;
     end_to_end = nullptr;
     detailed = nullptr;
     dimension_utilization = nullptr;
@@ -71,7 +96,7 @@ namespace AstraSim
     this->run_name = run_name;
     this->registered_for_finished_streams = false;
 #ifndef PHY_MTP
-    if (generator->id == 0 && seprate_log)
+    if (generator->leads_job() && seprate_log)
     {
       std::cout << "stat path: " << path << " ,total rows: " << total_rows
                 << " ,stat row: " << stat_row << std::endl;
@@ -106,7 +131,11 @@ namespace AstraSim
           this, EventType::Workload_Wait, NULL, counter);
       return;
     }
-    if (parallelismPolicy == ParallelismPolicy::Data)
+    if (dag != nullptr)
+    {
+      iterate_dag();
+    }
+    else if (parallelismPolicy == ParallelismPolicy::Data)
     {
       iterate_data_parallel();
     }
@@ -140,6 +169,10 @@ namespace AstraSim
     {
       iterate_distributed_inference();
     }
+    else if (parallelismPolicy == ParallelismPolicy::InferenceServing)
+    {
+      iterate_inference_serving();
+    }
     else if (parallelismPolicy == ParallelismPolicy::TransformerFwdInBckwd)
     {
       iterate_hybrid_parallel_Transformer_fwd_in_bckwd();
@@ -211,6 +244,15 @@ namespace AstraSim
           Expose_EP_comm));
 #endif
     }
+    if (!bench_spec.empty())
+    {
+      CollectiveBench::report(this);
+    }
+    report_recompute();
+    if (sharded != nullptr)
+    {
+      sharded->report();
+    }
     astraSimDataAPI.total_compute = total_compute;
     astraSimDataAPI.total_exposed_comm = total_exposed;
     astraSimDataAPI.avg_chunk_latency_per_logical_dimension =
@@ -265,9 +307,14 @@ namespace AstraSim
       if (generator->streams_finished == generator->streams_injected)
       {
 #ifndef PHY_MTP
-        if (generator->id == 0)
+        if (generator->leads_job())
         {
-          report();
+          // serving reports its requests once every engine has finished
+          if (serving == nullptr)
+          {
+            report();
+          }
+          JobManifest::finished(generator);
         }
 #endif
         generator->workload_finished();
@@ -276,6 +323,25 @@ namespace AstraSim
     }
     return;
   }
+  void Workload::wait_for_compute()
+  {
+    TraceExporter *trace = TraceExporter::get();
+    if (trace != nullptr && trace->traced(generator->id))
+    {
+      const char *phase = current_state == LoopState::Weight_Gradient ? " wg"
+                          : current_state == LoopState::Input_Gradient ? " ig"
+                                                                        : " fwd";
+      Tick now = Sys::boostedTick();
+      trace->compute(generator->id, layers[index]->id + phase, now, now + counter);
+    }
+    if (OverlapTimeline::enabled() && OverlapTimeline::recorded(generator->id))
+    {
+      Tick now = Sys::boostedTick();
+      OverlapTimeline::compute(generator->id, now, now + counter);
+    }
+    generator->try_register_event(
+        this, EventType::Workload_Wait, NULL, counter);
+  }
   void Workload::iterate_micro_benchmark()
   {
     assert(index >= 0);
@@ -308,8 +374,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       index++;
@@ -331,8 +396,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       delay_loaded = false;
@@ -364,8 +428,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       delay_loaded = false;
@@ -393,8 +456,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued)
@@ -424,8 +486,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued)
@@ -471,8 +532,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued && index > 0)
@@ -506,8 +566,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued)
@@ -537,8 +596,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued)
@@ -584,8 +642,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued && index > 0)
@@ -619,8 +676,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued)
@@ -650,8 +706,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued)
@@ -697,8 +752,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued && index > 0)
@@ -732,8 +786,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued)
@@ -755,6 +808,77 @@ namespace AstraSim
       return;
     }
   }
+  void Workload::iterate_inference_serving()
+  {
+    check_for_sim_end();
+    if (current_state == LoopState::Wait_For_Sim_Finish)
+    {
+      return;
+    }
+    if (serving_engines.empty())
+    {
+#ifdef ANALYTI
+      // the analytical backend simulates a single rank, which plays both
+      // sides of a disaggregated deployment
+      if (serving->spec.prefill_ranks > 0)
+      {
+        serving_engines.push_back(new ServingEngine(
+            this, serving, InferenceServing::Role::Prefill));
+        serving_engines.push_back(new ServingEngine(
+            this, serving, InferenceServing::Role::Decode));
+      }
+      else
+      {
+        serving_engines.push_back(new ServingEngine(
+            this, serving, InferenceServing::Role::Colocated));
+      }
+#else
+      int rank = generator->id;
+      if (generator->job != nullptr)
+      {
+        rank -= generator->job->first_rank;
+      }
+      serving_engines.push_back(
+          new ServingEngine(this, serving, serving->role_of(rank)));
+#endif
+      for (size_t i = 0; i < serving_engines.size(); i++)
+      {
+        serving_engines[i]->call(EventType::General, NULL);
+      }
+      return;
+    }
+    bool all_finished = true;
+    for (ServingEngine *engine : serving_engines)
+    {
+      all_finished = all_finished && engine->finished;
+    }
+    if (all_finished)
+    {
+      pass_counter = TOTAL_PASS;
+      check_for_sim_end();
+      return;
+    }
+    for (ServingEngine *engine : serving_engines)
+    {
+      if (engine->waiting_collective)
+      {
+        engine->call(EventType::General, NULL);
+        return;
+      }
+    }
+  }
+  void Workload::iterate_dag()
+  {
+    check_for_sim_end();
+    if (current_state == LoopState::Wait_For_Sim_Finish)
+    {
+      return;
+    }
+    if (!dag->started)
+    {
+      dag->start();
+    }
+  }
   void Workload::iterate_model_parallel()
   {
     assert(index >= 0);
@@ -773,8 +897,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued)
@@ -805,8 +928,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!layers[index]->is_input_grad_comm_finished_blocking())
@@ -846,8 +968,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued && index > 0)
@@ -875,6 +996,11 @@ namespace AstraSim
       {
         return;
       }
+      if (delay_loaded == false && sharded != nullptr &&
+          !sharded->forward_ready(index))
+      {
+        return;
+      }
       if (delay_loaded == false)
       {
         counter = layers[index]->get_fwd_pass_compute();
@@ -882,8 +1008,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued)
@@ -913,8 +1038,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued)
@@ -953,6 +1077,11 @@ namespace AstraSim
     }
     else if (current_state == LoopState::Input_Gradient)
     {
+      if (delay_loaded == false && sharded != nullptr &&
+          !sharded->backward_ready(index))
+      {
+        return;
+      }
       if (delay_loaded == false)
       {
         counter = layers[index]->get_input_grad_compute();
@@ -960,8 +1089,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued)
@@ -990,6 +1118,11 @@ namespace AstraSim
       {
         return;
       }
+      if (delay_loaded == false && sharded != nullptr &&
+          !sharded->forward_ready(index))
+      {
+        return;
+      }
       if (delay_loaded == false)
       {
         counter = layers[index]->get_fwd_pass_compute();
@@ -997,8 +1130,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued)
@@ -1033,8 +1165,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued)
@@ -1073,12 +1204,16 @@ namespace AstraSim
     }
     else if (current_state == LoopState::Input_Gradient)
     {
-      if (layers[index]->needs_fwd_in_bckwd_initiation && !checkpoint_initiated)
+      if (layers[index]->needs_fwd_in_bckwd_initiation && !checkpoint_initiated &&
+          index > 0)
       {
+        // replay from the nearest checkpoint below the initiating layer, which
+        // may itself checkpoint the range above it
         int tmp = index;
-        while (!layers[index--]->is_checkpoint)
-          ;
-        index++;
+        do
+        {
+          index--;
+        } while (index > 0 && !layers[index]->is_checkpoint);
         current_state = LoopState::Forward_In_BackPass;
         checkpoint_initiated = true;
         generator->register_event(this, EventType::General, NULL, 1);
@@ -1090,6 +1225,11 @@ namespace AstraSim
         }
         return;
       }
+      if (delay_loaded == false && sharded != nullptr &&
+          !sharded->backward_ready(index))
+      {
+        return;
+      }
       if (delay_loaded == false)
       {
         counter = layers[index]->get_input_grad_compute();
@@ -1097,8 +1237,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued)
@@ -1123,16 +1262,15 @@ namespace AstraSim
       }
       if (delay_loaded == false)
       {
-        counter = layers[index]->get_fwd_pass_compute();
+        counter = layers[index]->get_recompute_compute();
         delay_loaded = true;
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
-      if (!collective_issued)
+      if (!collective_issued && layers[index]->recompute_fwd_comm)
       {
         collective_issued = true;
         layers[index]->issue_forward_pass_comm(
@@ -1168,8 +1306,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued &&
@@ -1211,8 +1348,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (!collective_issued)
@@ -1253,8 +1389,7 @@ namespace AstraSim
       }
       if (counter > 0)
       {
-        generator->try_register_event(
-            this, EventType::Workload_Wait, NULL, counter);
+        wait_for_compute();
         return;
       }
       if (index == DLRM_LAST_BOTTOM_LAYER + 1)
@@ -1296,6 +1431,109 @@ namespace AstraSim
     inFile.close();
     return layers;
   }
+  // AS_RECOMPUTE=full[:k] checkpoints every k-th layer and replays the
+  // layers between two checkpoints before the backward pass reaches them;
+  // only the last layer keeps its activations. AS_RECOMPUTE=selective replays
+  // the runs of attention layers, without their collectives, and keeps the
+  // activations of the other layers. AS_RECOMPUTE=none replays nothing.
+  bool Workload::synthesize_checkpoints(const std::string& policy, std::string& err)
+  {
+    for (int i = 0; i < SIZE; i++)
+    {
+      layers[i]->is_checkpoint = false;
+      layers[i]->needs_fwd_in_bckwd_initiation = false;
+      layers[i]->recompute_fwd_comm = true;
+    }
+    if (policy == "none")
+    {
+      return true;
+    }
+    if (policy == "selective")
+    {
+      for (int i = 0; i < SIZE; i++)
+      {
+        if (layers[i]->id.find("attention") == std::string::npos)
+        {
+          continue;
+        }
+        int start = i;
+        while (i < SIZE && layers[i]->id.find("attention") != std::string::npos)
+        {
+          layers[i++]->recompute_fwd_comm = false;
+        }
+        // a run ending at the last layer has nothing above it to initiate
+        // the replay
+        if (i < SIZE)
+        {
+          layers[start]->is_checkpoint = true;
+          layers[i]->needs_fwd_in_bckwd_initiation = true;
+        }
+      }
+      return true;
+    }
+    if (policy.compare(0, 4, "full") != 0)
+    {
+      err = "unknown policy \"" + policy + "\", expected full[:k], selective or none";
+      return false;
+    }
+    int k = 1;
+    if (policy.size() > 4)
+    {
+      char* end;
+      k = policy[4] == ':' ? strtol(policy.c_str() + 5, &end, 10) : 0;
+      if (k < 1 || *end != '\0')
+      {
+        err = "expected full:<layers per checkpoint> with at least one layer";
+        return false;
+      }
+    }
+    for (int c = 0; c < SIZE - 1; c += k)
+    {
+      layers[c]->is_checkpoint = true;
+      if (c > 0)
+      {
+        layers[c]->needs_fwd_in_bckwd_initiation = true;
+      }
+    }
+    if (SIZE > 1)
+    {
+      layers[SIZE - 1]->needs_fwd_in_bckwd_initiation = true;
+    }
+    return true;
+  }
+  // Forward replays of the pass and the activations they spare, counted in
+  // layers: a layer that is not replayed keeps its activations for the
+  // whole pass, a replayed range holds them only while it is walked back.
+  void Workload::report_recompute()
+  {
+    int replayed = 0, longest = 0, run = 0;
+    Tick compute = 0, comm = 0;
+    for (int i = 0; i < SIZE; i++)
+    {
+      compute += layers[i]->total_recompute_compute;
+      comm += layers[i]->total_recompute_comm;
+      // a replayed range starts at its checkpoint
+      run = layers[i]->recompute_count == 0 ? 0
+          : layers[i]->is_checkpoint        ? 1
+                                            : run + 1;
+      replayed += run > 0;
+      longest = std::max(longest, run);
+    }
+    if (replayed == 0)
+    {
+      return;
+    }
+    std::cout << "Recompute: " << replayed << " of " << SIZE
+              << " layers replayed in the backward pass, " << (Tick)(compute / FREQ)
+              << " us compute";
+    if (UserParam::getInstance()->mode == ModeType::ANALYTICAL)
+    {
+      std::cout << ", " << (Tick)(comm / FREQ) << " us comm";
+    }
+    std::cout << "; activations kept for " << SIZE - replayed
+              << " layers, at most " << SIZE - replayed + longest
+              << " during a replay" << std::endl;
+  }
   ParallelismPolicy Workload::decode_parallelsim(std::string parallelism)
   {
     if (parallelism == "DATA")
@@ -1320,6 +1558,10 @@ namespace AstraSim
       return ParallelismPolicy::MicroBenchmark;
     else if (parallelism == "DISTRIBUTED_INFERENCE")
       return ParallelismPolicy::DistributedInference;
+    else if (parallelism == "INFERENCE_SERVING")
+      return ParallelismPolicy::InferenceServing;
+    else if (parallelism == "DAG")
+      return ParallelismPolicy::Dag;
     else
       return ParallelismPolicy::None;
   }
@@ -1349,7 +1591,8 @@ namespace AstraSim
     }
     else if (
         policy == ParallelismPolicy::Model ||
-        policy == ParallelismPolicy::DistributedInference)
+        policy == ParallelismPolicy::DistributedInference ||
+        policy == ParallelismPolicy::InferenceServing)
     {
       result["fwd"] = all;
       result["ig"] = all;
@@ -1377,7 +1620,8 @@ namespace AstraSim
     }
     else if (
         policy == ParallelismPolicy::TransformerFwdInBckwd ||
-        policy == ParallelismPolicy::Transformer)
+        policy == ParallelismPolicy::Transformer ||
+        policy == ParallelismPolicy::Dag)
     {
       int model_parallel_boundary =
           generator->break_dimension(model_parallel_npu_group);
@@ -1403,8 +1647,24 @@ namespace AstraSim
   {
     std::map<int, bool> chekpoints;
     std::map<int, bool> need_checkpoint_initiation;
-    std::ifstream inFile;
-    inFile.open(name);
+    std::ifstream workload_file;
+    std::istringstream bench_text;
+    if (CollectiveBench::is_bench(name))
+    {
+      std::string text, err;
+      if (!CollectiveBench::synthesize(name, generator->all_gpus[0], text, err))
+      {
+        std::cerr << "Invalid bench spec: " << err << std::endl;
+        exit(1);
+      }
+      bench_spec = name;
+      bench_text.str(text);
+    }
+    else
+    {
+      workload_file.open(name);
+    }
+    std::istream &inFile = bench_spec.empty() ? static_cast<std::istream &>(workload_file) : bench_text;
     if (!inFile)
     {
       std::cerr << "Unable to open file: " << name << std::endl;
@@ -1443,7 +1703,9 @@ namespace AstraSim
     }
 
     if (parallelismPolicy == ParallelismPolicy::TransformerFwdInBckwd ||
-        parallelismPolicy == ParallelismPolicy::Transformer)
+        parallelismPolicy == ParallelismPolicy::Transformer ||
+        parallelismPolicy == ParallelismPolicy::InferenceServing ||
+        parallelismPolicy == ParallelismPolicy::Dag)
     {
       for (size_t i = 1; i < tokens.size(); i = i + 1)
       {
@@ -1459,6 +1721,10 @@ namespace AstraSim
         {
           expert_parallel_npu_group = std::stoi(tokens[i + 1]);
         }
+        else if (tokens[i] == "cp:")
+        {
+          context_parallel_npu_group = std::stoi(tokens[i + 1]);
+        }
         else if (tokens[i] == "pp:")
         {
           pipeline_model_parallelism = std::stoi(tokens[i + 1]);
@@ -1477,6 +1743,18 @@ namespace AstraSim
         }
       }
 
+      if (parallelismPolicy == ParallelismPolicy::InferenceServing)
+      {
+        ServingSpec spec;
+        std::string err;
+        if (!InferenceServing::parse_header(tokens, spec, err))
+        {
+          std::cerr << "Invalid inference serving spec: " << err << std::endl;
+          exit(1);
+        }
+        serving = InferenceServing::join(this, spec);
+      }
+
       if (parallelismPolicy == ParallelismPolicy::TransformerFwdInBckwd)
       {
         if (generator->id == 0)
@@ -1488,9 +1766,9 @@ namespace AstraSim
           if (tokens[i] == "checkpoints:")
           {
             int account = std::stoi(tokens[i + 1]);
+            int j = 2;
             while (account-- > 0)
             {
-              int j = 2;
               int layer = std::stoi(tokens[i + j]);
               chekpoints[layer] = true;
               if (generator->id == 0)
@@ -1508,9 +1786,9 @@ namespace AstraSim
               std::cout << "layers initiating fwd_in_bckwd are: ";
             }
             int account = std::stoi(tokens[i + 1]);
+            int j = 2;
             while (account-- > 0)
             {
-              int j = 2;
               int layer = std::stoi(tokens[i + j]);
               need_checkpoint_initiation[layer] = true;
               if (generator->id == 0)
@@ -1550,7 +1828,7 @@ namespace AstraSim
       std::cerr << "######### Exiting because unable to decode the workload "
                    "parallelization strategy #########"
                 << std::endl;
-      inFile.close();
+      workload_file.close();
       exit(1);
 #else
       parallelismPolicy = ParallelismPolicy::TransformerFwdInBckwd;
@@ -1587,6 +1865,12 @@ namespace AstraSim
 
     SIZE = lines;
     layers = new Layer *[SIZE];
+    if (MemoryAccounting::enabled())
+    {
+      // every rank parses its own copy of the layers
+      accounted_bytes = SIZE * (sizeof(Layer) + sizeof(Layer *));
+      workload_bytes.add(accounted_bytes);
+    }
     for (int i = 0; i < lines; i++)
     {
       std::string id;
@@ -1640,6 +1924,10 @@ namespace AstraSim
         {
           wg_group_type = MockNccl::GroupType::DP_EP;
         }
+        else if (wg_comm_type_s == "ALLREDUCE_CP")
+        {
+          wg_group_type = MockNccl::GroupType::CP;
+        }
         else
         {
           wg_group_type = MockNccl::GroupType::NONE;
@@ -1700,6 +1988,10 @@ namespace AstraSim
         {
           wg_group_type = MockNccl::GroupType::DP_EP;
         }
+        else if (wg_comm_type_s == "ALLGATHER_CP")
+        {
+          wg_group_type = MockNccl::GroupType::CP;
+        }
         else
         {
           wg_group_type = MockNccl::GroupType::NONE;
@@ -1720,11 +2012,26 @@ namespace AstraSim
         {
           wg_group_type = MockNccl::GroupType::DP_EP;
         }
+        else if (wg_comm_type_s == "REDUCESCATTER_CP")
+        {
+          wg_group_type = MockNccl::GroupType::CP;
+        }
         else
         {
           wg_group_type = MockNccl::GroupType::NONE;
         }
       }
+      else if (wg_comm_type_s == "SENDRECV")
+      {
+        wg_type = ComType::All_to_All;
+        wg_group_type = MockNccl::GroupType::PP;
+      }
+      else if (wg_comm_type_s == "SENDRECV_CP")
+      {
+        // ring attention: the KV block passed around the CP ring
+        wg_type = ComType::All_to_All;
+        wg_group_type = MockNccl::GroupType::CP;
+      }
 
       // generate flow model
 
@@ -1743,6 +2050,10 @@ namespace AstraSim
         {
           ig_group_type = MockNccl::GroupType::DP_EP;
         }
+        else if (ig_comm_type_s == "ALLREDUCE_CP")
+        {
+          ig_group_type = MockNccl::GroupType::CP;
+        }
         else
         {
           ig_group_type = MockNccl::GroupType::NONE;
@@ -1803,6 +2114,10 @@ namespace AstraSim
         {
           ig_group_type = MockNccl::GroupType::DP_EP;
         }
+        else if (ig_comm_type_s == "ALLGATHER_CP")
+        {
+          ig_group_type = MockNccl::GroupType::CP;
+        }
         else
         {
           ig_group_type = MockNccl::GroupType::NONE;
@@ -1823,11 +2138,26 @@ namespace AstraSim
         {
           ig_group_type = MockNccl::GroupType::DP_EP;
         }
+        else if (ig_comm_type_s == "REDUCESCATTER_CP")
+        {
+          ig_group_type = MockNccl::GroupType::CP;
+        }
         else
         {
           ig_group_type = MockNccl::GroupType::NONE;
         }
       }
+      else if (ig_comm_type_s == "SENDRECV")
+      {
+        ig_type = ComType::All_to_All;
+        ig_group_type = MockNccl::GroupType::PP;
+      }
+      else if (ig_comm_type_s == "SENDRECV_CP")
+      {
+        // ring attention: the KV block passed around the CP ring
+        ig_type = ComType::All_to_All;
+        ig_group_type = MockNccl::GroupType::CP;
+      }
 
       if (fp_comm_type_s.substr(0, 9) == "ALLREDUCE")
       {
@@ -1844,6 +2174,10 @@ namespace AstraSim
         {
           fp_group_type = MockNccl::GroupType::DP_EP;
         }
+        else if (fp_comm_type_s == "ALLREDUCE_CP")
+        {
+          fp_group_type = MockNccl::GroupType::CP;
+        }
         else
         {
           fp_group_type = MockNccl::GroupType::NONE;
@@ -1904,6 +2238,10 @@ namespace AstraSim
         {
           fp_group_type = MockNccl::GroupType::DP_EP;
         }
+        else if (fp_comm_type_s == "ALLGATHER_CP")
+        {
+          fp_group_type = MockNccl::GroupType::CP;
+        }
         else
         {
           fp_group_type = MockNccl::GroupType::NONE;
@@ -1924,11 +2262,26 @@ namespace AstraSim
         {
           fp_group_type = MockNccl::GroupType::DP_EP;
         }
+        else if (fp_comm_type_s == "REDUCESCATTER_CP")
+        {
+          fp_group_type = MockNccl::GroupType::CP;
+        }
         else
         {
           fp_group_type = MockNccl::GroupType::NONE;
         }
       }
+      else if (fp_comm_type_s == "SENDRECV")
+      {
+        fp_type = ComType::All_to_All;
+        fp_group_type = MockNccl::GroupType::PP;
+      }
+      else if (fp_comm_type_s == "SENDRECV_CP")
+      {
+        // ring attention: the KV block passed around the CP ring
+        fp_type = ComType::All_to_All;
+        fp_group_type = MockNccl::GroupType::CP;
+      }
       if (generator->id == 0)
       {
         std::cout << "id: " << id << " , depen: " << depen
@@ -1988,6 +2341,54 @@ namespace AstraSim
       }
       layers[i] = l;
     }
+    const char* recompute = std::getenv("AS_RECOMPUTE");
+    if (recompute != nullptr && *recompute != '\0')
+    {
+      std::string err;
+      if (parallelismPolicy != ParallelismPolicy::Transformer &&
+          parallelismPolicy != ParallelismPolicy::TransformerFwdInBckwd)
+      {
+        if (generator->id == 0)
+        {
+          std::cerr << "AS_RECOMPUTE ignored: the workload is not a transformer"
+                    << std::endl;
+        }
+      }
+      else if (!synthesize_checkpoints(recompute, err))
+      {
+        std::cerr << "Invalid AS_RECOMPUTE: " << err << std::endl;
+        exit(1);
+      }
+      else
+      {
+        parallelismPolicy = ParallelismPolicy::TransformerFwdInBckwd;
+      }
+    }
+    sharded = ShardedDataParallel::configure(this);
+    if (parallelismPolicy == ParallelismPolicy::Dag)
+    {
+      std::string err;
+      dag = new WorkloadDag(this);
+      if (!dag->parse(inFile, err))
+      {
+        std::cerr << "Invalid workload dag: " << err << std::endl;
+        exit(1);
+      }
+    }
+    else if (WorkloadDag::forced())
+    {
+      std::string err;
+      dag = new WorkloadDag(this);
+      if (!dag->compile(err))
+      {
+        if (generator->id == 0)
+        {
+          std::cerr << "AS_DAG_EXECUTOR ignored: " << err << std::endl;
+        }
+        delete dag;
+        dag = nullptr;
+      }
+    }
     if (generator->id == 0)
     {
       std::cout << "type: " << run_type << " ,num passes: " << TOTAL_PASS
@@ -1995,7 +2396,7 @@ namespace AstraSim
                 << " compute scale: " << generator->compute_scale
                 << " ,comm scale: " << generator->comm_scale << std::endl;
     }
-    inFile.close();
+    workload_file.close();
     return true;
   }
   void Workload::fire()
@@ -25,6 +25,10 @@ class Sys;
 class Callable;
 class Layer;
 class CSVWriter;
+class InferenceServing;
+class ServingEngine;
+class WorkloadDag;
+class ShardedDataParallel;
 } // namespace AstraSim
 
 #include "astra-sim/system/AstraSimDataAPI.hh"
@@ -43,6 +47,8 @@ enum class ParallelismPolicy {
   HybridModelData,
   HybridCustomized,
   DistributedInference,
+  InferenceServing,
+  Dag,
   All,
   None
 };
@@ -59,8 +65,15 @@ class Workload : Callable {
   ~Workload();
   Layer** layers;
   int SIZE;
+  // bytes of the parsed layers reported to MemoryAccounting
+  int64_t accounted_bytes = 0;
   Sys* generator;
   std::string run_type;
+  std::string bench_spec; // non-empty when running a CollectiveBench sweep
+  InferenceServing* serving = nullptr;
+  std::vector<ServingEngine*> serving_engines;
+  WorkloadDag* dag = nullptr; // set when the layers run as a graph
+  ShardedDataParallel* sharded = nullptr; // set by AS_ZERO_STAGE
   Tick counter;
   int index;
   LoopState current_state;
@@ -75,6 +88,7 @@ class Workload : Callable {
   int pending_collectives;
   int model_parallel_npu_group;   // TP Size
   int expert_parallel_npu_group;  //Ep Size
+  int context_parallel_npu_group; //CP Size
   int pipeline_model_parallelism; //PP Size
   int GA;                         //Ga_Size
   int all_gpus;
@@ -103,7 +117,12 @@ class Workload : Callable {
   void iterate_hybrid_parallel_customized();
   void iterate_model_parallel();
   void iterate_distributed_inference();
+  void iterate_inference_serving();
+  void iterate_dag();
   bool initialize_workload(std::string name);
+  // Replaces the header's checkpoint lists with the AS_RECOMPUTE policy.
+  bool synthesize_checkpoints(const std::string& policy, std::string& err);
+  void report_recompute();
   void initialize_stat_files();
   std::map<std::string, std::vector<bool>> decode_involved_dimensions(
       ParallelismPolicy policy,
@@ -111,6 +130,7 @@ class Workload : Callable {
   void fire();
   void report();
   void check_for_sim_end();
+  void wait_for_compute();
   static int get_layer_numbers(std::string workload_input);
   CSVWriter* detailed;
   CSVWriter* end_to_end;
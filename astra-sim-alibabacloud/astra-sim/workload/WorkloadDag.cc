@@ -0,0 +1,454 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "WorkloadDag.hh"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include "Layer.hh"
+#include "Workload.hh"
+#include "astra-sim/system/IntData.hh"
+#include "astra-sim/system/OverlapTimeline.hh"
+#include "astra-sim/system/TraceExporter.hh"
+
+namespace AstraSim {
+static const int compute_stream = 0;
+static const int model_comm_stream = 1;
+static const int data_comm_stream = 2;
+
+bool WorkloadDag::forced() {
+  const char* env = std::getenv("AS_DAG_EXECUTOR");
+  return env != nullptr && std::string(env) == "1";
+}
+
+WorkloadDag::WorkloadDag(Workload* workload)
+    : started(false),
+      workload(workload),
+      passes(std::max(1, workload->TOTAL_PASS)),
+      finished(0),
+      dispatching(false),
+      ended(false) {}
+
+int WorkloadDag::add(
+    const std::string& name,
+    int layer,
+    Op op,
+    bool comm,
+    int stream,
+    std::vector<int> deps,
+    std::vector<int> prev_deps) {
+  Node node;
+  node.name = name + "_" + std::to_string(layer);
+  node.layer = layer;
+  node.op = op;
+  node.comm = comm;
+  node.stream = stream;
+  node.deps = deps;
+  node.prev_deps = prev_deps;
+  nodes.push_back(node);
+  return nodes.size() - 1;
+}
+
+bool WorkloadDag::parse(std::istream& in, std::string& err) {
+  std::string key;
+  int count = 0;
+  if (!(in >> key >> count) || key != "dag:" || count <= 0) {
+    err = "expected \"dag: <nodes>\" after the layer table";
+    return false;
+  }
+  static const std::map<std::string, std::pair<Op, bool>> ops = {
+      {"fwd", {Op::Fwd, false}},
+      {"ig", {Op::InputGrad, false}},
+      {"wg", {Op::WeightGrad, false}},
+      {"fwd_comm", {Op::Fwd, true}},
+      {"ig_comm", {Op::InputGrad, true}},
+      {"wg_comm", {Op::WeightGrad, true}}};
+  std::map<std::string, int> index;
+  std::vector<std::string> dep_lists;
+  for (int i = 0; i < count; i++) {
+    Node node;
+    std::string op, deps;
+    if (!(in >> node.name >> node.layer >> op >> node.stream >> deps)) {
+      err = "expected " + std::to_string(count) + " dag nodes";
+      return false;
+    }
+    auto it = ops.find(op);
+    if (it == ops.end()) {
+      err = "unknown op " + op + " of node " + node.name;
+      return false;
+    }
+    if (node.layer < 0 || node.layer >= workload->SIZE || node.stream < 0) {
+      err = "bad layer row or stream of node " + node.name;
+      return false;
+    }
+    if (!index.emplace(node.name, i).second) {
+      err = "duplicate node " + node.name;
+      return false;
+    }
+    node.op = it->second.first;
+    node.comm = it->second.second;
+    nodes.push_back(node);
+    dep_lists.push_back(deps);
+  }
+  for (int i = 0; i < count; i++) {
+    if (dep_lists[i] == "-") {
+      continue;
+    }
+    std::stringstream list(dep_lists[i]);
+    std::string dep;
+    while (std::getline(list, dep, ',')) {
+      bool previous = !dep.empty() && dep[0] == '~';
+      auto it = index.find(previous ? dep.substr(1) : dep);
+      if (it == index.end()) {
+        err = "node " + nodes[i].name + " depends on unknown node " + dep;
+        return false;
+      }
+      (previous ? nodes[i].prev_deps : nodes[i].deps).push_back(it->second);
+    }
+  }
+  return link(err);
+}
+
+bool WorkloadDag::compile(std::string& err) {
+  ParallelismPolicy policy = workload->parallelismPolicy;
+  bool data = policy == ParallelismPolicy::Data;
+  bool inference = policy == ParallelismPolicy::DistributedInference;
+  bool recompute = policy == ParallelismPolicy::TransformerFwdInBckwd;
+  if (!data && !inference && !recompute &&
+      policy != ParallelismPolicy::Transformer) {
+    err = "no graph form for this parallelism policy";
+    return false;
+  }
+  if (workload->sharded != nullptr) {
+    err = "no graph form for sharded data parallelism";
+    return false;
+  }
+  int N = workload->SIZE;
+  Layer** layers = workload->layers;
+  std::vector<int> fwd(N, -1), wg_comm(N, -1);
+  int last = -1;
+  auto after = [&last]() {
+    return last < 0 ? std::vector<int>() : std::vector<int>{last};
+  };
+  for (int i = 0; i < N; i++) {
+    if (recompute && layers[i]->fwd_pass_comm_size < 4096 &&
+        layers[i]->fwd_pass_comm_size > 0) {
+      layers[i]->fwd_pass_comm_size = 4096;
+    }
+    fwd[i] = last = add("fwd", i, Op::Fwd, false, compute_stream, after());
+    if (!data) {
+      last = add("fwd_comm", i, Op::Fwd, true, model_comm_stream, after());
+    }
+  }
+  for (int i = N - 1; i >= 0 && !inference; i--) {
+    if (data) {
+      last = add("wg", i, Op::WeightGrad, false, compute_stream, after());
+      wg_comm[i] = add(
+          "wg_comm", i, Op::WeightGrad, true, data_comm_stream, after());
+      if (i > 0) {
+        last = add("ig", i, Op::InputGrad, false, compute_stream, after());
+      }
+      continue;
+    }
+    if (recompute && layers[i]->needs_fwd_in_bckwd_initiation) {
+      int checkpoint = i - 1;
+      while (checkpoint > 0 && !layers[checkpoint]->is_checkpoint) {
+        checkpoint--;
+      }
+      for (int j = std::max(checkpoint, 0); j < i; j++) {
+        last = add("refwd", j, Op::Fwd, false, compute_stream, after());
+        if (layers[j]->recompute_fwd_comm) {
+          last = add(
+              "refwd_comm", j, Op::Fwd, true, model_comm_stream, after());
+        }
+      }
+    }
+    last = add("ig", i, Op::InputGrad, false, compute_stream, after());
+    last = add("ig_comm", i, Op::InputGrad, true, model_comm_stream, after());
+    last = add("wg", i, Op::WeightGrad, false, compute_stream, after());
+    wg_comm[i] = add(
+        "wg_comm", i, Op::WeightGrad, true, data_comm_stream, after());
+  }
+  // a layer's next forward pass waits for its weight gradients, and the
+  // next pass starts once this one has walked all the layers
+  for (int i = 0; i < N; i++) {
+    if (wg_comm[i] >= 0) {
+      nodes[fwd[i]].prev_deps.push_back(wg_comm[i]);
+    }
+  }
+  if (N > 0) {
+    nodes[fwd[0]].prev_deps.push_back(last);
+  }
+  return link(err);
+}
+
+bool WorkloadDag::link(std::string& err) {
+  int N = nodes.size();
+  dependents.assign(N, {});
+  next_pass_dependents.assign(N, {});
+  std::vector<int> in_degree(N, 0);
+  for (int k = 0; k < N; k++) {
+    Node& node = nodes[k];
+    for (std::vector<int>* deps : {&node.deps, &node.prev_deps}) {
+      std::sort(deps->begin(), deps->end());
+      deps->erase(std::unique(deps->begin(), deps->end()), deps->end());
+    }
+    for (int d : node.deps) {
+      dependents[d].push_back(k);
+    }
+    for (int d : node.prev_deps) {
+      next_pass_dependents[d].push_back(k);
+    }
+    in_degree[k] = node.deps.size();
+  }
+  std::vector<int> order;
+  for (int k = 0; k < N; k++) {
+    if (in_degree[k] == 0) {
+      order.push_back(k);
+    }
+  }
+  for (size_t i = 0; i < order.size(); i++) {
+    for (int d : dependents[order[i]]) {
+      if (--in_degree[d] == 0) {
+        order.push_back(d);
+      }
+    }
+  }
+  if ((int)order.size() != N) {
+    err = "the dependencies within a pass form a cycle";
+    return false;
+  }
+  pending.assign((size_t)N * passes, 0);
+  for (int p = 0; p < passes; p++) {
+    for (int k = 0; k < N; k++) {
+      pending[(size_t)p * N + k] =
+          nodes[k].deps.size() + (p > 0 ? nodes[k].prev_deps.size() : 0);
+    }
+  }
+  pass_done.assign(passes, 0);
+  for (Node& node : nodes) {
+    streams[node.stream];
+  }
+#ifdef ANALYTI
+  int TP_size = workload->model_parallel_npu_group;
+  int EP_size = workload->expert_parallel_npu_group;
+  int all_gpus = workload->generator->all_gpus[0];
+  int DP_size = all_gpus / (TP_size * workload->context_parallel_npu_group * workload->pipeline_model_parallelism);
+  std::map<std::pair<int, int>, Tick> estimates;
+  for (Node& node : nodes) {
+    if (!node.comm) {
+      comm_estimate.push_back(0);
+      continue;
+    }
+    std::pair<int, int> key(node.layer, (int)node.op);
+    if (estimates.count(key) == 0) {
+      Layer* layer = workload->layers[node.layer];
+      ComType type = node.op == Op::Fwd ? layer->fwd_pass_comm_type
+          : node.op == Op::InputGrad    ? layer->input_grad_comm_type
+                                        : layer->weight_grad_comm_type;
+      MockNccl::GroupType group = node.op == Op::Fwd
+          ? layer->fwd_pass_group_type
+          : node.op == Op::InputGrad ? layer->input_grad_group_type
+                                     : layer->weight_grad_group_type;
+      uint64_t size = node.op == Op::Fwd ? layer->fwd_pass_comm_size
+          : node.op == Op::InputGrad     ? layer->input_grad_comm_size
+                                         : layer->weight_grad_comm_size;
+      int nranks = group == MockNccl::GroupType::DP_EP ? DP_size / EP_size
+          : group == MockNccl::GroupType::CP
+          ? workload->context_parallel_npu_group
+          : node.op == Op::WeightGrad                  ? DP_size
+          : group == MockNccl::GroupType::EP           ? EP_size
+                                                       : TP_size;
+      estimates[key] = layer->compute_time(
+          type, TP_size, nranks, size, group, all_gpus, EP_size);
+    }
+    comm_estimate.push_back(estimates[key]);
+  }
+#endif
+  return true;
+}
+
+void WorkloadDag::start() {
+  started = true;
+  for (size_t i = 0; i < pending.size(); i++) {
+    if (pending[i] == 0) {
+      streams[nodes[i % nodes.size()].stream].ready.insert(i);
+    }
+  }
+  dispatch();
+}
+
+void WorkloadDag::dispatch() {
+  if (dispatching) {
+    return; // the loop further up the stack picks the new work up
+  }
+  dispatching = true;
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    while (!done.empty()) {
+      int instance = done.front();
+      done.pop_front();
+      complete(instance);
+      progress = true;
+    }
+    for (auto& entry : streams) {
+      Stream& stream = entry.second;
+      if (stream.running < 0 && !stream.ready.empty()) {
+        int instance = *stream.ready.begin();
+        stream.ready.erase(stream.ready.begin());
+        run(instance);
+        progress = true;
+      }
+    }
+  }
+  dispatching = false;
+  if (finished == (int)pending.size() && !ended) {
+    ended = true;
+    report();
+    workload->pass_counter = workload->TOTAL_PASS;
+    workload->check_for_sim_end();
+  }
+}
+
+void WorkloadDag::run(int instance) {
+  const Node& node = nodes[instance % nodes.size()];
+  Layer* layer = workload->layers[node.layer];
+  Stream& stream = streams[node.stream];
+  Sys* sys = workload->generator;
+  stream.running = instance;
+  stream.started = Sys::boostedTick();
+  Tick cycles = 0;
+  if (!node.comm) {
+    bool replay = node.name.compare(0, 6, "refwd_") == 0;
+    cycles = replay ? layer->get_recompute_compute()
+        : node.op == Op::Fwd ? layer->get_fwd_pass_compute()
+        : node.op == Op::InputGrad ? layer->get_input_grad_compute()
+                                   : layer->get_weight_grad_compute();
+    TraceExporter* trace = TraceExporter::get();
+    if (trace != nullptr && trace->traced(sys->id)) {
+      trace->compute(
+          sys->id, node.name, stream.started, stream.started + cycles);
+    }
+    if (OverlapTimeline::enabled() && OverlapTimeline::recorded(sys->id)) {
+      OverlapTimeline::compute(
+          sys->id, stream.started, stream.started + cycles);
+    }
+  } else {
+#ifdef ANALYTI
+    cycles = comm_estimate[instance % nodes.size()];
+#else
+    // Sys takes the communication group from the layer at index
+    workload->index = node.layer;
+    size_t issued;
+    if (node.op == Op::Fwd) {
+      workload->current_state = Workload::LoopState::Forward_Pass;
+      issued = layer->fwd_pass_datasets.size();
+      layer->issue_forward_pass_comm(
+          SchedulingPolicy::None, CollectiveBarrier::Non_Blocking);
+      issued = layer->fwd_pass_datasets.size() - issued;
+    } else if (node.op == Op::InputGrad) {
+      workload->current_state = Workload::LoopState::Input_Gradient;
+      issued = layer->input_grad_datasets.size();
+      layer->issue_input_grad_comm(
+          SchedulingPolicy::LIFO, CollectiveBarrier::Non_Blocking);
+      issued = layer->input_grad_datasets.size() - issued;
+    } else {
+      workload->current_state = Workload::LoopState::Weight_Gradient;
+      issued = layer->weight_grad_datasets.size();
+      layer->issue_weight_grad_comm(
+          SchedulingPolicy::FIFO, CollectiveBarrier::Non_Blocking);
+      issued = layer->weight_grad_datasets.size() - issued;
+    }
+    if (issued > 0) {
+      in_flight[std::make_pair(node.layer, (int)node.op)].push_back(instance);
+      return;
+    }
+#endif
+  }
+  if (cycles > 0) {
+    sys->try_register_event(
+        this, EventType::General, new IntData(instance), cycles);
+    return;
+  }
+  done.push_back(instance);
+}
+
+void WorkloadDag::call(EventType, CallData* data) {
+  IntData* instance = (IntData*)data;
+  done.push_back(instance->data);
+  delete instance;
+  dispatch();
+}
+
+void WorkloadDag::comm_finished(int layer, EventType event) {
+  Op op = event == EventType::Fwd_Comm_Finished_After_Delay ? Op::Fwd
+      : event == EventType::Input_Grad_Comm_Finished_After_Delay
+      ? Op::InputGrad
+      : Op::WeightGrad;
+  auto it = in_flight.find(std::make_pair(layer, (int)op));
+  if (it == in_flight.end() || it->second.empty()) {
+    return;
+  }
+  done.push_back(it->second.front());
+  it->second.pop_front();
+  dispatch();
+}
+
+void WorkloadDag::complete(int instance) {
+  int N = nodes.size();
+  int pass = instance / N;
+  int k = instance % N;
+  Stream& stream = streams[nodes[k].stream];
+  stream.running = -1;
+  stream.busy += Sys::boostedTick() - stream.started;
+  finished++;
+  for (int d : dependents[k]) {
+    if (--pending[(size_t)pass * N + d] == 0) {
+      streams[nodes[d].stream].ready.insert(pass * N + d);
+    }
+  }
+  if (pass + 1 < passes) {
+    for (int d : next_pass_dependents[k]) {
+      if (--pending[(size_t)(pass + 1) * N + d] == 0) {
+        streams[nodes[d].stream].ready.insert((pass + 1) * N + d);
+      }
+    }
+  }
+  if (++pass_done[pass] == N && workload->generator->leads_job()) {
+    std::cout << "pass: " << pass << " finished at time: " << Sys::boostedTick()
+              << std::endl;
+  }
+}
+
+void WorkloadDag::report() {
+  if (workload->generator->id != 0) {
+    return;
+  }
+  double total_us = (double)Sys::boostedTick() / FREQ;
+  std::cout << "workload dag: " << nodes.size() << " nodes x " << passes
+            << " passes finished at " << total_us << " us" << std::endl;
+  char line[128];
+  for (auto& entry : streams) {
+    double busy_us = (double)entry.second.busy / FREQ;
+    std::snprintf(line, sizeof(line), "  stream %d busy %.2f us (%.1f%%)",
+                  entry.first, busy_us,
+                  total_us > 0 ? busy_us * 100 / total_us : 0);
+    std::cout << line << std::endl;
+  }
+}
+} // namespace AstraSim
@@ -0,0 +1,105 @@
+/*
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __WORKLOADDAG_HH__
+#define __WORKLOADDAG_HH__
+
+#include <deque>
+#include <istream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "astra-sim/system/Callable.hh"
+#include "astra-sim/system/Common.hh"
+
+namespace AstraSim {
+class Workload;
+
+// Runs a workload as a graph of compute and comm nodes over the rows of its
+// layer table. A node waits for its dependencies in the same pass and, with
+// a "~" prefix, in the previous pass; it then queues on its stream, which
+// runs one node at a time in pass and node order. Every pass runs the same
+// graph, so passes overlap wherever the edges allow it.
+//
+// A DAG workload lists its nodes after the layer table:
+//   dag: <nodes>
+//   <name> <layer row> <fwd|ig|wg|fwd_comm|ig_comm|wg_comm> <stream> <deps|->
+// e.g. "w3 3 wg_comm 2 g3" or "f0 0 fwd 0 ~w0". The training policies can
+// also be compiled into a graph (AS_DAG_EXECUTOR=1).
+class WorkloadDag : public Callable {
+ public:
+  enum class Op { Fwd, InputGrad, WeightGrad };
+  struct Node {
+    std::string name;
+    int layer;
+    Op op;
+    bool comm;
+    int stream;
+    std::vector<int> deps;
+    std::vector<int> prev_deps; // nodes of the previous pass
+  };
+
+  // AS_DAG_EXECUTOR=1: run the supported policies through the graph engine.
+  static bool forced();
+  explicit WorkloadDag(Workload* workload);
+  bool parse(std::istream& in, std::string& err);
+  // Builds the graph the workload's parallelism policy walks.
+  bool compile(std::string& err);
+  void start();
+  void call(EventType event, CallData* data);
+  // Called by a layer once one of its collectives finished.
+  void comm_finished(int layer, EventType event);
+  bool started;
+  std::vector<Node> nodes;
+
+ private:
+  int add(
+      const std::string& name,
+      int layer,
+      Op op,
+      bool comm,
+      int stream,
+      std::vector<int> deps,
+      std::vector<int> prev_deps = {});
+  bool link(std::string& err);
+  void dispatch();
+  void run(int instance);
+  void complete(int instance);
+  void report();
+  Workload* workload;
+  int passes;
+  std::vector<std::vector<int>> dependents;
+  std::vector<std::vector<int>> next_pass_dependents;
+  std::vector<int> pending; // unfinished dependencies of each instance
+  std::vector<int> pass_done;
+  int finished;
+  std::deque<int> done; // finished instances not yet released
+  bool dispatching;
+  bool ended;
+  struct Stream {
+    std::set<int> ready; // instances, pass-major
+    int running = -1;
+    Tick busy = 0;
+    Tick started = 0;
+  };
+  std::map<int, Stream> streams;
+  // comm instances in flight, per layer and op, in issue order
+  std::map<std::pair<int, int>, std::deque<int>> in_flight;
+  // estimated collective time of each comm node, analytical backend only
+  std::vector<Tick> comm_estimate;
+};
+} // namespace AstraSim
+#endif
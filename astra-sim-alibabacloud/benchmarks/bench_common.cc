@@ -0,0 +1,236 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include "bench_common.hh"
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include "astra-sim/system/AstraParamParse.hh"
+
+namespace SimAIBench {
+AstraSim::timespec_t BenchNetwork::sim_get_time() {
+  AstraSim::timespec_t time;
+  time.time_res = AstraSim::NS;
+  time.time_val = now;
+  return time;
+}
+
+void BenchNetwork::sim_schedule(
+    AstraSim::timespec_t delta,
+    void (*fun_ptr)(void* fun_arg),
+    void* fun_arg) {
+  pending.push(Pending{now + delta.time_val, seq++, fun_ptr, fun_arg});
+}
+
+int BenchNetwork::sim_send(
+    void* buffer,
+    uint64_t count,
+    int type,
+    int dst,
+    int tag,
+    AstraSim::sim_request* request,
+    void (*msg_handler)(void* fun_arg),
+    void* fun_arg) {
+  pending.push(Pending{now, seq++, msg_handler, fun_arg});
+  return 0;
+}
+
+int BenchNetwork::sim_recv(
+    void* buffer,
+    uint64_t count,
+    int type,
+    int src,
+    int tag,
+    AstraSim::sim_request* request,
+    void (*msg_handler)(void* fun_arg),
+    void* fun_arg) {
+  pending.push(Pending{now, seq++, msg_handler, fun_arg});
+  return 0;
+}
+
+uint64_t BenchNetwork::run() {
+  uint64_t ran = 0;
+  while (!pending.empty()) {
+    Pending next = pending.top();
+    pending.pop();
+    now = next.time;
+    next.fun_ptr(next.fun_arg);
+    ran++;
+  }
+  return ran;
+}
+
+std::string source_path(const std::string& relative) {
+  return std::string(SIMAI_SOURCE_ROOT) + "/" + relative;
+}
+
+std::string scratch_dir() {
+  static std::string dir;
+  if (dir.empty()) {
+    char pattern[] = "/tmp/simai_bench.XXXXXX";
+    if (mkdtemp(pattern) == nullptr) {
+      std::cerr << "cannot create a scratch directory" << std::endl;
+      exit(1);
+    }
+    dir = pattern;
+    std::string inputs = source_path("astra-sim-alibabacloud");
+    if (mkdir((dir + "/results").c_str(), 0755) != 0 ||
+        mkdir((dir + "/astra-sim-alibabacloud").c_str(), 0755) != 0 ||
+        symlink(
+            (inputs + "/inputs").c_str(),
+            (dir + "/astra-sim-alibabacloud/inputs").c_str()) != 0) {
+      std::cerr << "cannot populate " << dir << std::endl;
+      exit(1);
+    }
+  }
+  return dir;
+}
+
+static BenchNetwork* network = nullptr;
+static AstraSim::Sys* shared_system = nullptr;
+
+// Same setup as AnalyticalAstra.cc for the command line in the tutorial.
+static void build_system() {
+  // the ratio tables are opened relative to the working directory
+  if (chdir(scratch_dir().c_str()) != 0) {
+    std::cerr << "cannot enter " << scratch_dir() << std::endl;
+    exit(1);
+  }
+  std::vector<std::string> args = {
+      "simai_benchmarks", "-w", source_path("example/workload_analytical.txt"),
+      "-r", "bench-",
+      "-g", "9216", "-g_p_s", "8", "-nv", "360", "-nic", "48.5",
+      "-n_p_s", "8", "-g_type", "A100"};
+  std::vector<char*> argv;
+  for (auto& arg : args) {
+    argv.push_back(&arg[0]);
+  }
+  UserParam* param = UserParam::getInstance();
+  if (param->parse(argv.size(), argv.data())) {
+    exit(1);
+  }
+  param->mode = ModeType::ANALYTICAL;
+  std::vector<int> physical_dims = param->gpus;
+  uint32_t all_gpu_num = param->gpus[0];
+  for (uint32_t i = all_gpu_num;
+       i < all_gpu_num + param->net_work_param.nvswitch_num;
+       ++i) {
+    param->net_work_param.NVswitchs.push_back(i);
+  }
+  physical_dims[0] += param->net_work_param.nvswitch_num;
+  std::vector<int> queues_per_dim(physical_dims.size(), 1);
+
+  network = new BenchNetwork(0);
+  shared_system = new AstraSim::Sys(
+      network,
+      nullptr,
+      0,
+      0,
+      1,
+      physical_dims,
+      queues_per_dim,
+      "",
+      param->workload,
+      param->comm_scale,
+      1,
+      1,
+      1,
+      0,
+      "./results/bench-",
+      "Benchmark",
+      true,
+      false,
+      param->net_work_param.gpu_type,
+      param->gpus,
+      param->net_work_param.NVswitchs,
+      param->net_work_param.gpus_per_server);
+  shared_system->nvswitch_id = all_gpu_num;
+  shared_system->num_gpus = all_gpu_num;
+}
+
+AstraSim::Sys* bench_system() {
+  if (shared_system == nullptr) {
+    build_system();
+  }
+  return shared_system;
+}
+
+BenchNetwork* bench_network() {
+  bench_system();
+  return network;
+}
+
+long peak_rss_kb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+ChildRun run_child(
+    const std::vector<std::string>& argv,
+    const std::vector<std::string>& env) {
+  ChildRun result;
+  int out[2];
+  if (pipe(out) != 0) {
+    return result;
+  }
+  auto begin = std::chrono::steady_clock::now();
+  pid_t pid = fork();
+  if (pid == 0) {
+    dup2(out[1], STDOUT_FILENO);
+    dup2(out[1], STDERR_FILENO);
+    close(out[0]);
+    close(out[1]);
+    if (chdir(scratch_dir().c_str()) != 0) {
+      _exit(127);
+    }
+    for (auto& var : env) {
+      putenv(const_cast<char*>(var.c_str()));
+    }
+    std::vector<char*> args;
+    for (auto& arg : argv) {
+      args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+    execv(args[0], args.data());
+    _exit(127);
+  }
+  close(out[1]);
+  if (pid < 0) {
+    close(out[0]);
+    return result;
+  }
+  char buffer[4096];
+  ssize_t n;
+  while ((n = read(out[0], buffer, sizeof(buffer))) > 0) {
+    result.output.append(buffer, n);
+  }
+  close(out[0]);
+  int status = 0;
+  struct rusage usage;
+  wait4(pid, &status, 0, &usage);
+  result.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - begin)
+                       .count();
+  result.peak_rss_kb = usage.ru_maxrss;
+  result.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  return result;
+}
+} // namespace SimAIBench
@@ -0,0 +1,112 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#ifndef __SIMAI_BENCH_COMMON_HH__
+#define __SIMAI_BENCH_COMMON_HH__
+
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <vector>
+#include "astra-sim/system/AstraNetworkAPI.hh"
+#include "astra-sim/system/Sys.hh"
+
+namespace SimAIBench {
+// Network stub for driving a Sys without a backend: sim_schedule keeps a
+// time-ordered queue that run() drains, sends and receives complete at once.
+class BenchNetwork : public AstraSim::AstraNetworkAPI {
+ public:
+  explicit BenchNetwork(int rank) : AstraSim::AstraNetworkAPI(rank) {}
+  int sim_comm_size(AstraSim::sim_comm comm, int* size) override {
+    return 0;
+  }
+  int sim_finish() override {
+    return 0;
+  }
+  double sim_time_resolution() override {
+    return 0;
+  }
+  int sim_init(AstraSim::AstraMemoryAPI* MEM) override {
+    return 0;
+  }
+  AstraSim::timespec_t sim_get_time() override;
+  void sim_schedule(
+      AstraSim::timespec_t delta,
+      void (*fun_ptr)(void* fun_arg),
+      void* fun_arg) override;
+  int sim_send(
+      void* buffer,
+      uint64_t count,
+      int type,
+      int dst,
+      int tag,
+      AstraSim::sim_request* request,
+      void (*msg_handler)(void* fun_arg),
+      void* fun_arg) override;
+  int sim_recv(
+      void* buffer,
+      uint64_t count,
+      int type,
+      int src,
+      int tag,
+      AstraSim::sim_request* request,
+      void (*msg_handler)(void* fun_arg),
+      void* fun_arg) override;
+  // Runs scheduled callbacks until none is left, returns how many ran.
+  uint64_t run();
+
+ private:
+  struct Pending {
+    double time;
+    uint64_t seq;
+    void (*fun_ptr)(void* fun_arg);
+    void* fun_arg;
+    bool operator>(const Pending& other) const {
+      return time != other.time ? time > other.time : seq > other.seq;
+    }
+  };
+  std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>>
+      pending;
+  double now = 0;
+  uint64_t seq = 0;
+};
+
+// The Sys of rank 0 of the example analytical setup, built on first use:
+// 9216 A100 GPUs, 8 per server, workload example/workload_analytical.txt.
+AstraSim::Sys* bench_system();
+BenchNetwork* bench_network();
+
+// Path of a file relative to the repository root.
+std::string source_path(const std::string& relative);
+// Temporary working directory of the simulators, with a results/ folder and
+// the input tables they open by relative path.
+std::string scratch_dir();
+
+// Peak resident set of this process, in KiB.
+long peak_rss_kb();
+
+struct ChildRun {
+  bool ok = false;
+  double seconds = 0;
+  long peak_rss_kb = 0;
+  std::string output;
+};
+// Runs `argv` from scratch_dir() with `env` added to the environment
+// and collects its output, wall time and peak resident set.
+ChildRun run_child(
+    const std::vector<std::string>& argv,
+    const std::vector<std::string>& env);
+} // namespace SimAIBench
+#endif
@@ -0,0 +1,79 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include <benchmark/benchmark.h>
+#include <tuple>
+#include <vector>
+#include "astra-sim/workload/Layer.hh"
+#include "astra-sim/workload/Workload.hh"
+#include "bench_common.hh"
+
+namespace SimAIBench {
+// (collective, group, group size, bytes) mixes seen in the analytical
+// example workload: TP all-gather/reduce-scatter inside and across servers,
+// EP all-to-all and DP all-reduce.
+static const std::vector<
+    std::tuple<AstraSim::ComType, MockNccl::GroupType, int, uint64_t>>
+    collectives = {
+        {AstraSim::ComType::All_Gather, MockNccl::GroupType::TP, 8, 8 << 20},
+        {AstraSim::ComType::Reduce_Scatter, MockNccl::GroupType::TP, 16, 64 << 20},
+        {AstraSim::ComType::All_to_All, MockNccl::GroupType::EP, 16, 32 << 20},
+        {AstraSim::ComType::All_Reduce, MockNccl::GroupType::DP, 48, 256 << 20},
+};
+
+static AstraSim::Layer* first_layer() {
+  return bench_system()->workload->layers[0];
+}
+
+// Layer::cal_ratio: lookup in the nic/nvlink/all-to-all ratio tables.
+static void BM_RatioLookup(benchmark::State& state) {
+  AstraSim::Layer* layer = first_layer();
+  uint32_t gpus_per_server = 8;
+  char allgather[] = "allgather";
+  char alltoall[] = "alltoall";
+  uint64_t lookups = 0;
+  for (auto _ : state) {
+    for (uint64_t size = 1 << 20; size <= (1ULL << 30); size <<= 1) {
+      benchmark::DoNotOptimize(layer->cal_ratio(
+          size, 8, 16, gpus_per_server, MockNccl::GroupType::TP, allgather,
+          false));
+      benchmark::DoNotOptimize(layer->cal_ratio(
+          size, 16, 2, gpus_per_server, MockNccl::GroupType::EP, alltoall,
+          false));
+      lookups += 2;
+    }
+  }
+  state.SetItemsProcessed(lookups);
+}
+BENCHMARK(BM_RatioLookup);
+
+// Layer::compute_time for the collectives above, bus bandwidth included.
+static void BM_LayerComputeTime(benchmark::State& state) {
+  AstraSim::Layer* layer = first_layer();
+  auto& collective = collectives[state.range(0)];
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(layer->compute_time(
+        std::get<0>(collective),
+        2,
+        std::get<2>(collective),
+        std::get<3>(collective),
+        std::get<1>(collective),
+        9216,
+        16));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LayerComputeTime)->DenseRange(0, collectives.size() - 1);
+} // namespace SimAIBench
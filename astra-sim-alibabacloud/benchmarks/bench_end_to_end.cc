@@ -0,0 +1,94 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include <benchmark/benchmark.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "bench_common.hh"
+
+namespace SimAIBench {
+// The simulators run as child processes with AS_DETERMINISTIC=1, whose run
+// fingerprint line also reports how many events the ranks executed.
+static uint64_t fingerprint_events(const std::string& output) {
+  size_t at = output.find("Run fingerprint:");
+  if (at == std::string::npos) {
+    return 0;
+  }
+  size_t ranks = output.find("ranks, ", at);
+  if (ranks == std::string::npos) {
+    return 0;
+  }
+  return std::strtoull(output.c_str() + ranks + 7, nullptr, 10);
+}
+
+static void run_simulator(
+    benchmark::State& state,
+    const std::string& binary,
+    const std::vector<std::string>& args) {
+  if (access(binary.c_str(), X_OK) != 0) {
+    state.SkipWithError((binary + " not built").c_str());
+    return;
+  }
+  std::vector<std::string> argv = {binary};
+  argv.insert(argv.end(), args.begin(), args.end());
+  double seconds = 0;
+  long peak_rss = 0;
+  uint64_t events = 0;
+  for (auto _ : state) {
+    ChildRun run = run_child(argv, {"AS_DETERMINISTIC=1"});
+    if (!run.ok) {
+      state.SkipWithError("simulator failed");
+      return;
+    }
+    state.SetIterationTime(run.seconds);
+    seconds += run.seconds;
+    peak_rss = std::max(peak_rss, run.peak_rss_kb);
+    events += fingerprint_events(run.output);
+  }
+  state.counters["events_per_second"] = events / seconds;
+  state.counters["peak_rss_kb"] = peak_rss;
+}
+
+// SimAI-Analytical on the example workload, as in the tutorial.
+static void BM_AnalyticalEndToEnd(benchmark::State& state) {
+  run_simulator(
+      state,
+      SIMAI_ANALYTICAL_BIN,
+      {"-w", source_path("example/workload_analytical.txt"), "-g", "9216", "-g_p_s", "8",
+       "-r", "bench-", "-nv", "360", "-nic", "48.5", "-n_p_s", "8",
+       "-g_type", "A100"});
+}
+BENCHMARK(BM_AnalyticalEndToEnd)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(3);
+
+// SimAI-Simulator, the all-reduce micro workload on a generated 8-GPU
+// Spectrum-X fabric.
+static void BM_Ns3EndToEnd(benchmark::State& state) {
+  run_simulator(
+      state,
+      SIMAI_NS3_BIN,
+      {"-t", "1", "-w", source_path("example/microAllReduce.txt"), "-n",
+       "gen:Spectrum-X,g=8,gps=8,gt=A100,bw=100Gbps", "-c",
+       source_path("astra-sim-alibabacloud/inputs/config/SimAI.conf")});
+}
+BENCHMARK(BM_Ns3EndToEnd)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(3);
+} // namespace SimAIBench
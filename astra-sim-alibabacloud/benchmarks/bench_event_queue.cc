@@ -0,0 +1,64 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include <benchmark/benchmark.h>
+#include <vector>
+#include "bench_common.hh"
+
+namespace SimAIBench {
+// Re-registers itself on the Sys event queue until it has fired `hops` times.
+class ChainEvent : public AstraSim::Callable {
+ public:
+  ChainEvent(AstraSim::Sys* sys, int hops, int delay)
+      : sys(sys), remaining(hops), delay(delay) {}
+  void call(AstraSim::EventType type, AstraSim::CallData* data) override {
+    if (--remaining > 0) {
+      sys->register_event(this, AstraSim::EventType::General, nullptr, delay);
+    }
+  }
+
+ private:
+  AstraSim::Sys* sys;
+  int remaining;
+  int delay;
+};
+
+// Insert and dispatch through Sys::try_register_event / Sys::call_events.
+// range(0) chains run side by side with delays of 1 to 4 cycles, so ticks
+// hold up to range(0) events each.
+static void BM_SysEventQueue(benchmark::State& state) {
+  AstraSim::Sys* sys = bench_system();
+  BenchNetwork* network = bench_network();
+  const int chains = state.range(0);
+  const int hops = 64;
+  uint64_t events = 0;
+  for (auto _ : state) {
+    std::vector<ChainEvent> pending;
+    pending.reserve(chains);
+    for (int i = 0; i < chains; i++) {
+      pending.emplace_back(sys, hops, 1 + i % 4);
+      sys->register_event(
+          &pending.back(), AstraSim::EventType::General, nullptr, 1);
+    }
+    network->run();
+    events += static_cast<uint64_t>(chains) * hops;
+  }
+  state.SetItemsProcessed(events);
+  state.counters["events_per_second"] =
+      benchmark::Counter(events, benchmark::Counter::kIsRate);
+  state.counters["peak_rss_kb"] = peak_rss_kb();
+}
+BENCHMARK(BM_SysEventQueue)->Arg(1)->Arg(64)->Arg(1024);
+} // namespace SimAIBench
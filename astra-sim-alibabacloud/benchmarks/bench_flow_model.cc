@@ -0,0 +1,63 @@
+/* 
+*Copyright (c) 2024, Alibaba Group;
+*Licensed under the Apache License, Version 2.0 (the "License");
+*you may not use this file except in compliance with the License.
+*You may obtain a copy of the License at
+
+*   http://www.apache.org/licenses/LICENSE-2.0
+
+*Unless required by applicable law or agreed to in writing, software
+*distributed under the License is distributed on an "AS IS" BASIS,
+*WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*See the License for the specific language governing permissions and
+*limitations under the License.
+*/
+
+#include <benchmark/benchmark.h>
+#include <vector>
+#include "astra-sim/system/MockNcclChannel.h"
+#include "astra-sim/system/MockNcclGroup.h"
+#include "bench_common.hh"
+
+namespace SimAIBench {
+// Flow-model generation for one collective over a TP group of range(1)
+// ranks, 8 GPUs per server. The cache in MockNcclGroup is cleared between
+// iterations so every call generates the model again.
+static void BM_FlowModelGeneration(benchmark::State& state) {
+  AstraSim::ComType op = static_cast<AstraSim::ComType>(state.range(0));
+  int ranks = state.range(1);
+  int gpus_per_server = 8;
+  std::vector<int> nvswitches;
+  for (int i = 0; i < ranks / gpus_per_server; i++) {
+    nvswitches.push_back(ranks + i);
+  }
+  MockNccl::MockNcclGroup group(
+      ranks, gpus_per_server, ranks, 1, 1, 1, 1, 1, nvswitches, GPUType::A100);
+  // builds the group's ring and tree channels, as Sys::mock_nccl_comms_init
+  MockNccl::MockNcclComm comm(0, MockNccl::TP, &group);
+  uint64_t flows = 0;
+  for (auto _ : state) {
+    auto model = comm.get_flow_model(
+        64 << 20, op, 0, MockNccl::State::Forward_Pass);
+    benchmark::DoNotOptimize(model);
+    state.PauseTiming();
+    flows += group.g_flow_id;
+    group.g_flow_id = 0;
+    group.flow_models.clear();
+    group.FlowName2nums.clear();
+    state.ResumeTiming();
+  }
+  state.counters["flows_per_second"] =
+      benchmark::Counter(flows, benchmark::Counter::kIsRate);
+  state.counters["peak_rss_kb"] = peak_rss_kb();
+}
+BENCHMARK(BM_FlowModelGeneration)
+    ->ArgNames({"op", "ranks"})
+    ->ArgsProduct(
+        {{static_cast<int>(AstraSim::ComType::All_Reduce),
+          static_cast<int>(AstraSim::ComType::All_Gather),
+          static_cast<int>(AstraSim::ComType::Reduce_Scatter),
+          static_cast<int>(AstraSim::ComType::All_to_All)},
+         {8, 16, 64}})
+    ->Unit(benchmark::kMicrosecond);
+} // namespace SimAIBench
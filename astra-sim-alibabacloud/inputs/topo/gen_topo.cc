@@ -0,0 +1,112 @@
+/*
+ * Native topology generator, a drop-in for gen_Topo_Template.py that also
+ * writes the binary topology format read by the ns-3 frontend.
+ *
+ * Build:
+ *   g++ -O2 -std=c++17 -I../../astra-sim/network_frontend/ns3 gen_topo.cc -o gen_topo
+ *
+ * Usage mirrors the Python script, e.g.
+ *   ./gen_topo -topo Spectrum-X -g 128 -gt A100 -bw 100Gbps -nvbw 2400Gbps
+ *   ./gen_topo -topo AlibabaHPN --dp -g 64 -asn 16 -psn 16 --text
+ *   ./gen_topo -topo fat-tree -g 1024 -k 16 -o ft1024.bin
+ */
+
+#include "topology-gen.h"
+
+#include <iostream>
+
+static void usage()
+{
+  std::cout << "-topo <name>   Spectrum-X, AlibabaHPN, DCN+, rail-optimized, fat-tree\n"
+            << "--ro --dt --dp rail-optimized / dual ToR / dual plane\n"
+            << "-g -er -gps -gt -nsps -nvbw -nl -l -bw -asn -npa -psn -apbw -app\n"
+            << "               same meaning as gen_Topo_Template.py\n"
+            << "-k <int>       fat-tree switch radix, default smallest that fits\n"
+            << "-o <file>      output file, default name as the Python script (+.bin)\n"
+            << "--text         write the legacy text format instead of binary\n";
+}
+
+int main(int argc, char *argv[])
+{
+  std::string topology, output;
+  bool ro = false, dt = false, dp = false, text = false;
+  std::vector<std::pair<std::string, std::string>> params;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help")
+    {
+      usage();
+      return 0;
+    }
+    else if (arg == "--ro")
+      ro = true;
+    else if (arg == "--dt")
+      dt = true;
+    else if (arg == "--dp")
+      dp = true;
+    else if (arg == "--text")
+      text = true;
+    else if (arg.size() > 1 && arg[0] == '-' && i + 1 < argc)
+    {
+      std::string key = arg.substr(arg[1] == '-' ? 2 : 1);
+      std::string value = argv[++i];
+      if (key == "topo" || key == "topology")
+        topology = value;
+      else if (key == "o")
+        output = value;
+      else
+        params.push_back(std::make_pair(key, value));
+    }
+    else
+    {
+      std::cerr << "unexpected argument: " << arg << std::endl;
+      usage();
+      return 1;
+    }
+  }
+
+  TopoSpec spec;
+  std::string err;
+  if (!TopoTemplate(topology, ro, dt, dp, spec, err))
+  {
+    std::cerr << "Error: " << err << std::endl;
+    return 1;
+  }
+  for (auto &param : params)
+  {
+    bool ok;
+    try
+    {
+      ok = SetTopoParam(spec, param.first, param.second, err);
+    }
+    catch (const std::exception &)
+    {
+      err = "bad value for -" + param.first + ": " + param.second;
+      ok = false;
+    }
+    if (!ok)
+    {
+      std::cerr << "Error: " << err << std::endl;
+      return 1;
+    }
+  }
+
+  Topology topo;
+  if (!GenerateTopology(spec, topo, err))
+  {
+    std::cerr << "Error: " << err << std::endl;
+    return 1;
+  }
+  if (output.empty())
+    output = text ? topo.name : topo.name + ".bin";
+  bool written = text ? WriteTopologyText(topo, output) : WriteTopologyBinary(topo, output);
+  if (!written)
+  {
+    std::cerr << "Error: unable to write " << output << std::endl;
+    return 1;
+  }
+  std::cout << output << ": " << topo.node_num << " nodes, " << topo.nvswitch_num << " nvswitches, "
+            << topo.switch_num << " switches, " << topo.links.size() << " links" << std::endl;
+  return 0;
+}